@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "encode.h"
+#include "thread_pool.h"
+#include "types.h"
+
+/* One line of the manifest */
+typedef struct _BatchJob
+{
+	char *src_image_fname;					//Source image file name.
+	char *secret_fname;						//Secret file name.
+	char *stego_image_fname;				//Output image file name.
+	int line;								//Line number in the manifest.
+
+	Status status;							//Result of the job.
+	double elapsed_ms;						//Wall time of the job.
+	unsigned long image_bytes;				//Pixel bytes of the source image.
+	unsigned long secret_bytes;				//Size of the secret file.
+} BatchJob;
+
+/* Jobs shared by the workers */
+typedef struct _Batch
+{
+	BatchJob *jobs;							//Jobs in manifest order.
+	int count;								//Number of jobs.
+	int next;								//Next job to hand out.
+	const Options *options;					//Encoding options of every job.
+} Batch;
+
+/* Function Definitions */
+
+/* Monotonic clock in milliseconds */
+static double batch_now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* Free the jobs read from a manifest */
+static void free_jobs(Batch *batch)
+{
+	for(int i = 0; i < batch->count; i++)
+	{
+		free(batch->jobs[i].src_image_fname);
+		free(batch->jobs[i].secret_fname);
+		free(batch->jobs[i].stego_image_fname);
+	}
+	free(batch->jobs);
+	batch->jobs = NULL;
+	batch->count = 0;
+}
+
+/* Read the manifest
+ * Description: Every job line needs exactly three file names.
+ * Input: Manifest file name
+ * Output: Jobs stored in batch
+ * Return: e_success or e_failure on an unreadable or malformed manifest
+ */
+static Status read_manifest(const char *manifest_fname, Batch *batch)
+{
+	FILE *fptr_manifest = fopen(manifest_fname, "r");
+	char *line = NULL;
+	size_t line_size = 0;
+	int capacity = 0, line_no = 0;
+	Status status = e_success;
+
+	batch->jobs = NULL;
+	batch->count = 0;
+	batch->next = 0;
+
+	if(fptr_manifest == NULL)
+	{
+		perror("fopen");
+		fprintf(stderr, "ERROR: Unable to open file %s\n", manifest_fname);
+		return e_failure;
+	}
+
+	while(getline(&line, &line_size, fptr_manifest) != -1)
+	{
+		char *save, *fields[4];
+		int nfields = 0;
+
+		line_no++;
+		for(char *field = strtok_r(line, " \t\r\n", &save); field != NULL && nfields < 4; field = strtok_r(NULL, " \t\r\n", &save))
+		{
+			fields[nfields++] = field;
+		}
+		//Skip empty lines and comments.
+		if(nfields == 0 || fields[0][0] == '#')
+		{
+			continue;
+		}
+		if(nfields != 3)
+		{
+			fprintf(stderr, "ERROR: %s:%d: expected <image file> <secret file> <output image file>\n", manifest_fname, line_no);
+			status = e_failure;
+			break;
+		}
+
+		//Grow the job array as needed.
+		if(batch->count == capacity)
+		{
+			BatchJob *jobs;
+
+			capacity = capacity ? capacity * 2 : 64;
+			jobs = realloc(batch->jobs, capacity * sizeof(BatchJob));
+			if(jobs == NULL)
+			{
+				status = e_failure;
+				break;
+			}
+			batch->jobs = jobs;
+		}
+		memset(&batch->jobs[batch->count], 0, sizeof(BatchJob));
+		batch->jobs[batch->count].src_image_fname = strdup(fields[0]);
+		batch->jobs[batch->count].secret_fname = strdup(fields[1]);
+		batch->jobs[batch->count].stego_image_fname = strdup(fields[2]);
+		batch->jobs[batch->count].line = line_no;
+		batch->count++;
+	}
+
+	free(line);
+	fclose(fptr_manifest);
+	if(status == e_failure)
+	{
+		free_jobs(batch);
+	}
+	return status;
+}
+
+/* Run one job
+ * Description: Validates the names like the command line does and encodes
+ * quietly, reusing the worker's EncodeInfo and its buffers.
+ * Input: Job, worker EncodeInfo, encoding options
+ * Output: Job status, time and sizes are filled in
+ * Return: None
+ */
+static void run_batch_job(BatchJob *job, EncodeInfo *encInfo, const Options *options)
+{
+	char *argv[] = { "batch", "-e", job->src_image_fname, job->secret_fname, job->stego_image_fname, NULL };
+	double start = batch_now_ms();
+
+	encInfo->pool = NULL;
+	encInfo->quiet = 1;
+	encInfo->stats = NULL;
+	encInfo->use_stdio = 0;
+	encInfo->stdin_fd = STDIN_FILENO;
+	encInfo->stdout_fd = STDOUT_FILENO;
+	encInfo->depth = options->depth;
+	encInfo->compress = options->compress;
+	encInfo->crc = options->crc;
+	encInfo->key = options->has_key ? options->key : NULL;
+	encInfo->scatter = options->scatter;
+	encInfo->in_place = 0;
+	encInfo->secret_offset = 0;
+	encInfo->secret_part = -1;
+	encInfo->stripe = NULL;
+	job->status = e_failure;
+
+	//The output has to be of the source image format, there is no default name in a batch.
+	if(strcmp(file_extn(job->stego_image_fname), file_extn(job->src_image_fname)) != 0)
+	{
+		fprintf(stderr, "ERROR: Manifest line %d: output %s should end in %s like %s\n", job->line, job->stego_image_fname, file_extn(job->src_image_fname), job->src_image_fname);
+	}
+	else if(read_and_validate_encode_args(argv, encInfo) == e_success)
+	{
+		job->status = do_encoding(encInfo);
+		close_files(encInfo);
+	}
+
+	job->elapsed_ms = batch_now_ms() - start;
+	if(job->status == e_success)
+	{
+		job->image_bytes = encInfo->image_capacity;
+		job->secret_bytes = encInfo->size_secret_file;
+	}
+}
+
+/* Batch worker
+ * Description: Takes the next job until none are left, so every worker
+ * stays busy however uneven the jobs are.
+ * Input: Batch, worker index
+ * Output: Jobs are run
+ * Return: None
+ */
+static void batch_worker(void *arg, int index)
+{
+	Batch *batch = arg;
+	EncodeInfo *encInfo = malloc(sizeof(EncodeInfo));
+	int job;
+
+	(void)index;
+	if(encInfo == NULL)
+	{
+		return;
+	}
+	while((job = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count)
+	{
+		run_batch_job(&batch->jobs[job], encInfo, batch->options);
+	}
+	free(encInfo);
+}
+
+/* Batch encoding
+ * Description: Reads the manifest, encodes all jobs on a worker pool and
+ * reports every job and the aggregate throughput.
+ * Input: Manifest file name, options (threads > 0 sets the number of workers, one per CPU otherwise)
+ * Output: Stego images of all jobs, report on stdout
+ * Return: e_success if every job succeeded, e_failure otherwise
+ */
+Status do_batch_encoding(const char *manifest_fname, const Options *options)
+{
+	Batch batch;
+	ThreadPool *pool;
+	double start, elapsed_ms;
+	unsigned long image_bytes = 0, secret_bytes = 0;
+	int workers, total, succeeded = 0;
+
+	printf("INFO: Reading manifest %s\n", manifest_fname);
+	if(read_manifest(manifest_fname, &batch) == e_failure)
+	{
+		return e_failure;
+	}
+	if(batch.count == 0)
+	{
+		printf("INFO: No jobs in %s\n", manifest_fname);
+		return e_success;
+	}
+	batch.options = options;
+
+	//No more workers than jobs.
+	workers = options->threads > 0 ? options->threads : thread_pool_cpu_count();
+	if(workers > batch.count)
+	{
+		workers = batch.count;
+	}
+	pool = thread_pool_create(workers);
+	if(pool == NULL)
+	{
+		free_jobs(&batch);
+		return e_failure;
+	}
+	workers = thread_pool_size(pool);
+	printf("INFO: Encoding %d jobs on %d workers\n", batch.count, workers);
+
+	start = batch_now_ms();
+	thread_pool_run(pool, batch_worker, &batch, workers);
+	elapsed_ms = batch_now_ms() - start;
+	thread_pool_destroy(pool);
+
+	//Report the jobs in manifest order.
+	for(int i = 0; i < batch.count; i++)
+	{
+		BatchJob *job = &batch.jobs[i];
+
+		if(job->status == e_success)
+		{
+			succeeded++;
+			image_bytes += job->image_bytes;
+			secret_bytes += job->secret_bytes;
+		}
+		printf("JOB %d: %s %s + %s -> %s %.3f ms\n", job->line, job->status == e_success ? "OK" : "FAILED", job->src_image_fname, job->secret_fname, job->stego_image_fname, job->elapsed_ms);
+	}
+
+	printf("INFO: %d of %d jobs encoded in %.3f ms\n", succeeded, batch.count, elapsed_ms);
+	if(elapsed_ms > 0)
+	{
+		printf("INFO: Throughput %.1f jobs/s, %.1f MB/s image data, %.1f MB/s secret data\n", succeeded * 1000.0 / elapsed_ms, image_bytes / (elapsed_ms * 1000.0), secret_bytes / (elapsed_ms * 1000.0));
+	}
+
+	total = batch.count;
+	free_jobs(&batch);
+	return succeeded == total ? e_success : e_failure;
+}
@@ -0,0 +1,18 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "types.h" // Contains user defined types
+#include "options.h"
+
+/*
+ * Batch encoding: a manifest lists one job per line,
+ * <.bmp file> <secret file> <output .bmp file>
+ * separated by blanks. Empty lines and lines starting with # are skipped.
+ */
+
+/* Batch encoding function prototype */
+
+/* Encode every job of the manifest with the -e options, one worker per CPU unless -j is given */
+Status do_batch_encoding(const char *manifest_fname, const Options *options);
+
+#endif
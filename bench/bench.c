@@ -0,0 +1,531 @@
+/*
+ * End to end encode/decode throughput benchmark.
+ *
+ * Generates synthetic 24-bit BMP carriers and random payloads, then times
+ * do_encoding and do_decoding over repeated runs. Every (operation, carrier,
+ * payload) pair is written as one JSON line to the output file, with ms per
+ * job and MB/s percentiles. The first decode of every pair is checked
+ * against the payload.
+ *
+ * Build from the top directory:
+ *	gcc -O2 -I. bench/bench.c $(ls *.c | grep -v test_encode.c) -pthread -o bench_lsb
+ *
+ * Usage:
+ *	./bench_lsb [--sizes 1,12,50,200] [--payloads 1024,65536,1048576,16777216]
+ *	            [--runs 5] [--engine mmap|stdio] [--kernel avx512|avx2|sse2|scalar]
+ *	            [-j N] [--depth 1-4] [--encrypt] [--scatter] [--dir /tmp] [--out bench_output.txt] [--keep]
+ *
+ * Sizes are in megapixels, payloads in bytes. Pairs whose payload does not
+ * fit the carrier are skipped. Runs are hot cache runs. --encrypt encrypts
+ * with a fixed key, --scatter also scatters the payload over keyed tiles,
+ * so the two runs compare scattered against sequential embedding.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "encode.h"
+#include "decode.h"
+#include "lsb.h"
+#include "stego.h"
+#include "thread_pool.h"
+#include "types.h"
+
+#define BENCH_WIDTH 4000
+#define BENCH_MAX_LIST 16
+#define BENCH_MAX_RUNS 1000
+
+/* Fixed key of --encrypt and --scatter */
+static const unsigned char bench_key[CHACHA20_KEY_SIZE] = "bench key bench key bench key!!";
+
+/* Benchmark settings */
+typedef struct _BenchConfig
+{
+	long sizes[BENCH_MAX_LIST];				//Carrier sizes in megapixels.
+	int size_count;
+	long payloads[BENCH_MAX_LIST];			//Payload sizes in bytes.
+	int payload_count;
+	int runs;								//Timed runs per pair.
+	int use_stdio;							//Encode engine, 1 for stdio, 0 for mmap.
+	int threads;							//-j N, 1 for no pool.
+	int depth;								//Payload bits per carrier byte.
+	int encrypt;							//Encrypt with bench_key.
+	int scatter;							//Scatter over keyed tiles, implies encrypt.
+	const char *dir;						//Directory for generated files.
+	const char *out_fname;					//JSON lines output.
+	int keep;								//Keep generated files.
+} BenchConfig;
+
+/* Function Definitions */
+
+/* Monotonic clock in milliseconds */
+static double bench_now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* Small fast generator for carrier and payload bytes */
+static unsigned long long bench_random(unsigned long long *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/* Fill a buffer with generator output */
+static void bench_fill(char *buffer, size_t size, unsigned long long *state)
+{
+	for(size_t i = 0; i < size; i += 8)
+	{
+		unsigned long long word = bench_random(state);
+
+		memcpy(buffer + i, &word, size - i < 8 ? size - i : 8);
+	}
+}
+
+/* Parse a comma separated list of numbers, returns the count or -1 */
+static int bench_read_list(const char *value, long *list)
+{
+	int count = 0;
+	char *end;
+
+	while(value != NULL && *value != '\0' && count < BENCH_MAX_LIST)
+	{
+		list[count] = strtol(value, &end, 10);
+		if(end == value || list[count] <= 0 || (*end != ',' && *end != '\0'))
+		{
+			return -1;
+		}
+		count++;
+		value = *end == ',' ? end + 1 : end;
+	}
+	return count > 0 ? count : -1;
+}
+
+/* Write a synthetic 24-bit BMP carrier
+ * Input: File name, megapixels
+ * Output: BENCH_WIDTH pixels wide image with random pixels
+ * Return: e_success or e_failure
+ */
+static Status bench_write_carrier(const char *fname, long megapixels)
+{
+	unsigned int width = BENCH_WIDTH, height = megapixels * 1000000 / BENCH_WIDTH;
+	unsigned int row_size = width * 3, image_size = row_size * height;
+	unsigned char header[54] = { 'B', 'M' };
+	unsigned long long state = 0x9e3779b97f4a7c15ULL + megapixels;
+	char *row = malloc(row_size);
+	FILE *fptr = fopen(fname, "w");
+	Status status = e_success;
+
+	if(row == NULL || fptr == NULL)
+	{
+		free(row);
+		if(fptr != NULL)
+		{
+			fclose(fptr);
+		}
+		return e_failure;
+	}
+
+	//BITMAPFILEHEADER and BITMAPINFOHEADER, little endian.
+	*(unsigned int *)(header + 2) = 54 + image_size;
+	*(unsigned int *)(header + 10) = 54;
+	*(unsigned int *)(header + 14) = 40;
+	*(unsigned int *)(header + 18) = width;
+	*(unsigned int *)(header + 22) = height;
+	*(unsigned short *)(header + 26) = 1;
+	*(unsigned short *)(header + 28) = 24;
+	*(unsigned int *)(header + 34) = image_size;
+	fwrite(header, 54, 1, fptr);
+
+	for(unsigned int y = 0; y < height && status == e_success; y++)
+	{
+		bench_fill(row, row_size, &state);
+		if(fwrite(row, row_size, 1, fptr) != 1)
+		{
+			status = e_failure;
+		}
+	}
+
+	free(row);
+	if(fclose(fptr) != 0)
+	{
+		status = e_failure;
+	}
+	return status;
+}
+
+/* Write a random payload file */
+static Status bench_write_payload(const char *fname, long size)
+{
+	unsigned long long state = 0x2545f4914f6cdd1dULL + size;
+	char buffer[SECRET_CHUNK_SIZE];
+	FILE *fptr = fopen(fname, "w");
+
+	if(fptr == NULL)
+	{
+		return e_failure;
+	}
+	for(long done = 0; done < size; done += SECRET_CHUNK_SIZE)
+	{
+		long chunk = size - done < SECRET_CHUNK_SIZE ? size - done : SECRET_CHUNK_SIZE;
+
+		bench_fill(buffer, chunk, &state);
+		fwrite(buffer, chunk, 1, fptr);
+	}
+	return fclose(fptr) == 0 ? e_success : e_failure;
+}
+
+/* Compare two files, returns 1 if they are equal */
+static int bench_same_file(const char *fname1, const char *fname2)
+{
+	FILE *fptr1 = fopen(fname1, "r"), *fptr2 = fopen(fname2, "r");
+	char buffer1[SECRET_CHUNK_SIZE], buffer2[SECRET_CHUNK_SIZE];
+	size_t n1, n2;
+	int same = fptr1 != NULL && fptr2 != NULL;
+
+	while(same)
+	{
+		n1 = fread(buffer1, 1, sizeof(buffer1), fptr1);
+		n2 = fread(buffer2, 1, sizeof(buffer2), fptr2);
+		if(n1 != n2 || memcmp(buffer1, buffer2, n1) != 0)
+		{
+			same = 0;
+		}
+		if(n1 == 0)
+		{
+			break;
+		}
+	}
+	if(fptr1 != NULL)
+	{
+		fclose(fptr1);
+	}
+	if(fptr2 != NULL)
+	{
+		fclose(fptr2);
+	}
+	return same;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest rank percentile of sorted samples */
+static double bench_percentile(const double *sorted, int count, double q)
+{
+	int rank = (int)(q * count);
+
+	//Round up, ranks start at 1.
+	if(rank < q * count)
+	{
+		rank++;
+	}
+	rank--;
+
+	return sorted[rank < 0 ? 0 : rank];
+}
+
+/* Report one pair
+ * Description: Prints a summary line and writes the JSON line.
+ * Input: Output file, config, operation name, sizes, samples in ms
+ * Output: Report lines
+ * Return: None
+ */
+static void bench_report(FILE *fptr_out, const BenchConfig *config, const char *op, long megapixels, long carrier_bytes, long payload_bytes, double *samples, int count)
+{
+	double total = 0, p50, mb;
+
+	qsort(samples, count, sizeof(double), bench_compare);
+	for(int i = 0; i < count; i++)
+	{
+		total += samples[i];
+	}
+	p50 = bench_percentile(samples, count, 0.50);
+	mb = carrier_bytes / 1000000.0;
+
+	printf("%-6s %4ld MP %10ld B  p50 %9.3f ms  p90 %9.3f ms  %8.1f MB/s carrier  %8.1f MB/s payload\n", op, megapixels, payload_bytes, p50, bench_percentile(samples, count, 0.90), mb * 1000.0 / p50, payload_bytes / (p50 * 1000.0));
+
+	fprintf(fptr_out, "{\"op\":\"%s\",\"engine\":\"%s\",\"kernel\":\"%s\",\"threads\":%d,\"depth\":%d,\"encrypted\":%s,\"scatter\":%s,\"megapixels\":%ld,\"carrier_bytes\":%ld,\"payload_bytes\":%ld,\"runs\":%d,"
+		"\"ms_min\":%.4f,\"ms_p50\":%.4f,\"ms_p90\":%.4f,\"ms_p99\":%.4f,\"ms_max\":%.4f,\"ms_mean\":%.4f,"
+		"\"carrier_mb_s_p50\":%.2f,\"payload_mb_s_p50\":%.2f}\n",
+		op, config->use_stdio ? "stdio" : "mmap", lsb_kernel_name(), config->threads, config->depth, config->encrypt ? "true" : "false", config->scatter ? "true" : "false", megapixels, carrier_bytes, payload_bytes, count,
+		samples[0], p50, bench_percentile(samples, count, 0.90), bench_percentile(samples, count, 0.99), samples[count - 1], total / count,
+		mb * 1000.0 / p50, payload_bytes / (p50 * 1000.0));
+	fflush(fptr_out);
+}
+
+/* Time one carrier and payload pair
+ * Description: Runs the encode config->runs times, then the decode of the
+ * last stego image config->runs times, checking the first decode.
+ * Input: Config, pool, file names, sizes, output file
+ * Output: Two report lines
+ * Return: e_success or e_failure if an encode or decode fails
+ */
+static Status bench_pair(const BenchConfig *config, ThreadPool *pool, const char *carrier_fname, const char *payload_fname, long megapixels, long payload_size, FILE *fptr_out)
+{
+	char stego_fname[512], output_base[512], output_fname[520];
+	char *enc_argv[] = { "bench", "-e", (char *)carrier_fname, (char *)payload_fname, stego_fname, NULL };
+	char *dec_argv[] = { "bench", "-d", stego_fname, output_base, NULL };
+	EncodeInfo *encInfo = malloc(sizeof(EncodeInfo));
+	DecodeInfo *decInfo = malloc(sizeof(DecodeInfo));
+	double samples[BENCH_MAX_RUNS];
+	long carrier_bytes = 0;
+	Status status = e_success;
+
+	snprintf(stego_fname, sizeof(stego_fname), "%s/bench_stego.bmp", config->dir);
+	snprintf(output_base, sizeof(output_base), "%s/bench_decoded", config->dir);
+	snprintf(output_fname, sizeof(output_fname), "%s.txt", output_base);
+
+	if(encInfo == NULL || decInfo == NULL)
+	{
+		status = e_failure;
+	}
+
+	for(int run = 0; run < config->runs && status == e_success; run++)
+	{
+		double start = bench_now_ms();
+
+		encInfo->in_place = 0;
+		encInfo->quiet = 1;
+		if(read_and_validate_encode_args(enc_argv, encInfo) == e_failure)
+		{
+			status = e_failure;
+			break;
+		}
+		encInfo->pool = pool;
+		encInfo->stats = NULL;
+		encInfo->use_stdio = config->use_stdio;
+		encInfo->stdin_fd = STDIN_FILENO;
+		encInfo->stdout_fd = STDOUT_FILENO;
+		encInfo->depth = config->depth;
+		encInfo->compress = 0;
+		encInfo->crc = 0;
+		encInfo->key = config->encrypt ? bench_key : NULL;
+		encInfo->scatter = config->scatter;
+		encInfo->secret_offset = 0;
+		encInfo->secret_part = -1;
+		encInfo->stripe = NULL;
+		status = do_encoding(encInfo);
+		close_files(encInfo);
+		samples[run] = bench_now_ms() - start;
+		carrier_bytes = (long)carrier_offset(&encInfo->carrier, encInfo->image_capacity);
+	}
+	if(status == e_success)
+	{
+		bench_report(fptr_out, config, "encode", megapixels, carrier_bytes, payload_size, samples, config->runs);
+	}
+
+	for(int run = 0; run < config->runs && status == e_success; run++)
+	{
+		double start = bench_now_ms();
+
+		if(read_and_validate_decode(dec_argv, decInfo) == e_failure)
+		{
+			status = e_failure;
+			break;
+		}
+		decInfo->pool = pool;
+		decInfo->quiet = 1;
+		decInfo->stats = NULL;
+		decInfo->key = config->encrypt ? bench_key : NULL;
+		decInfo->stripe_set = 0;
+		decInfo->stdin_fd = STDIN_FILENO;
+		decInfo->stdout_fd = STDOUT_FILENO;
+		status = do_decoding(decInfo);
+		close_decode_files(decInfo);
+		samples[run] = bench_now_ms() - start;
+
+		if(run == 0 && status == e_success && !bench_same_file(output_fname, payload_fname))
+		{
+			fprintf(stderr, "ERROR: Decoded data differs from %s\n", payload_fname);
+			status = e_failure;
+		}
+	}
+	if(status == e_success)
+	{
+		bench_report(fptr_out, config, "decode", megapixels, carrier_bytes, payload_size, samples, config->runs);
+	}
+	else
+	{
+		fprintf(stderr, "ERROR: %ld MP carrier with %ld byte payload failed\n", megapixels, payload_size);
+	}
+
+	if(!config->keep)
+	{
+		remove(stego_fname);
+		remove(output_fname);
+	}
+	free(decInfo);
+	free(encInfo);
+	return status;
+}
+
+/* Read benchmark arguments, returns 0 on success */
+static int bench_read_args(int argc, char *argv[], BenchConfig *config)
+{
+	const char *dir = getenv("TMPDIR");
+
+	config->size_count = bench_read_list("1,12,50,200", config->sizes);
+	config->payload_count = bench_read_list("1024,65536,1048576,16777216", config->payloads);
+	config->runs = 5;
+	config->use_stdio = 0;
+	config->threads = 1;
+	config->depth = 1;
+	config->encrypt = 0;
+	config->scatter = 0;
+	config->dir = dir != NULL ? dir : "/tmp";
+	config->out_fname = "bench_output.txt";
+	config->keep = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if(strcmp(argv[i], "--keep") == 0)
+		{
+			config->keep = 1;
+			continue;
+		}
+		if(strcmp(argv[i], "--encrypt") == 0 || strcmp(argv[i], "--scatter") == 0)
+		{
+			config->encrypt = 1;
+			config->scatter |= strcmp(argv[i], "--scatter") == 0;
+			continue;
+		}
+		if(value == NULL)
+		{
+			return -1;
+		}
+		i++;
+		if(strcmp(argv[i - 1], "--sizes") == 0)
+		{
+			config->size_count = bench_read_list(value, config->sizes);
+		}
+		else if(strcmp(argv[i - 1], "--payloads") == 0)
+		{
+			config->payload_count = bench_read_list(value, config->payloads);
+		}
+		else if(strcmp(argv[i - 1], "--runs") == 0)
+		{
+			config->runs = atoi(value);
+		}
+		else if(strcmp(argv[i - 1], "--engine") == 0 && (strcmp(value, "mmap") == 0 || strcmp(value, "stdio") == 0))
+		{
+			config->use_stdio = strcmp(value, "stdio") == 0;
+		}
+		else if(strcmp(argv[i - 1], "--kernel") == 0)
+		{
+			if(lsb_select_kernel(value) != 0)
+			{
+				fprintf(stderr, "ERROR: Kernel %s is not supported here\n", value);
+				return -1;
+			}
+		}
+		else if(strcmp(argv[i - 1], "-j") == 0)
+		{
+			config->threads = atoi(value);
+		}
+		else if(strcmp(argv[i - 1], "--depth") == 0)
+		{
+			config->depth = atoi(value);
+		}
+		else if(strcmp(argv[i - 1], "--dir") == 0)
+		{
+			config->dir = value;
+		}
+		else if(strcmp(argv[i - 1], "--out") == 0)
+		{
+			config->out_fname = value;
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	if(config->size_count < 0 || config->payload_count < 0 || config->runs < 1 || config->runs > BENCH_MAX_RUNS || config->threads < 0 || config->depth < 1 || config->depth > STEGO_MAX_DEPTH || (config->scatter && config->use_stdio))
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchConfig config;
+	ThreadPool *pool = NULL;
+	FILE *fptr_out;
+	int failures = 0;
+
+	if(bench_read_args(argc, argv, &config) != 0)
+	{
+		printf("%s [--sizes MP,...] [--payloads BYTES,...] [--runs N] [--engine mmap|stdio] [--kernel avx512|avx2|sse2|scalar] [-j N] [--depth 1-4] [--encrypt] [--scatter] [--dir DIR] [--out FILE] [--keep]\n", argv[0]);
+		return 1;
+	}
+	fptr_out = fopen(config.out_fname, "w");
+	if(fptr_out == NULL)
+	{
+		perror(config.out_fname);
+		return 1;
+	}
+	if(config.threads != 1)
+	{
+		pool = thread_pool_create(config.threads);
+	}
+	printf("INFO: engine %s, kernel %s, %d threads, depth %d, %s, %d runs\n", config.use_stdio ? "stdio" : "mmap", lsb_kernel_name(), pool != NULL ? thread_pool_size(pool) : 1, config.depth, config.scatter ? "scattered" : config.encrypt ? "encrypted" : "plain", config.runs);
+
+	for(int s = 0; s < config.size_count; s++)
+	{
+		char carrier_fname[512];
+		long megapixels = config.sizes[s];
+		long capacity = megapixels * 1000000 / BENCH_WIDTH * BENCH_WIDTH * 3;
+
+		snprintf(carrier_fname, sizeof(carrier_fname), "%s/bench_carrier_%ldmp.bmp", config.dir, megapixels);
+		if(bench_write_carrier(carrier_fname, megapixels) == e_failure)
+		{
+			fprintf(stderr, "ERROR: Unable to write %s\n", carrier_fname);
+			failures++;
+			continue;
+		}
+
+		for(int p = 0; p < config.payload_count; p++)
+		{
+			char payload_fname[512];
+			long payload_size = config.payloads[p];
+
+			//Same rule as check_capacity.
+			if((long)stego_required_size(".txt", payload_size, config.depth, (config.encrypt ? ENCRYPTED_FLAG : 0) | (config.scatter ? SCATTER_FLAG : 0)) > capacity)
+			{
+				continue;
+			}
+			snprintf(payload_fname, sizeof(payload_fname), "%s/bench_payload_%ld.txt", config.dir, payload_size);
+			if(bench_write_payload(payload_fname, payload_size) == e_failure || bench_pair(&config, pool, carrier_fname, payload_fname, megapixels, payload_size, fptr_out) == e_failure)
+			{
+				failures++;
+			}
+			if(!config.keep)
+			{
+				remove(payload_fname);
+			}
+		}
+		if(!config.keep)
+		{
+			remove(carrier_fname);
+		}
+	}
+
+	thread_pool_destroy(pool);
+	fclose(fptr_out);
+	printf("INFO: Results written to %s\n", config.out_fname);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * CRC32C combine check.
+ *
+ * Checks crc32c_combine against one running CRC32C over both pieces, for
+ * second pieces on both sides of 2^29 and 2^32 bytes, where the x^(2^k)
+ * table runs past 32 entries. The second piece is generator output
+ * streamed through a 1 MiB buffer, so no size needs its memory.
+ *
+ * Build from the top directory:
+ *	gcc -O2 -I. bench/crc32c_check.c crc32c.c -o crc32c_check
+ *
+ * Usage:
+ *	./crc32c_check
+ *
+ * CRC32C_KERNEL=table in the environment checks the table kernel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32c.h"
+#include "types.h"
+
+#define CHECK_BUFFER_SIZE (1 << 20)
+#define CHECK_FIRST_SIZE 1000
+
+/* Second piece sizes, the large ones are the ones a -j slice of a big payload reaches */
+static const unsigned long long check_sizes[] = { 0, 1, 7, 4096, 536870904ull, 536870912ull, 536870919ull, 1073741827ull, 4294967295ull, 4294968300ull };
+
+/* Function Definitions */
+
+/* Small fast generator for the data */
+static unsigned long long check_random(unsigned long long *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/* Fill a buffer with generator output */
+static void check_fill(char *buffer, size_t size, unsigned long long *state)
+{
+	for(size_t i = 0; i < size; i += 8)
+	{
+		unsigned long long word = check_random(state);
+
+		memcpy(buffer + i, &word, size - i < 8 ? size - i : 8);
+	}
+}
+
+int main(void)
+{
+	char *buffer = malloc(CHECK_BUFFER_SIZE);
+	unsigned long long state = 0x9e3779b97f4a7c15ull;
+	uint crc_a;
+	int failures = 0;
+
+	if(buffer == NULL)
+	{
+		perror("malloc");
+		return 1;
+	}
+	check_fill(buffer, CHECK_FIRST_SIZE, &state);
+	crc_a = crc32c(0, buffer, CHECK_FIRST_SIZE);
+
+	//One running CRC over both pieces against the combined CRC of each.
+	for(size_t i = 0; i < sizeof(check_sizes) / sizeof(check_sizes[0]); i++)
+	{
+		size_t size = check_sizes[i];
+		uint crc_b = 0, crc_ab = crc_a, combined;
+
+		check_fill(buffer, CHECK_BUFFER_SIZE, &state);
+		for(size_t done = 0; done < size; done += CHECK_BUFFER_SIZE)
+		{
+			size_t chunk = size - done < CHECK_BUFFER_SIZE ? size - done : CHECK_BUFFER_SIZE;
+
+			crc_b = crc32c(crc_b, buffer, chunk);
+			crc_ab = crc32c(crc_ab, buffer, chunk);
+		}
+		combined = crc32c_combine(crc_a, crc_b, size);
+		printf("%s %zu bytes: %08x %08x\n", combined == crc_ab ? "OK  " : "FAIL", size, combined, crc_ab);
+		failures += combined != crc_ab;
+	}
+	printf("crc32c_combine (%s): %d failures\n", crc32c_kernel_name(), failures);
+	free(buffer);
+	return failures != 0;
+}
@@ -0,0 +1,92 @@
+#!/bin/bash
+#
+# Large payload check.
+#
+# Encodes a 4,294,968,300 byte payload, past 4 GB so it takes LARGE_FLAG
+# and its 64 bit size fields, at depth 4 into a 8.6 GB 24-bit BMP carrier
+# and decodes it back. Every run uses --crc and -j, whose slices are
+# past 2^29 bytes each, and is decoded on -j and on one thread. The
+# mapped, in-place and scattered encoders are covered.
+#
+# Carrier and payload are sparse files: the payload is zeros with random
+# 1 MiB blocks around the 2^29, 2^31 and 2^32 byte marks and at both
+# ends, so the carrier takes no disk space until it is written. About
+# 18 GB of disk is used at the peak, for one stego image, one decoded
+# output and the payload blocks.
+#
+# Run from the top directory, files go to DIR (/tmp by default):
+#	bench/large_check.sh [DIR]
+#
+
+dir=${1:-/tmp}/lsb_large_check
+lsb=$dir/lsb
+payload_size=4294968300
+width=65536
+height=44000
+failures=0
+
+mkdir -p "$dir" || exit 1
+gcc -O2 *.c -pthread -o "$lsb" || exit 1
+
+# Little endian 16 and 32 bit header fields.
+le16() { printf "$(printf '\\x%02x\\x%02x' $(($1 & 255)) $(($1 >> 8 & 255)))"; }
+le32() { le16 $(($1 & 65535)); le16 $(($1 >> 16 & 65535)); }
+
+# Run one step, counting and reporting failures.
+step()
+{
+	local name=$1 start=$SECONDS
+
+	shift
+	if "$@"; then
+		echo "OK   $name ($((SECONDS - start)) s)"
+	else
+		echo "FAIL $name ($((SECONDS - start)) s)"
+		failures=$((failures + 1))
+	fi
+}
+
+# Decode a stego image on -j 2 and on one thread, both have to give the payload back.
+check_decode()
+{
+	local stego=$1
+
+	shift
+	step "decode -j 2 $stego" "$lsb" -d "$dir/$stego" "$dir/out" -q -j 2 "$@"
+	step "compare -j 2 $stego" cmp "$dir/out.txt" "$dir/payload.txt"
+	rm -f "$dir/out.txt"
+	step "decode $stego" "$lsb" -d "$dir/$stego" "$dir/out" -q "$@"
+	step "compare $stego" cmp "$dir/out.txt" "$dir/payload.txt"
+	rm -f "$dir/out.txt" "$dir/$stego"
+}
+
+# Sparse carrier: BMP header, zero pixels. The 32 bit size fields are left 0, they cannot hold the size.
+rm -f "$dir/carrier.bmp" "$dir/payload.txt"
+{ printf "BM"; le32 0; le32 0; le32 54; le32 40; le32 $width; le32 $height; le16 1; le16 24; le32 0; le32 0; le32 2835; le32 2835; le32 0; le32 0; } > "$dir/carrier.bmp"
+truncate -s $((54 + width * 3 * height)) "$dir/carrier.bmp"
+
+# Sparse payload with random blocks where the slices and size fields are most likely to go wrong, the last one crosses 2^32.
+truncate -s $payload_size "$dir/payload.txt"
+for mib in 0 511 512 2047 2048 4094 4095; do
+	dd if=/dev/urandom of="$dir/payload.txt" bs=1M seek=$mib count=1 conv=notrunc status=none
+done
+dd if=/dev/urandom of="$dir/payload.txt" bs=1 seek=$((payload_size - 4096)) count=4096 conv=notrunc status=none
+
+# Mapped engine, slices on -j 2.
+step "encode -k 4 --crc -j 2" "$lsb" -e "$dir/carrier.bmp" "$dir/payload.txt" "$dir/mapped.bmp" -q -k 4 --crc -j 2
+check_decode mapped.bmp
+
+# In place on a sparse copy of the carrier.
+cp --sparse=always "$dir/carrier.bmp" "$dir/inplace.bmp"
+step "encode --in-place -k 4 --crc -j 2" "$lsb" -e "$dir/inplace.bmp" "$dir/payload.txt" --in-place -q -k 4 --crc -j 2
+check_decode inplace.bmp
+
+# Encrypted and scattered over keyed tiles.
+export LSB_LARGE_KEY=000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f
+step "encode --scatter -k 4 --crc -j 2" "$lsb" -e "$dir/carrier.bmp" "$dir/payload.txt" "$dir/scattered.bmp" -q -k 4 --crc -j 2 --key-env LSB_LARGE_KEY --scatter
+check_decode scattered.bmp --key-env LSB_LARGE_KEY
+
+rm -f "$dir/carrier.bmp" "$dir/payload.txt" "$lsb"
+rmdir "$dir" 2>/dev/null
+echo "large check: $failures failures"
+[ $failures -eq 0 ]
@@ -0,0 +1,457 @@
+#include <stdint.h>
+#include <string.h>
+#include "carrier.h"
+#include "lsb.h"
+
+#define BMP_HEADER_MIN 54					//File header and BITMAPINFOHEADER.
+#define BMP_BI_RGB 0
+#define BMP_BI_BITFIELDS 3
+#define TGA_HEADER_SIZE 18
+#define TGA_TRUE_COLOR 2
+#define TGA_TOP_DOWN 0x20
+
+/* Function Definitions */
+
+/* Read a little endian 16 bit field */
+static uint carrier_load16(const char *bytes)
+{
+	return (uint)(unsigned char)bytes[0] | (uint)(unsigned char)bytes[1] << 8;
+}
+
+/* Read a little endian 32 bit field */
+static uint32_t carrier_load32(const char *bytes)
+{
+	return carrier_load16(bytes) | (uint32_t)carrier_load16(bytes + 2) << 16;
+}
+
+/* Embed into a flat pixel array, one kernel call */
+static void carrier_embed_flat(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth)
+{
+	(void)carrier;
+	(void)pos;
+	lsb_embed_depth(dst, src, data, size, depth);
+}
+
+/* Extract from a flat pixel array, one kernel call */
+static void carrier_extract_flat(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth)
+{
+	(void)carrier;
+	(void)pos;
+	lsb_extract_depth(data, src, size, depth);
+}
+
+/* Payload bytes that fit whole before the end of the row of carrier byte pos, at most size */
+static size_t carrier_row_bytes(const Carrier *carrier, size_t pos, size_t size, int depth)
+{
+	//Depth 3 packs 3 payload bytes into 8 carrier bytes, the others whole bytes.
+	size_t group = depth == 3 ? 3 : 1;
+	size_t bytes = (carrier->row_size - pos % carrier->row_size) * depth / 8 / group * group;
+
+	return bytes < size ? bytes : size;
+}
+
+/* Embed into padded rows
+ * Description: The kernel runs once per row. The few payload bytes whose
+ * carrier bytes cross the padding are embedded into a copy of them, which
+ * is put back around the padding.
+ * Input: Carrier, destination and source file bytes from carrier byte pos on, data, data size, depth
+ * Output: Data embedded into the carrier bytes, padding untouched
+ * Return: None
+ */
+static void carrier_embed_rows(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth)
+{
+	size_t base = carrier_offset(carrier, pos);
+
+	while(size > 0)
+	{
+		size_t bytes = carrier_row_bytes(carrier, pos, size, depth);
+		size_t offset = carrier_offset(carrier, pos) - base;
+
+		if(bytes > 0)
+		{
+			lsb_embed_depth(dst + offset, src + offset, data, bytes, depth);
+		}
+		else
+		{
+			char group[8];
+			size_t count;
+
+			bytes = depth == 3 && size >= 3 ? 3 : 1;
+			count = lsb_carrier_bytes(bytes, depth);
+			for(size_t i = 0; i < count; i++)
+			{
+				group[i] = src[carrier_offset(carrier, pos + i) - base];
+			}
+			lsb_embed_depth(group, group, data, bytes, depth);
+			for(size_t i = 0; i < count; i++)
+			{
+				dst[carrier_offset(carrier, pos + i) - base] = group[i];
+			}
+		}
+		pos += lsb_carrier_bytes(bytes, depth);
+		data += bytes;
+		size -= bytes;
+	}
+}
+
+/* Extract from padded rows, the inverse of carrier_embed_rows */
+static void carrier_extract_rows(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth)
+{
+	size_t base = carrier_offset(carrier, pos);
+
+	while(size > 0)
+	{
+		size_t bytes = carrier_row_bytes(carrier, pos, size, depth);
+
+		if(bytes > 0)
+		{
+			lsb_extract_depth(data, src + carrier_offset(carrier, pos) - base, bytes, depth);
+		}
+		else
+		{
+			char group[8];
+			size_t count;
+
+			bytes = depth == 3 && size >= 3 ? 3 : 1;
+			count = lsb_carrier_bytes(bytes, depth);
+			for(size_t i = 0; i < count; i++)
+			{
+				group[i] = src[carrier_offset(carrier, pos + i) - base];
+			}
+			lsb_extract_depth(data, group, bytes, depth);
+		}
+		pos += lsb_carrier_bytes(bytes, depth);
+		data += bytes;
+		size -= bytes;
+	}
+}
+
+/* Parse a BMP header
+ * Description: BITMAPINFOHEADER or a later version, uncompressed 24 or
+ * 32 bits per pixel (32 with bit fields too). A negative height is a top
+ * down image. Rows are padded to 4 bytes.
+ * Input: Carrier, prefix of at least BMP_HEADER_MIN bytes
+ * Output: Layout in carrier
+ * Return: e_success or e_failure
+ */
+static Status carrier_parse_bmp(Carrier *carrier, const char *prefix)
+{
+	uint32_t data_offset = carrier_load32(prefix + 10), info_size = carrier_load32(prefix + 14);
+	int32_t width = (int32_t)carrier_load32(prefix + 18), height = (int32_t)carrier_load32(prefix + 22);
+	uint bits = carrier_load16(prefix + 28);
+	uint32_t compression = carrier_load32(prefix + 30);
+
+	if(info_size < BMP_HEADER_MIN - 14 || data_offset < 14 + info_size || width <= 0 || height == 0 || height == INT32_MIN || carrier_load16(prefix + 26) != 1)
+	{
+		return e_failure;
+	}
+	if(!(bits == 24 && compression == BMP_BI_RGB) && !(bits == 32 && (compression == BMP_BI_RGB || compression == BMP_BI_BITFIELDS)))
+	{
+		return e_failure;
+	}
+	carrier->format = e_carrier_bmp;
+	carrier->data_offset = data_offset;
+	carrier->width = width;
+	carrier->height = height < 0 ? -height : height;
+	carrier->top_down = height < 0;
+	carrier->pixel_size = bits / 8;
+	carrier->row_size = (size_t)carrier->width * carrier->pixel_size;
+	carrier->stride = (carrier->row_size + 3) & ~(size_t)3;
+
+	return e_success;
+}
+
+/* Read a PPM header number
+ * Description: Skips whitespace and comments up to the number.
+ * Input: Prefix, its size, position of the parse
+ * Output: Number in value, position moved past it
+ * Return: e_success, or e_failure if there is no number or the prefix ends first (pos is then past the prefix)
+ */
+static Status carrier_ppm_number(const char *prefix, size_t prefix_size, size_t *pos, uint *value)
+{
+	size_t i = *pos;
+
+	for(;;)
+	{
+		if(i >= prefix_size)
+		{
+			*pos = i;
+			return e_failure;
+		}
+		if(prefix[i] == '#')
+		{
+			while(i < prefix_size && prefix[i] != '\n')
+			{
+				i++;
+			}
+		}
+		else if(prefix[i] == ' ' || prefix[i] == '\t' || prefix[i] == '\n' || prefix[i] == '\r')
+		{
+			i++;
+		}
+		else
+		{
+			break;
+		}
+	}
+	if(prefix[i] < '0' || prefix[i] > '9')
+	{
+		*pos = 0;
+		return e_failure;
+	}
+	*value = 0;
+	while(i < prefix_size && prefix[i] >= '0' && prefix[i] <= '9')
+	{
+		if(*value > 0xffffff)
+		{
+			*pos = 0;
+			return e_failure;
+		}
+		*value = *value * 10 + (prefix[i++] - '0');
+	}
+	*pos = i;
+	//The number only ends at whitespace.
+	return i < prefix_size ? e_success : e_failure;
+}
+
+/* Parse a binary PPM header
+ * Description: P6, width, height and a maximum sample value below 256,
+ * then a single whitespace byte before the pixels. Rows are not padded.
+ * Input: Carrier, prefix and its size
+ * Output: Layout in carrier, or in need a longer prefix to retry with
+ * Return: e_success or e_failure
+ */
+static Status carrier_parse_ppm(Carrier *carrier, const char *prefix, size_t prefix_size, size_t *need)
+{
+	uint values[3];
+	size_t pos = 2;
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(carrier_ppm_number(prefix, prefix_size, &pos, &values[i]) == e_failure)
+		{
+			*need = pos >= prefix_size ? prefix_size + 1 : 0;
+			return e_failure;
+		}
+	}
+	if(values[0] == 0 || values[1] == 0 || values[2] == 0 || values[2] > 255 || (prefix[pos] != ' ' && prefix[pos] != '\t' && prefix[pos] != '\n' && prefix[pos] != '\r'))
+	{
+		return e_failure;
+	}
+	carrier->format = e_carrier_ppm;
+	carrier->data_offset = pos + 1;
+	carrier->width = values[0];
+	carrier->height = values[1];
+	carrier->top_down = 1;
+	carrier->pixel_size = 3;
+	carrier->row_size = (size_t)carrier->width * 3;
+	carrier->stride = carrier->row_size;
+
+	return e_success;
+}
+
+/* Parse a TGA header
+ * Description: Uncompressed true color, 24 or 32 bits per pixel. The image
+ * ID and a color map (allowed, unused) come before the pixels. Rows are
+ * not padded.
+ * Input: Carrier, prefix of at least TGA_HEADER_SIZE bytes
+ * Output: Layout in carrier
+ * Return: e_success or e_failure
+ */
+static Status carrier_parse_tga(Carrier *carrier, const char *prefix)
+{
+	const unsigned char *header = (const unsigned char *)prefix;
+	uint width = carrier_load16(prefix + 12), height = carrier_load16(prefix + 14);
+
+	if(header[1] > 1 || header[2] != TGA_TRUE_COLOR || (header[16] != 24 && header[16] != 32) || width == 0 || height == 0)
+	{
+		return e_failure;
+	}
+	carrier->format = e_carrier_tga;
+	carrier->data_offset = TGA_HEADER_SIZE + header[0] + (header[1] ? carrier_load16(prefix + 5) * ((header[7] + 7) / 8) : 0);
+	carrier->width = width;
+	carrier->height = height;
+	carrier->top_down = (header[17] & TGA_TOP_DOWN) != 0;
+	carrier->pixel_size = header[16] / 8;
+	carrier->row_size = (size_t)width * carrier->pixel_size;
+	carrier->stride = carrier->row_size;
+
+	return e_success;
+}
+
+/* Image file name
+ * Input: File name
+ * Output: None
+ * Return: Non zero if the name ends in .bmp, .ppm or .tga
+ */
+int carrier_image_name(const char *fname)
+{
+	const char *extn = strrchr(fname, '.');
+
+	return extn != NULL && (strcmp(extn, ".bmp") == 0 || strcmp(extn, ".ppm") == 0 || strcmp(extn, ".tga") == 0);
+}
+
+/* Parse an image header
+ * Description: BMP and PPM are told apart by their magic bytes, anything
+ * else has to be a valid TGA header. The layout functions are picked here,
+ * so the per byte loops never look at the format or the padding again.
+ * Input: Carrier, image prefix and its size
+ * Output: Layout in carrier, or in need (when not NULL) the prefix size to retry with if the prefix is too short, 0 if it can never parse
+ * Return: e_success or e_failure
+ */
+Status carrier_parse(Carrier *carrier, const char *prefix, size_t prefix_size, size_t *need)
+{
+	size_t more = 0;
+	Status status;
+
+	if(prefix_size >= 2 && prefix[0] == 'B' && prefix[1] == 'M')
+	{
+		more = prefix_size < BMP_HEADER_MIN ? BMP_HEADER_MIN : 0;
+		status = more ? e_failure : carrier_parse_bmp(carrier, prefix);
+	}
+	else if(prefix_size >= 2 && prefix[0] == 'P' && prefix[1] == '6')
+	{
+		status = carrier_parse_ppm(carrier, prefix, prefix_size, &more);
+	}
+	else
+	{
+		more = prefix_size < TGA_HEADER_SIZE ? TGA_HEADER_SIZE : 0;
+		status = more ? e_failure : carrier_parse_tga(carrier, prefix);
+	}
+	if(need != NULL)
+	{
+		*need = more <= CARRIER_HEADER_MAX ? more : 0;
+	}
+	if(status == e_failure)
+	{
+		return e_failure;
+	}
+	carrier->embed = carrier->stride == carrier->row_size ? carrier_embed_flat : carrier_embed_rows;
+	carrier->extract = carrier->stride == carrier->row_size ? carrier_extract_flat : carrier_extract_rows;
+
+	return e_success;
+}
+
+/* Read an image header from a stream
+ * Description: Reads no more of the header than the format needs, then
+ * skips to the pixels, so pipes work as well as files.
+ * Input: Carrier, stream at the start of the image
+ * Output: Layout in carrier, stream at the first pixel row
+ * Return: e_success or e_failure
+ */
+Status carrier_read(Carrier *carrier, FILE *fptr)
+{
+	return carrier_copy_header(carrier, fptr, NULL);
+}
+
+/* Copy an image header from a stream
+ * Description: carrier_read that also writes every byte before the pixels
+ * to fptr_copy, so a stream that cannot be read twice still gets its
+ * header copied.
+ * Input: Carrier, stream at the start of the image, stream to copy to or NULL
+ * Output: Layout in carrier, stream at the first pixel row, header written to fptr_copy
+ * Return: e_success or e_failure
+ */
+Status carrier_copy_header(Carrier *carrier, FILE *fptr, FILE *fptr_copy)
+{
+	char prefix[CARRIER_HEADER_MAX];
+	size_t size = 0, need = 2;
+
+	//Grow the prefix until the header parses or cannot.
+	for(;;)
+	{
+		if(fread(prefix + size, 1, need - size, fptr) != need - size)
+		{
+			return e_failure;
+		}
+		size = need;
+		if(carrier_parse(carrier, prefix, size, &need) == e_success)
+		{
+			break;
+		}
+		if(need <= size)
+		{
+			return e_failure;
+		}
+	}
+	if(fptr_copy != NULL && fwrite(prefix, 1, size, fptr_copy) != size)
+	{
+		return e_failure;
+	}
+	//Skip whatever lies between the header and the pixels.
+	while(size < carrier->data_offset)
+	{
+		size_t skip = carrier->data_offset - size < sizeof(prefix) ? carrier->data_offset - size : sizeof(prefix);
+
+		if(fread(prefix, 1, skip, fptr) != skip || (fptr_copy != NULL && fwrite(prefix, 1, skip, fptr_copy) != skip))
+		{
+			return e_failure;
+		}
+		size += skip;
+	}
+	return e_success;
+}
+
+/* Check the pixel rows against the file size, the last row with its padding */
+Status carrier_fits(const Carrier *carrier, size_t file_size)
+{
+	if(carrier->data_offset > file_size || (file_size - carrier->data_offset) / carrier->stride < carrier->height)
+	{
+		return e_failure;
+	}
+	return e_success;
+}
+
+/* Name of the image format */
+const char *carrier_format_name(const Carrier *carrier)
+{
+	static const char *names[] = { "bmp", "ppm", "tga" };
+
+	return names[carrier->format];
+}
+
+/* Number of carrier bytes */
+size_t carrier_size(const Carrier *carrier)
+{
+	return carrier->row_size * carrier->height;
+}
+
+/* File offset of a carrier byte
+ * Input: Carrier, carrier byte
+ * Output: None
+ * Return: File offset, the first pixel of the next row for a byte just past a row
+ */
+size_t carrier_offset(const Carrier *carrier, size_t pos)
+{
+	if(carrier->stride == carrier->row_size)
+	{
+		return carrier->data_offset + pos;
+	}
+	return carrier->data_offset + pos / carrier->row_size * carrier->stride + pos % carrier->row_size;
+}
+
+/* File bytes of a range of carrier bytes, the padding inside it included */
+size_t carrier_span(const Carrier *carrier, size_t pos, size_t count)
+{
+	return carrier_offset(carrier, pos + count) - carrier_offset(carrier, pos);
+}
+
+/* Embed into carrier bytes
+ * Input: Carrier, destination and source file bytes from carrier byte pos on, data, data size, depth
+ * Output: lsb_carrier_bytes(size, depth) carrier bytes with the data in their low bits
+ * Return: None
+ */
+void carrier_embed(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth)
+{
+	carrier->embed(carrier, dst, src, pos, data, size, depth);
+}
+
+/* Extract from carrier bytes
+ * Input: Carrier, data buffer, file bytes from carrier byte pos on, data size, depth
+ * Output: size bytes rebuilt from the low bits of the carrier bytes
+ * Return: None
+ */
+void carrier_extract(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth)
+{
+	carrier->extract(carrier, data, src, pos, size, depth);
+}
@@ -0,0 +1,86 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Uncompressed carrier images: BMP (24 and 32 bits per pixel, bottom up
+ * or top down, any bfOffBits), binary PPM (P6, 8 bit samples) and
+ * uncompressed true color TGA (24 and 32 bits per pixel).
+ * The carrier bytes are the pixel bytes of every row in file order, row
+ * padding left out, numbered from 0. Everything that embeds or extracts
+ * addresses carrier bytes and finds their file bytes here. Images whose
+ * rows have no padding are one flat run, padded rows go one row at a
+ * time, the layout is picked once when the header is parsed.
+ */
+
+#define CARRIER_HEADER_MAX 1024			//Prefix that holds any supported header, pixel data may start later.
+/* Most file bytes count carrier bytes span: rows of a 1 pixel wide 24 bit BMP, 3 carrier bytes in 4 */
+#define CARRIER_SPAN_MAX(count) ((count) / 3 * 4 + 8)
+
+typedef enum
+{
+    e_carrier_bmp,
+    e_carrier_ppm,
+    e_carrier_tga
+} CarrierFormat;
+
+struct _Carrier;
+
+/* Layout function types, dst and src hold the file bytes from carrier byte pos on */
+typedef void (*CarrierEmbedFn)(const struct _Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth);
+typedef void (*CarrierExtractFn)(const struct _Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth);
+
+/* Pixel layout of an image */
+typedef struct _Carrier
+{
+    CarrierFormat format;
+    size_t data_offset;						//File offset of the first pixel row.
+    uint width;
+    uint height;
+    uint pixel_size;						//Bytes per pixel, 3 or 4.
+    size_t row_size;						//Carrier bytes per row.
+    size_t stride;							//File bytes per row, padding included.
+    int top_down;							//Non zero if the top row comes first.
+    CarrierEmbedFn embed;					//Flat or padded rows.
+    CarrierExtractFn extract;
+} Carrier;
+
+/* Carrier function prototypes */
+
+/* Non zero if fname ends in an image extension (.bmp, .ppm, .tga) */
+int carrier_image_name(const char *fname);
+
+/* Parse the image header in prefix, need is set to a longer prefix to retry with when it is cut short */
+Status carrier_parse(Carrier *carrier, const char *prefix, size_t prefix_size, size_t *need);
+
+/* Parse the image header read from the start of a stream, the stream is left at the first pixel row */
+Status carrier_read(Carrier *carrier, FILE *fptr);
+
+/* carrier_read that writes the header bytes read to fptr_copy as well, NULL for none */
+Status carrier_copy_header(Carrier *carrier, FILE *fptr, FILE *fptr_copy);
+
+/* Check that the pixel rows end inside a file of file_size bytes */
+Status carrier_fits(const Carrier *carrier, size_t file_size);
+
+/* Name of the image format */
+const char *carrier_format_name(const Carrier *carrier);
+
+/* Number of carrier bytes */
+size_t carrier_size(const Carrier *carrier);
+
+/* File offset of carrier byte pos */
+size_t carrier_offset(const Carrier *carrier, size_t pos);
+
+/* File bytes from carrier byte pos to carrier byte pos + count */
+size_t carrier_span(const Carrier *carrier, size_t pos, size_t count);
+
+/* Embed size bytes at depth bits per carrier byte from carrier byte pos on, dst may be src */
+void carrier_embed(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth);
+
+/* Extract size bytes stored at depth bits per carrier byte from carrier byte pos on */
+void carrier_extract(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth);
+
+#endif
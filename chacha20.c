@@ -0,0 +1,113 @@
+#include <string.h>
+#include "chacha20.h"
+
+#define CHACHA20_BLOCK_SIZE 64
+#define CHACHA20_LANES 4
+
+/* The same state word of CHACHA20_LANES consecutive blocks, SSE2 or NEON sized */
+typedef uint32_t ChaChaLanes __attribute__((vector_size(CHACHA20_LANES * sizeof(uint32_t))));
+
+#define CHACHA20_ROTL(v, n) ((v) << (n) | (v) >> (32 - (n)))
+#define CHACHA20_QUARTER(a, b, c, d) \
+	do \
+	{ \
+		a += b; d ^= a; d = CHACHA20_ROTL(d, 16); \
+		c += d; b ^= c; b = CHACHA20_ROTL(b, 12); \
+		a += b; d ^= a; d = CHACHA20_ROTL(d, 8); \
+		c += d; b ^= c; b = CHACHA20_ROTL(b, 7); \
+	} while(0)
+
+/* Function Definitions */
+
+/* Read a little endian word */
+static uint32_t chacha20_load(const unsigned char *bytes)
+{
+	return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/* Keystream of consecutive blocks
+ * Description: Runs the 20 rounds on CHACHA20_LANES blocks at once, lane i
+ * of every state word belongs to block counter + i.
+ * Input: Initial state words (counter word ignored), first block counter
+ * Output: CHACHA20_LANES * 64 keystream bytes in stream
+ * Return: None
+ */
+static void chacha20_blocks(const uint32_t *state, uint32_t counter, unsigned char *stream)
+{
+	ChaChaLanes input[16], x[16];
+
+	for(int i = 0; i < 16; i++)
+	{
+		input[i] = (ChaChaLanes){ state[i], state[i], state[i], state[i] };
+	}
+	input[12] = (ChaChaLanes){ counter, counter + 1, counter + 2, counter + 3 };
+	memcpy(x, input, sizeof(x));
+
+	for(int round = 0; round < 10; round++)
+	{
+		//Column round, then diagonal round.
+		CHACHA20_QUARTER(x[0], x[4], x[8], x[12]);
+		CHACHA20_QUARTER(x[1], x[5], x[9], x[13]);
+		CHACHA20_QUARTER(x[2], x[6], x[10], x[14]);
+		CHACHA20_QUARTER(x[3], x[7], x[11], x[15]);
+		CHACHA20_QUARTER(x[0], x[5], x[10], x[15]);
+		CHACHA20_QUARTER(x[1], x[6], x[11], x[12]);
+		CHACHA20_QUARTER(x[2], x[7], x[8], x[13]);
+		CHACHA20_QUARTER(x[3], x[4], x[9], x[14]);
+	}
+
+	//Add the input and lay the lanes out block after block, little endian.
+	for(int i = 0; i < 16; i++)
+	{
+		x[i] += input[i];
+		for(int lane = 0; lane < CHACHA20_LANES; lane++)
+		{
+			unsigned char *out = stream + lane * CHACHA20_BLOCK_SIZE + i * 4;
+			uint32_t word = x[i][lane];
+
+			out[0] = word;
+			out[1] = word >> 8;
+			out[2] = word >> 16;
+			out[3] = word >> 24;
+		}
+	}
+}
+
+/* Encrypt or decrypt
+ * Description: Byte offset of the stream picks the block counter and the
+ * position in the block, so any range of a payload can be done on its own.
+ * Input: 32 byte key, 12 byte nonce, stream offset of data, data, size
+ * Output: data XORed with the keystream
+ * Return: None
+ */
+void chacha20_xor(const unsigned char *key, const unsigned char *nonce, uint64_t offset, char *data, size_t size)
+{
+	unsigned char stream[CHACHA20_LANES * CHACHA20_BLOCK_SIZE];
+	uint32_t state[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+	uint32_t counter = (uint32_t)(offset / CHACHA20_BLOCK_SIZE);
+	size_t skip = offset % CHACHA20_BLOCK_SIZE;
+
+	for(int i = 0; i < 8; i++)
+	{
+		state[4 + i] = chacha20_load(key + i * 4);
+	}
+	for(int i = 0; i < 3; i++)
+	{
+		state[13 + i] = chacha20_load(nonce + i * 4);
+	}
+
+	while(size > 0)
+	{
+		size_t length = sizeof(stream) - skip < size ? sizeof(stream) - skip : size;
+
+		chacha20_blocks(state, counter, stream);
+		for(size_t i = 0; i < length; i++)
+		{
+			data[i] ^= stream[skip + i];
+		}
+		data += length;
+		size -= length;
+		counter += CHACHA20_LANES;
+		skip = 0;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * ChaCha20 stream cipher (RFC 8439: 256 bit key, 96 bit nonce, 32 bit
+ * block counter starting at 0). Encryption and decryption are the same
+ * XOR with the keystream. The keystream can start at any byte offset, so
+ * the slices of a payload can be encrypted independently and in any
+ * order. Four blocks are generated side by side in vector registers.
+ */
+
+#define CHACHA20_KEY_SIZE 32
+#define CHACHA20_NONCE_SIZE 12
+
+/* ChaCha20 function prototypes */
+
+/* XOR size bytes of data with the keystream starting at byte offset of the stream */
+void chacha20_xor(const unsigned char *key, const unsigned char *nonce, uint64_t offset, char *data, size_t size);
+
+#endif
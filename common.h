@@ -4,4 +4,20 @@
 /* Magic string to identify whether stegged or not */
 #define MAGIC_STRING "#*"
 
+/*
+ * The extension size field keeps the extension size in its low byte.
+ * The bits above it describe how the payload is stored, images with
+ * none of them set hold 1 payload bit per carrier byte.
+ */
+#define EXTN_SIZE_MASK 0xff
+#define DEPTH_SHIFT 8								/* Payload bits per carrier byte - 1 */
+#define DEPTH_MASK (3 << DEPTH_SHIFT)
+#define COMPRESSED_FLAG (1 << 10)					/* Payload is a sequence of LZ frames, see lz.h */
+#define CRC_FLAG (1 << 11)							/* A CRC32C of the payload follows it, 32 bits at 1 bit per carrier byte */
+#define ENCRYPTED_FLAG (1 << 12)					/* Payload is ChaCha20 encrypted, its nonce precedes it at 1 bit per carrier byte */
+#define SCATTER_FLAG (1 << 13)						/* Payload is scattered over the carrier in keyed tiles, see scatter.h, needs ENCRYPTED_FLAG */
+#define STRIPED_FLAG (1 << 14)						/* Payload is one stripe of a larger one, the stripe fields follow its size, see stego.h */
+#define LARGE_FLAG (1 << 15)						/* Payload size and stripe offset and total are 64 bit fields, for payloads of 4 GB and more */
+#define KNOWN_FORMAT_BITS (EXTN_SIZE_MASK | DEPTH_MASK | COMPRESSED_FLAG | CRC_FLAG | ENCRYPTED_FLAG | SCATTER_FLAG | STRIPED_FLAG | LARGE_FLAG)
+
 #endif
@@ -0,0 +1,216 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32C_X86 1
+#endif
+
+#define CRC32C_POLY 0x82f63b78u
+
+/* Slicing by 8 tables, table[k][b] is the CRC of byte b followed by k zero bytes */
+static uint crc32c_table[8][256];
+
+/* x^(2^k) modulo the polynomial, for crc32c_combine, k up to the bit count of 8 * SIZE_MAX */
+static uint crc32c_x2n[sizeof(size_t) * 8 + 3];
+
+/* Function Definitions */
+
+/* Table CRC32C
+ * Description: Eight bytes per step through the slicing by 8 tables.
+ * Input: CRC so far (not inverted), data, size
+ * Output: None
+ * Return: CRC after the data (not inverted)
+ */
+static uint crc32c_sw(uint crc, const unsigned char *data, size_t size)
+{
+	//Bytes up to an 8 byte boundary.
+	while(size > 0 && ((uintptr_t)data & 7) != 0)
+	{
+		crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ crc >> 8;
+		size--;
+	}
+	while(size >= 8)
+	{
+		uint low = crc ^ ((uint)data[0] | (uint)data[1] << 8 | (uint)data[2] << 16 | (uint)data[3] << 24);
+		uint high = (uint)data[4] | (uint)data[5] << 8 | (uint)data[6] << 16 | (uint)data[7] << 24;
+
+		crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][low >> 8 & 0xff] ^ crc32c_table[5][low >> 16 & 0xff] ^ crc32c_table[4][low >> 24] ^
+			crc32c_table[3][high & 0xff] ^ crc32c_table[2][high >> 8 & 0xff] ^ crc32c_table[1][high >> 16 & 0xff] ^ crc32c_table[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+	while(size > 0)
+	{
+		crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ crc >> 8;
+		size--;
+	}
+	return crc;
+}
+
+#ifdef CRC32C_X86
+
+/* SSE4.2 CRC32C
+ * Description: The crc32 instruction computes exactly this polynomial,
+ * eight bytes at a time on 64 bit targets.
+ * Input: CRC so far (not inverted), data, size
+ * Output: None
+ * Return: CRC after the data (not inverted)
+ */
+__attribute__((target("sse4.2")))
+static uint crc32c_hw(uint crc, const unsigned char *data, size_t size)
+{
+	while(size > 0 && ((uintptr_t)data & 7) != 0)
+	{
+		crc = _mm_crc32_u8(crc, *data++);
+		size--;
+	}
+#ifdef __x86_64__
+	{
+		uint64_t crc64 = crc;
+
+		while(size >= 8)
+		{
+			uint64_t word;
+
+			memcpy(&word, data, 8);
+			crc64 = _mm_crc32_u64(crc64, word);
+			data += 8;
+			size -= 8;
+		}
+		crc = (uint)crc64;
+	}
+#else
+	while(size >= 4)
+	{
+		uint32_t word;
+
+		memcpy(&word, data, 4);
+		crc = _mm_crc32_u32(crc, word);
+		data += 4;
+		size -= 4;
+	}
+#endif
+	while(size > 0)
+	{
+		crc = _mm_crc32_u8(crc, *data++);
+		size--;
+	}
+	return crc;
+}
+
+#endif
+
+static uint (*crc32c_active)(uint crc, const unsigned char *data, size_t size) = crc32c_sw;
+
+/* Multiply two polynomials modulo the CRC polynomial, bit reflected */
+static uint crc32c_multmodp(uint a, uint b)
+{
+	uint m = 1u << 31, product = 0;
+
+	for(;;)
+	{
+		if(a & m)
+		{
+			product ^= b;
+			if((a & (m - 1)) == 0)
+			{
+				break;
+			}
+		}
+		m >>= 1;
+		b = b & 1 ? b >> 1 ^ CRC32C_POLY : b >> 1;
+	}
+	return product;
+}
+
+/* Build the tables and pick the implementation
+ * Description: Runs once at startup. The SSE4.2 instruction is used when
+ * the CPU supports it, unless CRC32C_KERNEL=table is set.
+ * Input: None
+ * Output: Tables filled, crc32c_active is set
+ * Return: None
+ */
+__attribute__((constructor))
+static void crc32c_init(void)
+{
+	const char *forced = getenv("CRC32C_KERNEL");
+	uint p;
+
+	for(uint b = 0; b < 256; b++)
+	{
+		uint crc = b;
+
+		for(int k = 0; k < 8; k++)
+		{
+			crc = crc & 1 ? crc >> 1 ^ CRC32C_POLY : crc >> 1;
+		}
+		crc32c_table[0][b] = crc;
+	}
+	for(uint b = 0; b < 256; b++)
+	{
+		for(int k = 1; k < 8; k++)
+		{
+			crc32c_table[k][b] = crc32c_table[0][crc32c_table[k - 1][b] & 0xff] ^ crc32c_table[k - 1][b] >> 8;
+		}
+	}
+
+	//x^1, then repeated squaring.
+	p = 1u << 30;
+	crc32c_x2n[0] = p;
+	for(size_t k = 1; k < sizeof(crc32c_x2n) / sizeof(crc32c_x2n[0]); k++)
+	{
+		p = crc32c_multmodp(p, p);
+		crc32c_x2n[k] = p;
+	}
+
+#ifdef CRC32C_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse4.2") && (forced == NULL || strcmp(forced, "table") != 0))
+	{
+		crc32c_active = crc32c_hw;
+	}
+#else
+	(void)forced;
+#endif
+}
+
+/* CRC32C of data
+ * Input: CRC32C of the data before (0 to start), data, size
+ * Output: None
+ * Return: CRC32C of everything so far
+ */
+uint crc32c(uint crc, const char *data, size_t size)
+{
+	return ~crc32c_active(~crc, (const unsigned char *)data, size);
+}
+
+/* Combine two CRC32C
+ * Description: Appending size_b bytes multiplies the first CRC by
+ * x^(8 * size_b), which is put together from the x^(2^k) table.
+ * Input: CRC32C of the first piece, of the second piece, size of the second
+ * Output: None
+ * Return: CRC32C of both pieces back to back
+ */
+uint crc32c_combine(uint crc_a, uint crc_b, size_t size_b)
+{
+	uint shift = 1u << 31;
+
+	//x^(size_b * 2^3).
+	for(int k = 3; size_b > 0; size_b >>= 1, k++)
+	{
+		if(size_b & 1)
+		{
+			shift = crc32c_multmodp(crc32c_x2n[k], shift);
+		}
+	}
+	return crc32c_multmodp(shift, crc_a) ^ crc_b;
+}
+
+/* Name of the implementation in use */
+const char *crc32c_kernel_name(void)
+{
+	return crc32c_active == crc32c_sw ? "table" : "sse4.2";
+}
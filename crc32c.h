@@ -0,0 +1,26 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * CRC32C (Castagnoli, reflected polynomial 0x82f63b78) of the payload.
+ * Uses the SSE4.2 crc32 instruction when the CPU has it and a slicing by
+ * 8 table otherwise, CRC32C_KERNEL=table in the environment forces the
+ * table. Like zlib's crc32, start with 0 and feed the data in any number
+ * of pieces.
+ */
+
+/* CRC32C function prototypes */
+
+/* Continue crc over size more bytes */
+uint crc32c(uint crc, const char *data, size_t size);
+
+/* CRC32C of two pieces back to back from the CRC32C of each and the size of the second */
+uint crc32c_combine(uint crc_a, uint crc_b, size_t size_b);
+
+/* Name of the implementation in use, sse4.2 or table */
+const char *crc32c_kernel_name(void);
+
+#endif
@@ -0,0 +1,665 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "decode.h"
+#include "encode.h"
+#include "file_copy.h"
+#include "thread_pool.h"
+#include "types.h"
+
+#define DAEMON_ARGS 3						//File names after -e or -d.
+#define DAEMON_BACKLOG 64					//Connections waiting for a worker.
+
+/* One request, sent as one packet with the client's stdin and stdout descriptors */
+typedef struct _DaemonRequest
+{
+	OperationType operation;				//e_encode or e_decode.
+	Options options;						//Options read by the client, -j is not used.
+	char cwd[PATH_MAX];						//Working directory of the client.
+	char args[DAEMON_ARGS][PATH_MAX];		//File names after -e or -d, "" when not given.
+} DaemonRequest;
+
+/* Answer to a request */
+typedef struct _DaemonReply
+{
+	Status status;							//Result of the request.
+	double elapsed_ms;						//Wall time of the request in the worker.
+	unsigned long image_bytes;				//Carrier bytes of the image.
+	long secret_bytes;						//Bytes of the secret encoded or decoded.
+} DaemonReply;
+
+/* Buffers of one worker, allocated once and reused by every request it serves */
+typedef struct _DaemonWorker
+{
+	EncodeInfo encInfo;
+	DecodeInfo decInfo;
+	DaemonRequest request;
+	char fnames[DAEMON_ARGS][PATH_MAX];		//Absolute file names of the request.
+	char stego_image_fname[PATH_MAX];		//Absolute default stego image name.
+} DaemonWorker;
+
+/* State shared by the workers */
+typedef struct _Daemon
+{
+	int listen_fd;							//Listening socket.
+	int quiet;								//Non zero to skip the request lines.
+} Daemon;
+
+/* Set by SIGINT and SIGTERM, the handler also shuts the listening socket down to wake the workers */
+static volatile sig_atomic_t daemon_stop;
+static int daemon_listen_fd = -1;
+
+/* Function Definitions */
+
+/* Monotonic clock in milliseconds */
+static double daemon_now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* SIGINT and SIGTERM handler */
+static void daemon_signal(int signum)
+{
+	(void)signum;
+	daemon_stop = 1;
+	shutdown(daemon_listen_fd, SHUT_RDWR);
+}
+
+/* Fill in a socket address
+ * Input: Socket file name
+ * Output: Address stored in addr
+ * Return: e_success or e_failure if the name is too long for a socket
+ */
+static Status daemon_address(const char *socket_fname, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if(strlen(socket_fname) >= sizeof(addr->sun_path))
+	{
+		fprintf(stderr, "ERROR: Socket name %s is longer than %zu characters\n", socket_fname, sizeof(addr->sun_path) - 1);
+		return e_failure;
+	}
+	strcpy(addr->sun_path, socket_fname);
+	return e_success;
+}
+
+/* Make a file name of a request absolute
+ * Description: The daemon does not share the working directory of the
+ * client, relative names are taken from the client's. - stays as it is.
+ * Input: Client working directory, file name, size of path
+ * Output: Absolute name stored in path
+ * Return: e_success or e_failure if it does not fit
+ */
+static Status daemon_path(const char *cwd, const char *fname, char *path, size_t size)
+{
+	int length;
+
+	if(fname[0] == '/' || stdio_file_name(fname))
+	{
+		length = snprintf(path, size, "%s", fname);
+	}
+	else
+	{
+		length = snprintf(path, size, "%s/%s", cwd, fname);
+	}
+	if(length < 0 || (size_t)length >= size)
+	{
+		fprintf(stderr, "ERROR: File name %s is too long\n", fname);
+		return e_failure;
+	}
+	return e_success;
+}
+
+/* Receive a request
+ * Description: Takes the packet and the descriptors sent with it, extra
+ * descriptors are closed.
+ * Input: Connected socket
+ * Output: Request and the client's stdin and stdout descriptors, -1 for any not sent
+ * Return: e_success or e_failure on a short, cut or unreadable packet
+ */
+static Status receive_request(int conn_fd, DaemonRequest *request, int fds[2])
+{
+	union
+	{
+		char buf[CMSG_SPACE(4 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov = { request, sizeof(DaemonRequest) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t size;
+
+	fds[0] = fds[1] = -1;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	size = recvmsg(conn_fd, &msg, MSG_CMSG_CLOEXEC);
+	if(size < 0)
+	{
+		return e_failure;
+	}
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+		{
+			int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			int *sent = (int *)CMSG_DATA(cmsg);
+
+			for(int i = 0; i < count; i++)
+			{
+				if(i < 2 && fds[i] < 0)
+				{
+					fds[i] = sent[i];
+				}
+				else
+				{
+					close(sent[i]);
+				}
+			}
+		}
+	}
+	if((size_t)size != sizeof(DaemonRequest) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || (request->operation != e_encode && request->operation != e_decode))
+	{
+		return e_failure;
+	}
+	//The names are used as C strings.
+	request->cwd[PATH_MAX - 1] = '\0';
+	for(int i = 0; i < DAEMON_ARGS; i++)
+	{
+		request->args[i][PATH_MAX - 1] = '\0';
+	}
+	return e_success;
+}
+
+/* Run an encode request
+ * Description: Validates the names like the command line does and encodes
+ * quietly on the worker's EncodeInfo, a default stego image name is put
+ * in the client's working directory.
+ * Input: Worker with its request, client's stdin and stdout descriptors
+ * Output: Reply filled in
+ * Return: None
+ */
+static void run_encode_request(DaemonWorker *worker, const int fds[2], DaemonReply *reply)
+{
+	DaemonRequest *request = &worker->request;
+	const Options *options = &request->options;
+	EncodeInfo *encInfo = &worker->encInfo;
+	char *argv[] = { "daemon", "-e", worker->fnames[0], worker->fnames[1], request->args[2][0] != '\0' ? worker->fnames[2] : NULL, NULL };
+
+	encInfo->pool = NULL;
+	encInfo->quiet = 1;
+	encInfo->stats = NULL;
+	encInfo->use_stdio = 0;
+	encInfo->stdin_fd = fds[0];
+	encInfo->stdout_fd = fds[1];
+	encInfo->depth = options->depth;
+	encInfo->compress = options->compress;
+	encInfo->crc = options->crc;
+	encInfo->key = options->has_key ? options->key : NULL;
+	encInfo->scatter = options->scatter;
+	encInfo->in_place = options->in_place;
+	encInfo->secret_offset = 0;
+	encInfo->secret_part = options->secret_size;
+	encInfo->stripe = NULL;
+
+	if(read_and_validate_encode_args(argv, encInfo) == e_failure)
+	{
+		return;
+	}
+	if(encInfo->stego_image_fname[0] != '/' && !stdio_file_name(encInfo->stego_image_fname))
+	{
+		if(daemon_path(request->cwd, encInfo->stego_image_fname, worker->stego_image_fname, PATH_MAX) == e_failure)
+		{
+			return;
+		}
+		encInfo->stego_image_fname = worker->stego_image_fname;
+	}
+	reply->status = do_encoding(encInfo);
+	close_files(encInfo);
+	if(reply->status == e_success)
+	{
+		reply->image_bytes = encInfo->image_capacity;
+		reply->secret_bytes = encInfo->size_secret_file;
+	}
+}
+
+/* Run a decode request
+ * Description: Validates the names like the command line does and decodes
+ * quietly on the worker's DecodeInfo, the default output name is put in
+ * the client's working directory.
+ * Input: Worker with its request, client's stdin and stdout descriptors
+ * Output: Reply filled in
+ * Return: None
+ */
+static void run_decode_request(DaemonWorker *worker, const int fds[2], DaemonReply *reply)
+{
+	DaemonRequest *request = &worker->request;
+	DecodeInfo *decInfo = &worker->decInfo;
+	char *argv[] = { "daemon", "-d", worker->fnames[0], request->args[1][0] != '\0' ? worker->fnames[1] : NULL, NULL };
+	char output_fname[MAX_OUTPUT_FNAME];
+
+	decInfo->pool = NULL;
+	decInfo->quiet = 1;
+	decInfo->stats = NULL;
+	decInfo->key = request->options.has_key ? request->options.key : NULL;
+	decInfo->stripe_set = 0;
+	decInfo->stdin_fd = fds[0];
+	decInfo->stdout_fd = fds[1];
+	decInfo->fptr_stego_image = NULL;
+	decInfo->fptr_output_file = NULL;
+
+	if(read_and_validate_decode(argv, decInfo) == e_failure)
+	{
+		return;
+	}
+	if(decInfo->output_file_fname[0] != '/' && !stdio_file_name(decInfo->output_file_fname))
+	{
+		//Room is left for the extension, as for a name given.
+		if(daemon_path(request->cwd, decInfo->output_file_fname, output_fname, MAX_OUTPUT_FNAME - MAX_FILE_SUFFIX) == e_failure)
+		{
+			return;
+		}
+		strcpy(decInfo->output_file_fname, output_fname);
+	}
+	reply->status = do_decoding(decInfo);
+	close_decode_files(decInfo);
+	if(reply->status == e_success)
+	{
+		reply->image_bytes = carrier_size(&decInfo->carrier);
+		reply->secret_bytes = decInfo->output_file_size;
+	}
+}
+
+/* Serve one connection
+ * Description: Reads the request, checks that the client runs as the
+ * daemon's user, runs it and sends the reply.
+ * Input: Connected socket, daemon, worker
+ * Output: Reply sent, one line on stdout unless quiet
+ * Return: None
+ */
+static void serve_connection(int conn_fd, const Daemon *daemon, DaemonWorker *worker)
+{
+	DaemonRequest *request = &worker->request;
+	DaemonReply reply;
+	struct ucred cred;
+	socklen_t cred_size = sizeof(cred);
+	double start = daemon_now_ms();
+	int fds[2], refused = 1;
+	Status status = receive_request(conn_fd, request, fds);
+
+	memset(&reply, 0, sizeof(reply));
+	reply.status = e_failure;
+
+	//The daemon opens files with its own rights, so only its own user is served.
+	if(getsockopt(conn_fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) != 0 || cred.uid != getuid())
+	{
+		fprintf(stderr, "ERROR: Request of another user refused\n");
+	}
+	else if(status == e_failure)
+	{
+		fprintf(stderr, "ERROR: Malformed request\n");
+	}
+	else
+	{
+		refused = 0;
+		//Names are resolved in the client's working directory.
+		for(int i = 0; i < DAEMON_ARGS && status == e_success; i++)
+		{
+			worker->fnames[i][0] = '\0';
+			if(request->args[i][0] != '\0')
+			{
+				status = daemon_path(request->cwd, request->args[i], worker->fnames[i], PATH_MAX);
+			}
+		}
+		if(status == e_success && request->operation == e_encode)
+		{
+			run_encode_request(worker, fds, &reply);
+		}
+		else if(status == e_success)
+		{
+			run_decode_request(worker, fds, &reply);
+		}
+	}
+	reply.elapsed_ms = daemon_now_ms() - start;
+
+	for(int i = 0; i < 2; i++)
+	{
+		if(fds[i] >= 0)
+		{
+			close(fds[i]);
+		}
+	}
+	if(send(conn_fd, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply))
+	{
+		perror("send");
+	}
+
+	if(!daemon->quiet)
+	{
+		if(refused)
+		{
+			printf("REQUEST: REFUSED %.3f ms\n", reply.elapsed_ms);
+		}
+		else if(request->operation == e_encode)
+		{
+			printf("REQUEST: %s -e %s + %s -> %s %.3f ms\n", reply.status == e_success ? "OK" : "FAILED", worker->fnames[0], worker->fnames[1], reply.status == e_success ? worker->encInfo.stego_image_fname : (request->args[2][0] != '\0' ? worker->fnames[2] : "(default)"), reply.elapsed_ms);
+		}
+		else
+		{
+			printf("REQUEST: %s -d %s -> %s %.3f ms\n", reply.status == e_success ? "OK" : "FAILED", worker->fnames[0], reply.status == e_success ? worker->decInfo.output_file_fname : (request->args[1][0] != '\0' ? worker->fnames[1] : "(default)"), reply.elapsed_ms);
+		}
+	}
+}
+
+/* Daemon worker
+ * Description: Allocates its buffers once, touches them so the first
+ * request does not fault them in, then accepts and serves connections
+ * until the daemon is stopped.
+ * Input: Daemon, worker index
+ * Output: Connections are served
+ * Return: None
+ */
+static void daemon_worker(void *arg, int index)
+{
+	Daemon *daemon = arg;
+	DaemonWorker *worker = malloc(sizeof(DaemonWorker));
+
+	(void)index;
+	if(worker == NULL)
+	{
+		return;
+	}
+	memset(worker, 0, sizeof(DaemonWorker));
+
+	while(!daemon_stop)
+	{
+		int conn_fd = accept4(daemon->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+		if(conn_fd < 0)
+		{
+			//A shut down socket fails with EINVAL.
+			if(daemon_stop || errno == EINVAL || errno == EBADF)
+			{
+				break;
+			}
+			continue;
+		}
+		serve_connection(conn_fd, daemon, worker);
+		close(conn_fd);
+	}
+	free(worker);
+}
+
+/* Open the listening socket
+ * Description: A socket file left by a daemon that is gone is replaced,
+ * one that still answers is not. The socket is only accessible to the
+ * daemon's user.
+ * Input: Socket file name
+ * Output: None
+ * Return: Listening socket, or -1 on failure
+ */
+static int daemon_listen(const char *socket_fname)
+{
+	struct sockaddr_un addr;
+	mode_t mask;
+	int fd, bound;
+
+	if(daemon_address(socket_fname, &addr) == e_failure)
+	{
+		return -1;
+	}
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+	{
+		perror("socket");
+		return -1;
+	}
+
+	mask = umask(0077);
+	bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	if(bound != 0 && errno == EADDRINUSE)
+	{
+		int probe_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+		//Nobody listening, the file is stale.
+		if(probe_fd >= 0 && connect(probe_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED && unlink(socket_fname) == 0)
+		{
+			bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+		}
+		else
+		{
+			errno = EADDRINUSE;
+		}
+		if(probe_fd >= 0)
+		{
+			close(probe_fd);
+		}
+	}
+	umask(mask);
+
+	if(bound != 0 || listen(fd, DAEMON_BACKLOG) != 0)
+	{
+		perror("bind");
+		fprintf(stderr, "ERROR: Unable to listen on %s\n", socket_fname);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Daemon mode
+ * Description: Listens on socket_fname and serves requests on a pool of
+ * workers until SIGINT or SIGTERM, then removes the socket file. Every
+ * request runs on one thread, the workers run requests side by side.
+ * Input: Socket file name, options (threads > 0 sets the number of workers, one per CPU otherwise, -q drops the request lines)
+ * Output: One line per request on stdout
+ * Return: e_success or e_failure if the socket or the pool cannot be set up
+ */
+Status do_daemon(const char *socket_fname, const Options *options)
+{
+	Daemon daemon;
+	ThreadPool *pool;
+	struct sigaction action;
+	int workers;
+
+	daemon.quiet = options->quiet;
+	daemon.listen_fd = daemon_listen(socket_fname);
+	if(daemon.listen_fd < 0)
+	{
+		return e_failure;
+	}
+	workers = options->threads > 0 ? options->threads : thread_pool_cpu_count();
+	pool = thread_pool_create(workers);
+	if(pool == NULL)
+	{
+		close(daemon.listen_fd);
+		unlink(socket_fname);
+		return e_failure;
+	}
+	workers = thread_pool_size(pool);
+
+	//Stop on SIGINT and SIGTERM, a client gone away is an error of its request only.
+	daemon_stop = 0;
+	daemon_listen_fd = daemon.listen_fd;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = daemon_signal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	//One line per request, also when stdout is a log file.
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	printf("INFO: Listening on %s with %d workers\n", socket_fname, workers);
+
+	thread_pool_run(pool, daemon_worker, &daemon, workers);
+	thread_pool_destroy(pool);
+
+	close(daemon.listen_fd);
+	daemon_listen_fd = -1;
+	unlink(socket_fname);
+	return e_success;
+}
+
+/* Send a request
+ * Description: The request goes as one packet with stdin and stdout
+ * attached, and the reply is waited for.
+ * Input: Socket file name, request
+ * Output: Reply filled in
+ * Return: e_success, or e_failure if the daemon cannot be reached
+ */
+static Status send_request(const char *socket_fname, const DaemonRequest *request, DaemonReply *reply)
+{
+	union
+	{
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct sockaddr_un addr;
+	struct iovec iov = { (void *)request, sizeof(DaemonRequest) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int fds[2] = { STDIN_FILENO, STDOUT_FILENO };
+	int fd;
+	ssize_t size;
+
+	if(daemon_address(socket_fname, &addr) == e_failure)
+	{
+		return e_failure;
+	}
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		perror("connect");
+		fprintf(stderr, "ERROR: No daemon listening on %s\n", socket_fname);
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+		return e_failure;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if(sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(DaemonRequest))
+	{
+		perror("sendmsg");
+		close(fd);
+		return e_failure;
+	}
+	size = recv(fd, reply, sizeof(DaemonReply), 0);
+	close(fd);
+	if(size != sizeof(DaemonReply))
+	{
+		fprintf(stderr, "ERROR: No reply from the daemon on %s\n", socket_fname);
+		return e_failure;
+	}
+	return e_success;
+}
+
+/* Client mode
+ * Description: Sends -e or -d with its file names, options and working
+ * directory to the daemon and reports the reply. Stripe lists are not
+ * served by the daemon.
+ * Input: Command line arguments, argv[2] the socket, argv[3] -e or -d, options
+ * Output: One line with the result and timing, on stderr when the output goes to stdout
+ * Return: Status of the request
+ */
+Status do_client(char *argv[], const Options *options)
+{
+	DaemonRequest *request;
+	DaemonReply reply;
+	FILE *fptr_report = stdout;
+	OperationType operation = e_unsupported;
+	double start = daemon_now_ms();
+	Status status = e_success;
+
+	if(argv[3] != NULL)
+	{
+		operation = strcmp(argv[3], "-e") == 0 ? e_encode : strcmp(argv[3], "-d") == 0 ? e_decode : e_unsupported;
+	}
+	if(operation == e_unsupported || argv[4] == NULL || (operation == e_encode && argv[5] == NULL))
+	{
+		fprintf(stderr, "ERROR: --client needs -e <image> <secret> [output] or -d <image> [output]\n");
+		return e_failure;
+	}
+	if(strchr(argv[4], ',') != NULL)
+	{
+		fprintf(stderr, "ERROR: Stripe lists are not served by the daemon, run them without --client\n");
+		return e_failure;
+	}
+
+	request = calloc(1, sizeof(DaemonRequest));
+	if(request == NULL)
+	{
+		return e_failure;
+	}
+	request->operation = operation;
+	request->options = *options;
+	if(getcwd(request->cwd, PATH_MAX) == NULL)
+	{
+		perror("getcwd");
+		status = e_failure;
+	}
+	for(int i = 0; status == e_success && argv[4 + i] != NULL; i++)
+	{
+		if(i == (operation == e_encode ? DAEMON_ARGS : DAEMON_ARGS - 1) || strlen(argv[4 + i]) >= PATH_MAX)
+		{
+			fprintf(stderr, "ERROR: Unexpected or too long file name %s\n", argv[4 + i]);
+			status = e_failure;
+			break;
+		}
+		strcpy(request->args[i], argv[4 + i]);
+	}
+	//A stego image or secret written to stdout leaves no room for the report.
+	if(operation == e_encode ? (stdio_file_name(argv[6]) || (stdio_file_name(argv[4]) && argv[6] == NULL)) : stdio_file_name(argv[5]))
+	{
+		fptr_report = stderr;
+	}
+
+	if(status == e_success)
+	{
+		status = send_request(argv[2], request, &reply);
+	}
+	free(request);
+	if(status == e_failure)
+	{
+		return e_failure;
+	}
+
+	if(reply.status == e_failure)
+	{
+		fprintf(stderr, "ERROR: Daemon %s failed in %.3f ms, see the daemon's log\n", operation == e_encode ? "encoding" : "decoding", reply.elapsed_ms);
+		return e_failure;
+	}
+	if(!options->quiet)
+	{
+		fprintf(fptr_report, "INFO: Daemon %s done: %lu image bytes, %ld secret bytes in %.3f ms, %.3f ms round trip\n", operation == e_encode ? "encoding" : "decoding", reply.image_bytes, reply.secret_bytes, reply.elapsed_ms, daemon_now_ms() - start);
+	}
+	return e_success;
+}
@@ -0,0 +1,26 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "types.h" // Contains user defined types
+#include "options.h"
+
+/*
+ * Daemon mode: a long running process listening on a Unix domain socket,
+ * --daemon <socket>, serves -e and -d requests on a pool of warm workers,
+ * each with its buffers allocated once. --client <socket> -e|-d ... sends
+ * one request with the usual file names and options and prints the reply.
+ * Relative names are taken from the client's working directory and the
+ * client's stdin and stdout travel with the request (SCM_RIGHTS), so -
+ * works as on the command line. Only clients of the daemon's user are
+ * served, the error messages of a request go to the daemon's stderr.
+ */
+
+/* Daemon function prototypes */
+
+/* Serve requests on socket_fname with -j workers, one per CPU by default, until SIGINT or SIGTERM */
+Status do_daemon(const char *socket_fname, const Options *options);
+
+/* Send the -e or -d request in argv[3] on to the daemon listening on argv[2] */
+Status do_client(char *argv[], const Options *options);
+
+#endif
@@ -1,9 +1,39 @@
 
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "decode.h"
 #include "types.h"
 #include <string.h>
 #include "common.h"
+#include "chacha20.h"
+#include "crc32c.h"
+#include "file_copy.h"
+#include "lsb.h"
+#include "lz.h"
+#include "pipeline.h"
+#include "scatter.h"
+#include "stego.h"
+
+/* Slices of the secret data for the parallel decode */
+typedef struct _DecodeSlices
+{
+	int stego_fd;								//Stego image, read with pread.
+	const Carrier *carrier;						//Layout of the stego image.
+	size_t pos;									//Carrier byte of the first secret byte.
+	int output_fd;								//Output file, written with pwrite.
+	long output_offset;							//Output file offset of the first secret byte.
+	long size;									//Secret file size.
+	int depth;									//Payload bits per carrier byte.
+	int count;									//Number of slices.
+	int failed;									//Set when any slice fails.
+	uint *crcs;									//CRC32C of every slice, NULL when not needed.
+	const unsigned char *key;					//ChaCha20 key, NULL for no encryption.
+	const unsigned char *nonce;
+	const ScatterMap *scatter;					//Tiles of a scattered secret, NULL when sequential.
+} DecodeSlices;
 
 //Function Definitions. 
 
@@ -15,8 +45,9 @@
 
 Status read_and_validate_decode(char *argv[], DecodeInfo *decInfo)
 {
-	//Check the source(stego image) file (argv[2] is a .bmp file or not.
-	if (strcmp(strstr(argv[2], "."), ".bmp") == 0)		
+	//Check the source(stego image) file (argv[2] is a .bmp, .ppm or .tga file or not, - reads it from stdin.
+	if (carrier_image_name(argv[2]) || stdio_file_name(argv[2]))
+
 	{
 		//If yes, Store the address of the source(stego image) file name.
 		decInfo -> stego_image_fname = argv[2];
@@ -24,11 +55,16 @@ Status read_and_validate_decode(char *argv[], DecodeInfo *decInfo)
 	else
 	{
 		//ERROR
-		printf("ERROR: Source file %s format should be .bmp\n", argv[2]);
-		printf("%s : Decoding : %s -e <.bmp file> [output file]\n", argv[0],argv[0]);
+		fprintf(stderr, "ERROR: Source file %s format should be .bmp, .ppm or .tga\n", argv[2]);
+		printf("%s : Decoding : %s -d <.bmp|.ppm|.tga file> [output file] [-j N] [-q] [--stats=json]\n", argv[0],argv[0]);
 		return e_failure;
 	}
 	//Checking whether the file name(argv[3]) is passed or not.
+	if (argv[3] != NULL && strlen(argv[3]) + MAX_FILE_SUFFIX >= MAX_OUTPUT_FNAME)
+	{
+		fprintf(stderr, "ERROR: Output file name %s is too long\n", argv[3]);
+		return e_failure;
+	}
 	if (argv[3] != NULL)		
 	{	
 		//If passed, store the output file name.
@@ -51,8 +87,13 @@ Status read_and_validate_decode(char *argv[], DecodeInfo *decInfo)
  */
 Status open_bmp_file(DecodeInfo *decInfo)
 {
+	struct stat stego_stat;
+
+	//Nothing is open yet.
+	decInfo->fptr_output_file = NULL;
+
 	//Opening source (stego image file) and storing the address of the file in a file pointer.
-	decInfo->fptr_stego_image = fopen(decInfo->stego_image_fname, "r");			 
+	decInfo->fptr_stego_image = open_stdio_file(decInfo->stego_image_fname, "r", decInfo->stdin_fd);
 
 	//Error Handling. If file pointer is NULL.
 	if (decInfo->fptr_stego_image == NULL)                                                    
@@ -62,9 +103,78 @@ Status open_bmp_file(DecodeInfo *decInfo)
 
 		return e_failure;
 	}
+
+	//Remember the stego image size to validate decoded sizes against it.
+	if(fstat(fileno(decInfo->fptr_stego_image), &stego_stat) == 0 && S_ISREG(stego_stat.st_mode))
+	{
+		decInfo->stego_image_size = stego_stat.st_size;
+	}
+	else
+	{
+		decInfo->stego_image_size = -1;
+	}
 	return e_success;						
 }
 
+/* Close files opened while decoding
+ * Description: Closes whatever is still open, safe to call more than once
+ * and after a failed decoding.
+ * Input: File information of stego image file and output file
+ * Output: File pointers are closed and set to NULL
+ * Return: None
+ */
+void close_decode_files(DecodeInfo *decInfo)
+{
+	if(decInfo->fptr_stego_image != NULL)
+	{
+		fclose(decInfo->fptr_stego_image);
+		decInfo->fptr_stego_image = NULL;
+	}
+	if(decInfo->fptr_output_file != NULL)
+	{
+		fclose(decInfo->fptr_output_file);
+		decInfo->fptr_output_file = NULL;
+	}
+}
+
+/* Remove a corrupt or incomplete output file
+ * Description: Only a named regular output file is removed, a - output
+ * has already gone down the pipe and a stripe set removes its shared
+ * one itself.
+ * Input: File information of stego image file and output file
+ * Output: Files closed and the output file unlinked
+ * Return: 1 if the output file was removed, 0 if it was left
+ */
+static int remove_output_file(DecodeInfo *decInfo)
+{
+	if(decInfo->stripe_set || decInfo->fptr_output_file == NULL || stdio_file_name(decInfo->output_file_fname) || !regular_file(decInfo->fptr_output_file))
+	{
+		return 0;
+	}
+	close_decode_files(decInfo);
+	unlink(decInfo->output_file_fname);
+	return 1;
+}
+
+/* Print an INFO line
+ * Description: printf for the decoding progress, silent when decInfo->quiet is set.
+ * Input: Decode File Information, printf format and arguments
+ * Output: Line printed on stdout unless quiet
+ * Return: None
+ */
+void decode_info(const DecodeInfo *decInfo, const char *format, ...)
+{
+	va_list args;
+
+	if(decInfo->quiet)
+	{
+		return;
+	}
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
 /* Decoding secret data from stego image file to output file.
  * Input: File information of stego image file and output file
  * Output: Decoded secret message copied to output file
@@ -73,88 +183,171 @@ Status open_bmp_file(DecodeInfo *decInfo)
 
 Status do_decoding(DecodeInfo *decInfo)
 {
-	printf("INFO: ## Decoding Procedure Started ##\n");
+	decode_info(decInfo, "INFO: ## Decoding Procedure Started ##\n");
 
 	//Opening bmp file.
-	printf("INFO: Opening required files\n");
+	stats_stage(decInfo->stats, e_stage_open);
+	decode_info(decInfo, "INFO: Opening required files\n");
 	if (open_bmp_file(decInfo) == e_success)
 	{
-		printf("INFO: Opened %s\n", decInfo -> stego_image_fname);
-		//Skip the 54 bytes header.
+		decode_info(decInfo, "INFO: Opened %s\n", decInfo -> stego_image_fname);
+		//Skip the image header.
 
 		//Move the FILE pointer to start.
 		rewind(decInfo->fptr_stego_image);
-		//Move the FILE pointer to 54th byte from beginning.
-		fseek(decInfo->fptr_stego_image, 54, SEEK_SET);
+		//Read the pixel layout, the FILE pointer is left at the first pixel row.
+		if(carrier_read(&decInfo->carrier, decInfo->fptr_stego_image) == e_failure || (decInfo->stego_image_size >= 0 && carrier_fits(&decInfo->carrier, decInfo->stego_image_size) == e_failure))
+		{
+			fprintf(stderr, "ERROR: %s is not an uncompressed 24 or 32 bit BMP, PPM or TGA image\n", decInfo->stego_image_fname);
+			return e_failure;
+		}
+		decInfo->carrier_pos = 0;
 		//Decoding Magic String Signature.
-		printf("INFO: Decoding Magic String Signature\n");
+		stats_stage(decInfo->stats, e_stage_magic);
+		decode_info(decInfo, "INFO: Decoding Magic String Signature\n");
 		if(decode_magic_string(MAGIC_STRING, decInfo) == e_success)
 		{
-			printf("INFO: Done\n");
+			decode_info(decInfo, "INFO: Done\n");
 
 			//Decoding Output File Extension Size.
-			printf("INFO: Decoding Output File Extension Size\n");
+			stats_stage(decInfo->stats, e_stage_extn);
+			decode_info(decInfo, "INFO: Decoding Output File Extension Size\n");
 			if(decode_extn_size(decInfo) == e_success)
 			{
-				printf("INFO: Done\n");
+				decode_info(decInfo, "INFO: Done\n");
 
 				//Decoding Output File Extension.
-				printf("INFO: Decoding Output File Extension\n");
+				decode_info(decInfo, "INFO: Decoding Output File Extension\n");
 				if(decode_secret_file_extn(decInfo -> file_extn_size, decInfo) == e_success)
 				{
-					printf("INFO: Done\n");
+					decode_info(decInfo, "INFO: Done\n");
 
-					//Concatenate output file name and extension.
-					strcat(decInfo -> output_file_fname, decInfo->output_file_extn);
+					//Concatenate output file name and extension, - writes the secret data to stdout as it is.
+					if(!stdio_file_name(decInfo->output_file_fname))
+					{
+						strcat(decInfo -> output_file_fname, decInfo->output_file_extn);
+					}
 
 					//Decoding Output File Size.
-					printf("INFO: Decoding Output File Size\n");
+					stats_stage(decInfo->stats, e_stage_size);
+					decode_info(decInfo, "INFO: Decoding Output File Size\n");
 					if(decode_secret_file_size(decInfo) == e_success)
 					{
-						printf("INFO: Done\n");
+						decode_info(decInfo, "INFO: Done\n");
+
+						//A stripe only makes sense with the rest of its set.
+						if(decInfo->striped != decInfo->stripe_set)
+						{
+							fprintf(stderr, decInfo->striped ? "ERROR: %s is one stripe of a set, decode the whole set\n" : "ERROR: %s is not one stripe of a set\n", decInfo->stego_image_fname);
+							return e_failure;
+						}
+						if(decInfo->striped)
+						{
+							decode_info(decInfo, "INFO: Decoding Output File Stripe\n");
+							if(decode_secret_file_stripe(decInfo) == e_failure)
+							{
+								decode_info(decInfo, "INFO: Decoding output file stripe failed\n");
+								return e_failure;
+							}
+							decode_info(decInfo, "INFO: Done. Stripe %u of %u\n", decInfo->stripe.index + 1, decInfo->stripe.count);
+						}
+
+						//Decoding the nonce of the encrypted output file data.
+						if(decInfo->encrypted)
+						{
+							decode_info(decInfo, "INFO: Decoding Output File Nonce\n");
+							if(decInfo->key == NULL)
+							{
+								fprintf(stderr, "ERROR: %s is encrypted, pass --key-file or --key-env\n", decInfo->stego_image_fname);
+								return e_failure;
+							}
+							if(decode_secret_file_nonce(decInfo) == e_failure)
+							{
+								decode_info(decInfo, "INFO: Decoding output file nonce failed\n");
+								return e_failure;
+							}
+							decode_info(decInfo, "INFO: Done\n");
+						}
 
 						//Decoding Output File Data.
-						printf("INFO: Decoding Output File Data\n");
+						stats_stage(decInfo->stats, e_stage_payload);
+						decode_info(decInfo, "INFO: Decoding Output File Data\n");
 						if(decode_secret_file_data(decInfo -> output_file_size, decInfo) == e_success)
 						{
-							printf("INFO: Done\n");
-							fclose(decInfo->fptr_stego_image);
-							fclose(decInfo->fptr_output_file);
+							decode_info(decInfo, "INFO: Done\n");
+
+							//Checking the CRC32C of the output file data.
+							if(decInfo->crc)
+							{
+								decode_info(decInfo, "INFO: Checking Output File CRC32C\n");
+								if(decode_secret_file_crc(decInfo) == e_failure)
+								{
+									//Remove a corrupt output file so it is not taken for the secret.
+									if(remove_output_file(decInfo))
+									{
+										fprintf(stderr, "ERROR: CRC32C check failed, corrupt %s removed\n", decInfo->output_file_fname);
+									}
+									else
+									{
+										fprintf(stderr, "ERROR: CRC32C check failed, %s is corrupt\n", decInfo->output_file_fname);
+									}
+									return e_failure;
+								}
+								decode_info(decInfo, "INFO: Done\n");
+							}
+							//Read a stego image from a pipe to its end, so the stage writing it is not cut off.
+							if(decInfo->stego_image_size < 0)
+							{
+								while(fread(decInfo->secret_data, 1, SECRET_CHUNK_SIZE, decInfo->fptr_stego_image) > 0)
+								{
+									//The pixels after the secret data are not needed.
+								}
+							}
+							close_decode_files(decInfo);
 							return e_success;
 						}
 						else
 						{
-							printf("INFO: Decoding output file data failed\n");
+							//A stego image cut short leaves part of the secret, which is removed like a corrupt one.
+							if(decInfo->fptr_stego_image != NULL && feof(decInfo->fptr_stego_image))
+							{
+								fprintf(stderr, "ERROR: %s ends before its secret data\n", decInfo->stego_image_fname);
+							}
+							if(remove_output_file(decInfo))
+							{
+								fprintf(stderr, "ERROR: Incomplete %s removed\n", decInfo->output_file_fname);
+							}
+							decode_info(decInfo, "INFO: Decoding output file data failed\n");
 							return e_failure;
 						}
 					}
 					else
 					{
-						printf("INFO: Decoding output file size failed\n");
+						decode_info(decInfo, "INFO: Decoding output file size failed\n");
 						return e_failure;
 					}
 				}
 				else
 				{
-					printf("INFO: Decoding output file extension failed\n");
+					decode_info(decInfo, "INFO: Decoding output file extension failed\n");
 					return e_failure;
 				}
 			}
 			else
 			{
-				printf("INFO: Decoding output file extension size failed\n");
+				decode_info(decInfo, "INFO: Decoding output file extension size failed\n");
 				return e_failure;
 			}
 		}
 		else
 		{
-			printf("INFO: Decoding magic string failed\n");
+			decode_info(decInfo, "INFO: Decoding magic string failed\n");
 			return e_failure;
 		}
 	}
 	else
 	{
-		printf("INFO: Failed to open bmp file.\n");
+		decode_info(decInfo, "INFO: Failed to open bmp file.\n");
 		return e_failure;
 	}
 }
@@ -171,7 +364,7 @@ Status decode_magic_string(char *magic_string, DecodeInfo *decInfo)
 	//Character array to get the decoded magic string.
 	char decoded_magic_str[size + 1];
 	//Decode data from inage.
-	if(decode_data_from_image(size, decoded_magic_str, decInfo) == e_success)
+	if(decode_data_from_image(size, 1, decoded_magic_str, decInfo) == e_success)
 	{
 		decoded_magic_str[size] = '\0';
 		//Validating magic string by comparing the decoded magic string with the original magic string.
@@ -184,19 +377,41 @@ Status decode_magic_string(char *magic_string, DecodeInfo *decInfo)
 			return e_failure;
 		}
 	}
+	return e_failure;
 }
 
 /* Decoding file extenstion size from stego image file
+ * Description: The format flags above the extension size give the payload depth.
  * Input: File information of stego image file and output file
- * Output: Decode the output file extenstion size from stego image.
+ * Output: Decode the output file extenstion size and payload depth from stego image.
  * Return: e_success or e_failure
  */
 
 Status decode_extn_size(DecodeInfo *decInfo)
 {
-	//Decode the extension size from lsb of each byte of image data.
-	decode_size_from_lsb(&decInfo->file_extn_size, decInfo);			
+	int field;
+	uint extn_size;
+	StegoHeader header;
+
+	//Decode the extension size field from lsb of each byte of image data.
+	if(decode_size_from_lsb(&field, decInfo) == e_failure)
+	{
+		return e_failure;
+	}			
 
+	//Unknown format flags, or an extension that does not fit in output_file_extn.
+	if(stego_parse_extn_field(field, &extn_size, &header) == e_failure)
+	{
+		return e_failure;
+	}
+	decInfo->file_extn_size = extn_size;
+	decInfo->depth = header.depth;
+	decInfo->compressed = header.compressed;
+	decInfo->crc = header.crc;
+	decInfo->encrypted = header.encrypted;
+	decInfo->scatter = header.scatter;
+	decInfo->striped = header.striped;
+	decInfo->large = header.large;
 	return e_success;
 }
 
@@ -209,7 +424,7 @@ Status decode_extn_size(DecodeInfo *decInfo)
 Status decode_secret_file_extn(int size, DecodeInfo *decInfo)
 {
 	//Decode secret file extension from the image.
-	if(decode_data_from_image(size, decInfo->output_file_extn, decInfo) == e_success)
+	if(decode_data_from_image(size, 1, decInfo->output_file_extn, decInfo) == e_success)
 	{
 		decInfo->output_file_extn[size] = '\0';
 
@@ -221,6 +436,29 @@ Status decode_secret_file_extn(int size, DecodeInfo *decInfo)
 	}
 }
 
+/* Decode a size field as wide as the secret file size
+ * Description: Large secrets (LARGE_FLAG) store two 32 bit fields, the
+ * high half first.
+ * Input: FILE info of stego image with the format flags decoded
+ * Output: Decode the size and store it in size
+ * Return: e_success or e_failure
+ */
+static Status decode_wide_size(long *size, DecodeInfo *decInfo)
+{
+	int high = 0, low;
+
+	if(decInfo->large && decode_size_from_lsb(&high, decInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	if(decode_size_from_lsb(&low, decInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	*size = (long)((unsigned long)(uint)high << 32 | (uint)low);
+	return e_success;
+}
+
 /* Decode file size from stego image
  * Input: FILE info of stego image and output file
  * Output: Decodes the file image and store in image_data_size
@@ -230,49 +468,590 @@ Status decode_secret_file_extn(int size, DecodeInfo *decInfo)
 Status decode_secret_file_size(DecodeInfo *decInfo)
 {
 	//Decode output file size from the lsb of each byte in image.
-	decode_size_from_lsb(&decInfo -> output_file_size, decInfo);		
+	if(decode_wide_size(&decInfo -> output_file_size, decInfo) == e_failure)
+	{
+		return e_failure;
+	}		
 
+	//Reject sizes the stego image cannot hold before decoding anything, no depth stores more than 4 bits per carrier byte.
+	if(decInfo->output_file_size < 0 || (unsigned long)decInfo->output_file_size > carrier_size(&decInfo->carrier) / 2)
+	{
+		return e_failure;
+	}
+	if((decInfo->striped ? STEGO_STRIPE_SPAN(decInfo->large ? LARGE_FLAG : 0) : 0) + (decInfo->encrypted ? 8 * CHACHA20_NONCE_SIZE : 0) + (decInfo->scatter ? scatter_span(lsb_carrier_bytes(decInfo->output_file_size, decInfo->depth)) : lsb_carrier_bytes(decInfo->output_file_size, decInfo->depth)) + (decInfo->crc ? STEGO_CRC_SPAN : 0) > carrier_size(&decInfo->carrier) - decInfo->carrier_pos)
+	{
+		return e_failure;
+	}
 	return e_success;
 }
 
+/* Decode the stripe fields
+ * Description: Id, index and count of the stripe, then offset and size
+ * of the whole secret data as wide as the secret file size, see stego.h.
+ * The range has to be inside the whole secret data.
+ * Input: FILE info of stego image with the secret file size decoded
+ * Output: Stores the stripe fields in decInfo
+ * Return: e_success or e_failure
+ */
+Status decode_secret_file_stripe(DecodeInfo *decInfo)
+{
+	int fields[3];
+	long offset, total;
+	StegoHeader header;
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(decode_size_from_lsb(&fields[i], decInfo) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	if(decode_wide_size(&offset, decInfo) == e_failure || decode_wide_size(&total, decInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	header.compressed = decInfo->compressed;
+	header.size = decInfo->output_file_size;
+	header.stripe.id = fields[0];
+	header.stripe.index = fields[1];
+	header.stripe.count = fields[2];
+	header.stripe.offset = (unsigned long)offset;
+	header.stripe.total = (unsigned long)total;
+	if(stego_check_stripe(&header) == e_failure)
+	{
+		return e_failure;
+	}
+	decInfo->stripe = header.stripe;
+	return e_success;
+}
+
+/* Decode the nonce of the encrypted secret data
+ * Input: FILE info of stego image
+ * Output: Stores the nonce in decInfo
+ * Return: e_success or e_failure
+ */
+Status decode_secret_file_nonce(DecodeInfo *decInfo)
+{
+	return decode_data_from_image(CHACHA20_NONCE_SIZE, 1, (char *)decInfo->nonce, decInfo);
+}
+
+/* Read scattered secret data
+ * Description: Every tile the data is in is read whole, one page (and its
+ * row padding) per pread, and the data extracted from its units.
+ * Input: Stego image descriptor, scatter map, tile buffer, carrier byte of the secret the data starts at, data buffer, data size, depth
+ * Output: Data rebuilt from the tiles
+ * Return: e_success or e_failure
+ */
+static Status read_scattered_data(int fd, const ScatterMap *map, char *tile, long pos, char *data, size_t size, int depth)
+{
+	while(size > 0)
+	{
+		size_t index = pos / SCATTER_TILE_SIZE;
+		size_t bytes = scatter_tile_bytes(pos, size, depth);
+		ssize_t span = scatter_tile_span(map, index);
+
+		if(pread(fd, tile, span, scatter_tile_offset(map, index)) != span)
+		{
+			return e_failure;
+		}
+		scatter_extract_tile(map, index, data, tile, pos % SCATTER_TILE_SIZE, bytes, depth);
+		pos = (index + 1) * SCATTER_TILE_SIZE;
+		data += bytes;
+		size -= bytes;
+	}
+	return e_success;
+}
+
+/* Decode the next chunk of secret data into secret_data
+ * Input: Chunk size, secret offset of the chunk, FILE info of stego image
+ * Output: Chunk in secret_data, from the next carrier bytes or from its tiles
+ * Return: e_success or e_failure
+ */
+static Status decode_secret_chunk(int chunk, long offset, DecodeInfo *decInfo)
+{
+	if(decInfo->scatter)
+	{
+		return read_scattered_data(fileno(decInfo->fptr_stego_image), &decInfo->scatter_map, decInfo->scatter_tile, lsb_carrier_bytes(offset, decInfo->depth), decInfo->secret_data, chunk, decInfo->depth);
+	}
+	return decode_data_from_image(chunk, decInfo->depth, decInfo->secret_data, decInfo);
+}
+
+/* Decode file data one chunk at a time
+ * Description: The secret data is decoded through the fixed size secret_data
+ * buffer and written to the output file one chunk at a time.
+ * Input: FILE info of stego image and output decode file
+ * Output: Write decode data in the output file
+ * Return: e_success or e_failure
+ */
+static Status decode_secret_file_chunks(long size, DecodeInfo *decInfo)
+{
+	long remaining = size;
+
+	while(remaining > 0)
+	{
+		int chunk = remaining < SECRET_CHUNK_SIZE ? remaining : SECRET_CHUNK_SIZE;
+
+		//Decode the next chunk of secret data from the image.
+		if(decode_secret_chunk(chunk, size - remaining, decInfo) == e_failure)
+		{
+			return e_failure;
+		}
+		//The CRC32C is taken on the stored bytes, then they are decrypted.
+		if(decInfo->crc)
+		{
+			decInfo->payload_crc = crc32c(decInfo->payload_crc, decInfo->secret_data, chunk);
+		}
+		if(decInfo->encrypted)
+		{
+			chacha20_xor(decInfo->key, decInfo->nonce, size - remaining, decInfo->secret_data, chunk);
+		}
+		//Write the chunk in the output file.
+		if(fwrite(decInfo->secret_data, 1, chunk, decInfo -> fptr_output_file) != (size_t)chunk)
+		{
+			return e_failure;
+		}
+		remaining -= chunk;
+	}
+
+	return e_success;
+}
+
+/* Check whether the worker pool decodes the secret data
+ * Description: Slices pread the stego image and pwrite the output file at
+ * their own offsets, so both have to be regular files, and compressed
+ * frames only decode in order. A - output is a stream even when stdout is
+ * a regular file, it may be appended to or follow other output.
+ * Input: Secret size, FILE info of stego image and opened output file
+ * Output: None
+ * Return: Non zero to decode on the worker pool
+ */
+static int parallel_decoding(long size, const DecodeInfo *decInfo)
+{
+	return !decInfo->compressed && decInfo->pool != NULL && size >= PARALLEL_MIN_SIZE && decInfo->stego_image_size >= 0 && !stdio_file_name(decInfo->output_file_fname) && regular_file(decInfo->fptr_output_file);
+}
+
 /* Decode file data from stego image
+ * Description: Picks the engine for the secret data, see decode_secret_file_chunks.
  * Input: FILE info of stego image and output decode file
  * Output: Write decode data in the output file
  * Return: e_success or e_failure
  */
 
-Status decode_secret_file_data(int size, DecodeInfo *decInfo)
+Status decode_secret_file_data(long size, DecodeInfo *decInfo)
 {
-	char secret_file_data[size + 1];
+	decInfo->payload_crc = 0;
 	//Open secret file.
-	open_secret_file (decInfo);
-	//Decode secret data from the image.
-	if(decode_data_from_image(size, secret_file_data, decInfo) == e_success)
+	if(open_secret_file (decInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	//Scattered secrets are read from keyed tiles of the image.
+	if(decInfo->scatter)
+	{
+		return decode_secret_file_data_scattered(size, decInfo);
+	}
+	//Large secrets are split across the worker pool.
+	if(parallel_decoding(size, decInfo))
+	{
+		return decode_secret_file_data_parallel(size, decInfo);
+	}
+	//Large carriers overlap reads, extraction and writes.
+	if(lsb_carrier_bytes(size, decInfo->depth) >= PIPELINE_MIN_SIZE)
+	{
+		return decode_secret_file_data_pipelined(size, decInfo);
+	}
+	if(decInfo->compressed)
 	{
-		secret_file_data[size] = '\0';
-		//Write the secret data in a file.
-		fwrite(secret_file_data, size, 1, decInfo -> fptr_output_file);	
+		return decode_compressed_secret_file_data(size, decInfo);
 	}
+	return decode_secret_file_chunks(size, decInfo);
+}
+
+/* Decode scattered file data
+ * Description: The region is every whole tile from the current stego
+ * position to the CRC32C (if any) at the end of the image, the key and
+ * nonce pick the tiles the secret data is in. They are read with pread,
+ * so the stego image has to be a regular file. The CRC32C is read from
+ * right after the last whole tile.
+ * Input: Secret size, FILE info of stego image with the nonce decoded and opened output file
+ * Output: Write decode data in the output file
+ * Return: e_success or e_failure
+ */
+Status decode_secret_file_data_scattered(long size, DecodeInfo *decInfo)
+{
+	size_t region_start = decInfo->carrier_pos;
+	size_t region = stego_scatter_region(carrier_size(&decInfo->carrier), region_start, decInfo->crc);
+	Status status;
+
+	if(decInfo->stego_image_size < 0)
+	{
+		fprintf(stderr, "ERROR: %s holds scattered data, it has to be a file\n", decInfo->stego_image_fname);
+		return e_failure;
+	}
+	if(scatter_init(&decInfo->scatter_map, decInfo->key, decInfo->nonce, &decInfo->carrier, region_start, region, lsb_carrier_bytes(size, decInfo->depth)) == e_failure)
+	{
+		return e_failure;
+	}
+	//Large secrets are split across the worker pool.
+	if(parallel_decoding(size, decInfo))
+	{
+		status = decode_secret_file_data_parallel(size, decInfo);
+	}
+	else if(decInfo->compressed)
+	{
+		status = decode_compressed_secret_file_data(size, decInfo);
+	}
+	else
+	{
+		status = decode_secret_file_chunks(size, decInfo);
+	}
+	scatter_free(&decInfo->scatter_map);
+	decInfo->carrier_pos = region_start + region;
+	fseek(decInfo->fptr_stego_image, carrier_offset(&decInfo->carrier, decInfo->carrier_pos), SEEK_SET);
 
+	return status;
+}
+
+/* Slice boundary
+ * Description: Boundaries are rounded down to LSB_DEPTH_ALIGN so every slice
+ * starts on a whole carrier byte at any depth, the last one ends at size.
+ * Input: Secret size, boundary index, number of slices
+ * Output: None
+ * Return: Secret offset of the boundary
+ */
+static long slice_bound(long size, int index, int count)
+{
+	if(index == count)
+	{
+		return size;
+	}
+	return size * index / count / LSB_DEPTH_ALIGN * LSB_DEPTH_ALIGN;
+}
+
+/* Write decompressed data to the output file, LzWriteFn for lz_stream_write */
+static Status write_output_data(const char *data, size_t size, void *arg)
+{
+	DecodeInfo *decInfo = arg;
+
+	return fwrite(data, 1, size, decInfo->fptr_output_file) == size ? e_success : e_failure;
+}
+
+/* Pipeline state of a secret being decoded */
+typedef struct _DecodePipeline
+{
+	DecodeInfo *decInfo;
+	long remaining;								//Secret bytes left to read.
+	long extracted;								//Secret bytes extracted, keystream offset of the next chunk.
+	size_t pos;									//Carrier byte of the next chunk read.
+	LzStream *stream;							//Frame parser of a compressed secret, NULL otherwise.
+} DecodePipeline;
+
+/* Pipeline reader: carrier bytes of the next secret chunk */
+static Status decode_read_chunk(void *arg, PipelineSlot *slot)
+{
+	DecodePipeline *pipeline = arg;
+	size_t carrier;
+
+	slot->size = pipeline->remaining < SECRET_CHUNK_SIZE ? pipeline->remaining : SECRET_CHUNK_SIZE;
+	carrier = lsb_carrier_bytes(slot->size, pipeline->decInfo->depth);
+	slot->image_size = carrier_span(&pipeline->decInfo->carrier, pipeline->pos, carrier);
+	if(fread(slot->image, 1, slot->image_size, pipeline->decInfo->fptr_stego_image) != slot->image_size)
+	{
+		return e_failure;
+	}
+	pipeline->remaining -= slot->size;
+	pipeline->pos += carrier;
 	return e_success;
 }
 
+/* Pipeline processor: extract the secret chunk */
+static Status decode_extract_chunk(void *arg, PipelineSlot *slot)
+{
+	DecodePipeline *pipeline = arg;
+	DecodeInfo *decInfo = pipeline->decInfo;
+
+	stego_extract_bytes(&decInfo->carrier, slot->data, slot->image, decInfo->carrier_pos + lsb_carrier_bytes(pipeline->extracted, decInfo->depth), slot->size, decInfo->depth);
+	//Chunks come through in order, the CRC32C and decryption run on the data while it is in cache.
+	if(decInfo->crc)
+	{
+		decInfo->payload_crc = crc32c(decInfo->payload_crc, slot->data, slot->size);
+	}
+	if(decInfo->encrypted)
+	{
+		chacha20_xor(decInfo->key, decInfo->nonce, pipeline->extracted, slot->data, slot->size);
+	}
+	pipeline->extracted += slot->size;
+	return e_success;
+}
+
+/* Pipeline writer: write the chunk, expanding compressed frames */
+static Status decode_write_chunk(void *arg, PipelineSlot *slot)
+{
+	DecodePipeline *pipeline = arg;
+
+	if(pipeline->stream != NULL)
+	{
+		return lz_stream_write(pipeline->stream, slot->data, slot->size, write_output_data, pipeline->decInfo);
+	}
+	return write_output_data(slot->data, slot->size, pipeline->decInfo);
+}
+
+/* Decode file data through the pipeline
+ * Description: Reading the stego image, extracting, and writing (and
+ * decompressing) the output run on three threads over a ring of chunk
+ * buffers, so disk and CPU work overlap.
+ * Input: Secret size, FILE info of stego image and opened output file
+ * Output: Write decode data in the output file
+ * Return: e_success or e_failure
+ */
+Status decode_secret_file_data_pipelined(long size, DecodeInfo *decInfo)
+{
+	DecodePipeline pipeline;
+	Status status;
+
+	pipeline.decInfo = decInfo;
+	pipeline.remaining = size;
+	pipeline.extracted = 0;
+	pipeline.pos = decInfo->carrier_pos;
+	pipeline.stream = NULL;
+	if(decInfo->compressed)
+	{
+		pipeline.stream = malloc(sizeof(LzStream));
+		if(pipeline.stream == NULL)
+		{
+			return e_failure;
+		}
+		lz_stream_init(pipeline.stream);
+	}
+
+	status = pipeline_run(decode_read_chunk, decode_extract_chunk, decode_write_chunk, &pipeline, SECRET_CHUNK_SIZE);
+	decInfo->carrier_pos = pipeline.pos;
+	//The last frame has to be complete.
+	if(status == e_success && pipeline.stream != NULL)
+	{
+		status = lz_stream_finish(pipeline.stream);
+	}
+	free(pipeline.stream);
+	return status;
+}
+
+/* Decode compressed file data from stego image
+ * Description: The stored frames are decoded chunk by chunk through
+ * secret_data and expanded as they arrive, so only one block is ever held
+ * decompressed. size is the stored (compressed) size.
+ * Input: Stored size, FILE info of stego image and opened output file
+ * Output: Write decompressed data in the output file
+ * Return: e_success or e_failure
+ */
+Status decode_compressed_secret_file_data(long size, DecodeInfo *decInfo)
+{
+	LzStream *stream = malloc(sizeof(LzStream));
+	long remaining = size;
+	Status status = e_success;
+
+	if(stream == NULL)
+	{
+		return e_failure;
+	}
+	lz_stream_init(stream);
+	while(remaining > 0 && status == e_success)
+	{
+		int chunk = remaining < SECRET_CHUNK_SIZE ? remaining : SECRET_CHUNK_SIZE;
+
+		//Decode the next chunk of frames and expand it into the output file.
+		if(decode_secret_chunk(chunk, size - remaining, decInfo) == e_failure)
+		{
+			status = e_failure;
+			break;
+		}
+		if(decInfo->crc)
+		{
+			decInfo->payload_crc = crc32c(decInfo->payload_crc, decInfo->secret_data, chunk);
+		}
+		if(decInfo->encrypted)
+		{
+			chacha20_xor(decInfo->key, decInfo->nonce, size - remaining, decInfo->secret_data, chunk);
+		}
+		status = lz_stream_write(stream, decInfo->secret_data, chunk, write_output_data, decInfo);
+		remaining -= chunk;
+	}
+	//The last frame has to be complete.
+	if(status == e_success)
+	{
+		status = lz_stream_finish(stream);
+	}
+	free(stream);
+	return status;
+}
+
+/* Decode one slice of the secret data
+ * Description: Slice index covers secret bytes [slice_bound(index),
+ * slice_bound(index + 1)). Every secret byte only depends on its own stego
+ * bytes, so slices read, decode and write their range independently.
+ * Input: Slices description, slice index
+ * Output: The slice is written to its place in the output file
+ * Return: None
+ */
+static void decode_slice(void *arg, int index)
+{
+	DecodeSlices *slices = arg;
+	long start = slice_bound(slices->size, index, slices->count);
+	long end = slice_bound(slices->size, index + 1, slices->count);
+	char *image_buffer = malloc(CARRIER_SPAN_MAX(SECRET_CHUNK_SIZE * 8));
+	char *secret_data = malloc(SECRET_CHUNK_SIZE);
+	uint crc = 0;
+
+	while(image_buffer != NULL && secret_data != NULL && start < end)
+	{
+		size_t chunk = end - start < SECRET_CHUNK_SIZE ? end - start : SECRET_CHUNK_SIZE;
+		size_t pos = slices->pos + lsb_carrier_bytes(start, slices->depth);
+		ssize_t span = carrier_span(slices->carrier, pos, lsb_carrier_bytes(chunk, slices->depth));
+
+		//Read 8 / depth carrier bytes per secret byte, decode and write them in place.
+		if(slices->scatter != NULL)
+		{
+			if(read_scattered_data(slices->stego_fd, slices->scatter, image_buffer, lsb_carrier_bytes(start, slices->depth), secret_data, chunk, slices->depth) == e_failure)
+			{
+				break;
+			}
+		}
+		else
+		{
+			if(pread(slices->stego_fd, image_buffer, span, carrier_offset(slices->carrier, pos)) != span)
+			{
+				break;
+			}
+			stego_extract_bytes(slices->carrier, secret_data, image_buffer, pos, chunk, slices->depth);
+		}
+		if(slices->crcs != NULL)
+		{
+			crc = crc32c(crc, secret_data, chunk);
+		}
+		//The keystream starts at the slice's own offset.
+		if(slices->key != NULL)
+		{
+			chacha20_xor(slices->key, slices->nonce, start, secret_data, chunk);
+		}
+		if(pwrite(slices->output_fd, secret_data, chunk, slices->output_offset + start) != (ssize_t)chunk)
+		{
+			break;
+		}
+		start += chunk;
+	}
+	if(start < end)
+	{
+		__atomic_store_n(&slices->failed, 1, __ATOMIC_RELAXED);
+	}
+	if(slices->crcs != NULL)
+	{
+		slices->crcs[index] = crc;
+	}
+	free(secret_data);
+	free(image_buffer);
+}
+
+/* Decode file data on the worker pool
+ * Description: Splits the secret data into a few slices per thread, every
+ * slice preads its stego bytes and pwrites the decoded bytes to their own
+ * range of the output file. The CRC32C of every slice is taken as it is
+ * decoded and the slices are combined.
+ * Input: Secret size, FILE info of stego image and opened output file
+ * Output: Write decode data in the output file
+ * Return: e_success or e_failure
+ */
+Status decode_secret_file_data_parallel(long size, DecodeInfo *decInfo)
+{
+	DecodeSlices slices;
+
+	slices.stego_fd = fileno(decInfo->fptr_stego_image);
+	slices.carrier = &decInfo->carrier;
+	slices.pos = decInfo->carrier_pos;
+	slices.output_fd = fileno(decInfo->fptr_output_file);
+	slices.output_offset = decInfo->stripe_set ? decInfo->stripe.offset : 0;
+	slices.size = size;
+	slices.depth = decInfo->depth;
+	slices.count = thread_pool_size(decInfo->pool) * 4;
+	slices.failed = 0;
+	slices.crcs = NULL;
+	slices.key = decInfo->encrypted ? decInfo->key : NULL;
+	slices.nonce = decInfo->nonce;
+	slices.scatter = decInfo->scatter ? &decInfo->scatter_map : NULL;
+
+	//pwrite needs a regular output file, a striped set sizes it before any stripe is decoded.
+	if(decInfo->stego_image_size < 0 || (!decInfo->stripe_set && ftruncate(slices.output_fd, size) != 0))
+	{
+		return e_failure;
+	}
+	if(decInfo->crc)
+	{
+		slices.crcs = malloc(slices.count * sizeof(uint));
+		if(slices.crcs == NULL)
+		{
+			return e_failure;
+		}
+	}
+
+	thread_pool_run(decInfo->pool, decode_slice, &slices, slices.count);
+	for(int i = 0; slices.crcs != NULL && i < slices.count; i++)
+	{
+		long slice_size = slice_bound(size, i + 1, slices.count) - slice_bound(size, i, slices.count);
+
+		decInfo->payload_crc = crc32c_combine(decInfo->payload_crc, slices.crcs[i], slice_size);
+	}
+	free(slices.crcs);
+	if(slices.failed)
+	{
+		return e_failure;
+	}
+	//Move the FILE pointer past the secret data, a scattered secret moves past its region after this.
+	decInfo->carrier_pos += lsb_carrier_bytes(size, decInfo->depth);
+	fseek(decInfo->fptr_stego_image, carrier_offset(&decInfo->carrier, decInfo->carrier_pos), SEEK_SET);
+
+	return e_success;
+}
+
+/* Check the CRC32C of the secret data
+ * Description: The CRC32C stored after the secret data has to match the
+ * one taken while it was decoded.
+ * Input: Decode Info with payload_crc of the secret data just decoded
+ * Output: None
+ * Return: e_success, or e_failure if it cannot be read or does not match
+ */
+Status decode_secret_file_crc(DecodeInfo *decInfo)
+{
+	int stored;
+
+	if(decode_size_from_lsb(&stored, decInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	return (uint)stored == decInfo->payload_crc ? e_success : e_failure;
+}
+
 /* Decode data from image.
- * Input: no of characters and character data array, stego image file pointer.
+ * Input: no of characters, bits per carrier byte and character data array, stego image file pointer.
  * Output: Decode the data from the image_data 
  * Return: e_success or e_failure
  */
 
-Status decode_data_from_image(int size, char *char_data, DecodeInfo *decInfo)
+Status decode_data_from_image(int size, int depth, char *char_data, DecodeInfo *decInfo)
 {
-	char image_buffer[8];
-	//Loop until no of character times.
-	for(int i = 0; i < size; i++)							
+	char image_buffer[CARRIER_SPAN_MAX(DECODE_BLOCK_SIZE * 8)];
+	//Loop until no of character times, one block at a time.
+	for(int i = 0; i < size; i += DECODE_BLOCK_SIZE)
 	{
-		//Reading 8 bytes from stego image and storing it into image buffer.
-		fread(image_buffer, 8, 1, decInfo -> fptr_stego_image);
-		//decode secret data (byte) from lsb.	
-		decode_byte_from_lsb(&char_data[i] ,image_buffer);
+		int block = size - i < DECODE_BLOCK_SIZE ? size - i : DECODE_BLOCK_SIZE;
+		size_t carrier = lsb_carrier_bytes(block, depth);
+		size_t span = carrier_span(&decInfo->carrier, decInfo->carrier_pos, carrier);
+
+		//Reading 8 / depth carrier bytes per character (and the row padding between them) from stego image and storing it into image buffer.
+		if(fread(image_buffer, 1, span, decInfo -> fptr_stego_image) != span)
+		{
+			return e_failure;
+		}
+		//decode the whole block of secret data from the low bits.
+		stego_extract_bytes(&decInfo->carrier, &char_data[i], image_buffer, decInfo->carrier_pos, block, depth);
+		decInfo->carrier_pos += carrier;
 	}
 
 	return e_success;
@@ -306,21 +1085,23 @@ Status decode_byte_from_lsb(char *data, char *image_buffer)
 
 Status decode_size_from_lsb(int *size, DecodeInfo *decInfo)
 {
-	char buffer[32];
-	//Read 32 bytes from stego image and store it in buffer.
-	fread(buffer, 32, 1, decInfo -> fptr_stego_image);					
+	char buffer[CARRIER_SPAN_MAX(32)];
+	size_t span = carrier_span(&decInfo->carrier, decInfo->carrier_pos, 32);
 
-	//loop till 32 (for 32 bytes)
-	for(int i = 0; i < 32; i++)
+	//Read 32 carrier bytes from stego image and store them in buffer.
+	if(fread(buffer, span, 1, decInfo -> fptr_stego_image) != 1)
 	{
-		//Leftshift the size and store the lsb of image in size.
-		//Get the lsb bit from image buffer.
-		*size = *size << 1 | buffer[i] & 1;						
+		return e_failure;
 	}
+	//Rebuild the size from the lsb of the 32 carrier bytes, MSB first.
+	*size = (int)stego_extract_size(&decInfo->carrier, buffer, decInfo->carrier_pos);
+	decInfo->carrier_pos += 32;
 	return e_success;
 }
 
 /* Open secret file
+ * Description: One stripe of a set opens the output file the set shares
+ * and starts at its own range.
  * Inputs: Secret file pointer and file name
  * Output: Open the secret file and read the address and store it in a file pointer.
  * Return: e_success or e_failure.
@@ -328,7 +1109,12 @@ Status decode_size_from_lsb(int *size, DecodeInfo *decInfo)
 
 Status open_secret_file (DecodeInfo *decInfo)
 {
-	decInfo->fptr_output_file = fopen(decInfo->output_file_fname, "w");			
+	decInfo->fptr_output_file = open_stdio_file(decInfo->output_file_fname, decInfo->stripe_set ? "r+" : "w", decInfo->stdout_fd);
+	if (decInfo->fptr_output_file != NULL && decInfo->stripe_set && fseek(decInfo->fptr_output_file, decInfo->stripe.offset, SEEK_SET) != 0)
+	{
+		fclose(decInfo->fptr_output_file);
+		decInfo->fptr_output_file = NULL;
+	}
 	//Error handling
 	if (decInfo->fptr_output_file == NULL)							
 	{
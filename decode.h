@@ -2,6 +2,12 @@
 #define DECODE_H
 
 #include "types.h" // Contains user defined types
+#include "thread_pool.h"
+#include "stats.h"
+#include "chacha20.h"
+#include "scatter.h"
+#include "carrier.h"
+#include "stego.h"
 /* 
  * Structure to store information required for
  * decoding secret file from stego Image
@@ -12,18 +18,48 @@
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
 #define MAX_FILE_SUFFIX 4
+#define MAX_OUTPUT_FNAME 256
+#define DECODE_BLOCK_SIZE 480					//Multiple of LSB_DEPTH_ALIGN.
+#define SECRET_CHUNK_SIZE (60 * 1024)			//Multiple of LSB_DEPTH_ALIGN.
+#define PARALLEL_MIN_SIZE (256 * 1024)
 typedef struct _DecodeInfo
 {
     /* Stego Image Info */
     char *stego_image_fname;		  			//Pointer to store address of stego file name.
-    FILE *fptr_stego_image;		  				//Pointer to store address of stego bmp file.			
+    FILE *fptr_stego_image;		  				//Pointer to store address of stego image file.			
+    long stego_image_size;						//Size of stego image file, -1 if not a regular file.
+    Carrier carrier;							//Pixel layout of the stego image.
+    size_t carrier_pos;							//Carrier byte the next field is read from.
     /* Output File Info */
-    char output_file_fname[10];					//Pointer to store address of output file name.
+    char output_file_fname[MAX_OUTPUT_FNAME];	//Array to store output file name.
     FILE *fptr_output_file;						//Pointer to store address of output file.
-    int output_file_size;						//Stores size of output file
+    long output_file_size;						//Stores size of output file
     
     int file_extn_size;							//Stores size of extension of output file
+    int depth;									//Payload bits per carrier byte, read from the image.
+    int compressed;								//Secret data is stored as LZ frames, read from the image.
+    int crc;									//A CRC32C of the secret data follows it, read from the image.
+    uint payload_crc;							//CRC32C of the secret data decoded so far.
+    int encrypted;								//Secret data is ChaCha20 encrypted, read from the image.
+    unsigned char nonce[CHACHA20_NONCE_SIZE];	//Nonce of the encryption, read from the image.
+    const unsigned char *key;					//ChaCha20 key to decrypt the secret with, NULL for none.
+    int scatter;								//Secret data is scattered over keyed tiles, read from the image.
+    ScatterMap scatter_map;						//Tiles of the scattered secret while it is decoded.
+    char scatter_tile[CARRIER_SPAN_MAX(SCATTER_TILE_SIZE)];	//File bytes of one tile.
+    int large;									//Sizes are 64 bit fields (LARGE_FLAG), read from the image.
+    int striped;								//Secret data is one stripe of a larger one, read from the image.
+    StegoStripe stripe;							//Stripe fields, read from the image.
+    int stripe_set;								//Non zero to write the stripe into its range of a shared output file.
+    int stdin_fd;								//Descriptor a - stego image is read from, STDIN_FILENO outside the daemon.
+    int stdout_fd;								//Descriptor a - output file is written to, STDOUT_FILENO outside the daemon.
     char output_file_extn[MAX_FILE_SUFFIX + 1];	//Array to store extension of output file.
+    char secret_data[SECRET_CHUNK_SIZE];		//Reusable chunk of decoded secret data.
+
+    /* Parallel decode Info */
+    ThreadPool *pool;							//Worker pool for secret data, NULL to decode on one thread.
+
+    int quiet;									//Non zero to skip the INFO lines.
+    Stats *stats;								//Stage timings and I/O counters, NULL when not recorded.
 
 } DecodeInfo;
 
@@ -35,7 +71,13 @@ Status read_and_validate_decode(char *argv[], DecodeInfo *decInfo);
 /* Perform the decoding */
 Status do_decoding(DecodeInfo *decInfo);
 
-/* Get File pointers for bmp file */
+/* Close all files opened while decoding */
+void close_decode_files(DecodeInfo *decInfo);
+
+/* Print an INFO line unless quiet */
+void decode_info(const DecodeInfo *decInfo, const char *format, ...);
+
+/* Get File pointers for stego image file */
 Status open_bmp_file(DecodeInfo *decInfo);
 
 /* Decode Magic String */
@@ -50,11 +92,32 @@ Status decode_secret_file_extn(int size, DecodeInfo *decInfo);
 /* Decode secret file size */
 Status decode_secret_file_size(DecodeInfo *decInfo);
 
+/* Decode the stripe fields after the secret file size */
+Status decode_secret_file_stripe(DecodeInfo *decInfo);
+
+/* Decode the nonce of the encrypted secret data */
+Status decode_secret_file_nonce(DecodeInfo *decInfo);
+
 /* Decode secret file data*/
-Status decode_secret_file_data(int size, DecodeInfo *decInfo);
+Status decode_secret_file_data(long size, DecodeInfo *decInfo);
+
+/* Decode and decompress secret file data stored as LZ frames */
+Status decode_compressed_secret_file_data(long size, DecodeInfo *decInfo);
+
+/* Check the secret data against the CRC32C that follows it */
+Status decode_secret_file_crc(DecodeInfo *decInfo);
+
+/* Decode secret file data from the keyed tiles of the stego image */
+Status decode_secret_file_data_scattered(long size, DecodeInfo *decInfo);
+
+/* Decode secret file data with reads, extraction and writes overlapped */
+Status decode_secret_file_data_pipelined(long size, DecodeInfo *decInfo);
+
+/* Decode secret file data on all threads of the pool */
+Status decode_secret_file_data_parallel(long size, DecodeInfo *decInfo);
 
 /* Decode data to image */
-Status decode_data_from_image(int size, char *char_data, DecodeInfo *decInfo);
+Status decode_data_from_image(int size, int depth, char *char_data, DecodeInfo *decInfo);
 
 /* Decode a byte from lsb of image data */
 Status decode_byte_from_lsb(char *data, char *image_buffer);
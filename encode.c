@@ -1,11 +1,56 @@
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "carrier.h"
+#include "chacha20.h"
+#include "crc32c.h"
 #include "encode.h"
+#include "file_copy.h"
+#include "lsb.h"
+#include "lz.h"
+#include "pipeline.h"
+#include "scatter.h"
+#include "stego.h"
 #include "types.h"
 #include "common.h"
 
 /* Function Definitions */
 
+/* Get file extension
+ * Input: File name
+ * Output: None
+ * Return: Address of the last '.' in the file name, or "" if there is none.
+ */
+const char *file_extn(const char *fname)
+{
+	const char *extn = strrchr(fname, '.');
+
+	return extn != NULL ? extn : "";
+}
+
+/* Default stego image name
+ * Input: Source image file name
+ * Output: None
+ * Return: stego_image with the extension of the source image
+ */
+static char *default_stego_name(const char *src_fname)
+{
+	static char *names[] = { "stego_image.bmp", "stego_image.ppm", "stego_image.tga" };
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(strcmp(file_extn(names[i]), file_extn(src_fname)) == 0)
+		{
+			return names[i];
+		}
+	}
+	return names[0];
+}
+
 /* Read and validate command line arguments
  * Description: To check whether the file names are in correct formats.
  * Input: Command line Arguments (File names)
@@ -14,8 +59,8 @@
  */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 {
-	//Check the source file(argv[2]) is a .bmp file or not.
-	if(strcmp(strstr(argv[2],"."), ".bmp") == 0)
+	//Check the source file(argv[2]) is a .bmp, .ppm or .tga file or not, - reads it from stdin.
+	if(carrier_image_name(argv[2]) || stdio_file_name(argv[2]))
 	{
 		//If yes, Store the address of the source file name.
 		encInfo->src_image_fname = argv[2];
@@ -23,45 +68,77 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 	else
 	{
 		//ERROR.
-		fprintf(stderr,"Error : Source file %s format should be .bmp\n", argv[2]);
-		printf("%s : Encoding: %s -e <.bmp file> <.txt file> [Output file]\n",argv[0],argv[0]);
+		fprintf(stderr,"Error : Source file %s format should be .bmp, .ppm or .tga\n", argv[2]);
+		printf("%s : Encoding: %s -e <.bmp|.ppm|.tga file> <.txt file> [Output file] [-j N] [-k 1-4|auto] [-z] [--crc] [--in-place] [-q] [--stats=json]\n",argv[0],argv[0]);
 		return e_failure;
 	}
 	//Check the secret file(argv[3]) is a .txt or .sh or .c file and copy the file extension in extn_secret_file.
-
-	if(strcmp(strcpy(encInfo->extn_secret_file, strstr(argv[3], ".")), ".txt") == 0 || strcmp(strcpy(encInfo->extn_secret_file, strstr(argv[3], ".")), ".sh") == 0 || strcmp(strcpy(encInfo->extn_secret_file, strstr(argv[3], ".")), ".c") == 0)
+	//A secret read from stdin has no extension.
+	if(stdio_file_name(argv[3]))
+	{
+		if(stdio_file_name(argv[2]))
+		{
+			fprintf(stderr,"Error : Only one of the source image and the secret file can be read from stdin\n");
+			return e_failure;
+		}
+		encInfo->extn_secret_file[0] = '\0';
+		encInfo->secret_fname = argv[3];
+	}
+	else if(strcmp(file_extn(argv[3]), ".txt") == 0 || strcmp(file_extn(argv[3]), ".sh") == 0 || strcmp(file_extn(argv[3]), ".c") == 0)
 	{
 		//If yes, Store the address of the secret file name.
+		strcpy(encInfo->extn_secret_file, file_extn(argv[3]));
 		encInfo->secret_fname = argv[3];	
 	}
 	else
 	{
 		//ERROR.
 		fprintf(stderr,"Error : Secret file %s format should be .txt or .sh or .c\n", argv[3]);
-		printf("%s : Encoding: %s -e <.bmp file> <.txt file> [Output file]\n",argv[0],argv[0]);
+		printf("%s : Encoding: %s -e <.bmp|.ppm|.tga file> <.txt file> [Output file] [-j N] [-k 1-4|auto] [-z] [--crc] [--in-place] [-q] [--stats=json]\n",argv[0],argv[0]);
 		return e_failure;
 	}
 	//Check if the output file name is passed or not.
-	if(argv[4] != NULL)
+	//In place the source image is the output.
+	if(encInfo->in_place)
 	{
-		//If it is passed, Check the output file is a .bmp file.
-		if(strcmp(strstr(argv[4], "."), ".bmp") == 0)
+		if(argv[4] != NULL)
+		{
+			fprintf(stderr,"Error : No output file with --in-place, %s is changed in place\n", argv[2]);
+			return e_failure;
+		}
+		if(stdio_file_name(argv[2]))
 		{
-			//if it is a bmp file store the address of the file name.
+			fprintf(stderr,"Error : --in-place needs a source image file, not stdin\n");
+			return e_failure;
+		}
+		encInfo->stego_image_fname = encInfo->src_image_fname;
+	}
+	else if(argv[4] != NULL)
+	{
+		//If it is passed, Check the output file is of the source image format, - writes it to stdout.
+		//The format of an image read from stdin is only known once it is read.
+		if(stdio_file_name(argv[4]) || stdio_file_name(argv[2]) || strcmp(file_extn(argv[4]), file_extn(argv[2])) == 0)
+		{
+			//if it is, store the address of the file name.
 			encInfo->stego_image_fname = argv[4];
 		}
 		else
 		{
-			//If it is not bmp , Create a default file name and store it.
-			printf("INFO: Output File is not a .bmp file. Creating stego_img.bmp as default\n");
-			encInfo->stego_image_fname = "stego_image.bmp"; 
+			//If it is not, Create a default file name and store it.
+			encInfo->stego_image_fname = default_stego_name(argv[2]);
+			encode_info(encInfo, "INFO: Output File is not a %s file. Creating %s as default\n", file_extn(argv[2]), encInfo->stego_image_fname);
 		}
 	}
+	else if(stdio_file_name(argv[2]))
+	{
+		//An image read from stdin goes to stdout.
+		encInfo->stego_image_fname = STDIO_FNAME;
+	}
 	else
 	{
-		printf("INFO: Output File not mentioned. Creating stego_img.bmp as default\n");		
 		//If output file is not passed , Create a default file name and store it.
-		encInfo->stego_image_fname = "stego_image.bmp"; 
+		encInfo->stego_image_fname = default_stego_name(argv[2]);
+		encode_info(encInfo, "INFO: Output File not mentioned. Creating %s as default\n", encInfo->stego_image_fname);
 	}
 	return e_success;	
 }
@@ -73,9 +150,9 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
  * Output: Size
  * Return: Size of files in bytes.
  */
-uint get_file_size(FILE *fptr)
+long get_file_size(FILE *fptr)
 {
-	uint secret_file_size;
+	long secret_file_size;
 
 	//Seek to the end of the file.
 	fseek(fptr, 0L, SEEK_END);	//file pointer points to the end of the file.
@@ -90,31 +167,11 @@ uint get_file_size(FILE *fptr)
 	return secret_file_size;
 }
 
-/* Get image size
- * Input: Image file ptr
- * Output: width * height * bytes per pixel (3 in our case)
- * Description: In BMP Image, width is stored in offset 18,
- * and height after that. size is 4 bytes
- */
-uint get_image_size_for_bmp(FILE *fptr_image)
-{
-	uint width, height;
-	// Seek to 18th byte
-	fseek(fptr_image, 18, SEEK_SET);	//file pointer points to the 18 th byte.
-
-	// Read the width (an int)
-	fread(&width, sizeof(int), 1, fptr_image); 	// Read 4bytes from the file and store in width.
-
-	// Read the height (an int)
-	fread(&height, sizeof(int), 1, fptr_image);	//Read 4bytes after width from the file and store it in height.
-
-	// Return image capacity
-	return width * height * 3;	// 3 for RGB.
-}
-
-
 /* 
  * Get File pointers for i/p and o/p files
+ * Description: - names stdin_fd or stdout_fd. An image read from a pipe is only
+ * read once, so its header is copied to the stego image as it is parsed,
+ * and a secret read from a pipe needs its size given (secret_part).
  * Inputs: Src Image file, Secret file and
  * Stego Image file
  * Output: FILE pointer for above files
@@ -122,8 +179,17 @@ uint get_image_size_for_bmp(FILE *fptr_image)
  */
 Status open_files(EncodeInfo *encInfo)
 {
-	// Opening Src Image file
-	encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");	
+	int src_regular;
+
+	//Nothing is open or mapped yet.
+	encInfo->fptr_src_image = NULL;
+	encInfo->fptr_secret = NULL;
+	encInfo->fptr_stego_image = NULL;
+	encInfo->stego_map = NULL;
+	encInfo->patch_buffer = NULL;
+
+	// Opening Src Image file, read write when it is patched in place.
+	encInfo->fptr_src_image = open_stdio_file(encInfo->src_image_fname, encInfo->in_place ? "r+" : "r", encInfo->stdin_fd);
 
 	//Error handling
 	if (encInfo->fptr_src_image == NULL)	//Check if the file is open.
@@ -135,11 +201,20 @@ Status open_files(EncodeInfo *encInfo)
 	}
 	else
 	{
-		printf("INFO: Opened %s\n", encInfo->src_image_fname);
+		encode_info(encInfo, "INFO: Opened %s\n", encInfo->src_image_fname);
+	}
+
+	// Read the pixel layout from the image header, the pixel rows have to be in the file.
+	src_regular = regular_file(encInfo->fptr_src_image);
+	if (src_regular && (carrier_read(&encInfo->carrier, encInfo->fptr_src_image) == e_failure || carrier_fits(&encInfo->carrier, get_file_size(encInfo->fptr_src_image)) == e_failure))
+	{
+		fprintf(stderr, "ERROR: %s is not an uncompressed 24 or 32 bit BMP, PPM or TGA image\n", encInfo->src_image_fname);
+
+		return e_failure;
 	}
 
 	// Opening Secret file
-	encInfo->fptr_secret = fopen(encInfo->secret_fname, "r"); 
+	encInfo->fptr_secret = open_stdio_file(encInfo->secret_fname, "r", encInfo->stdin_fd);
 
 	// Do Error handling
 	if (encInfo->fptr_secret == NULL)
@@ -151,11 +226,38 @@ Status open_files(EncodeInfo *encInfo)
 	}
 	else
 	{
-		printf("INFO: Opened %s\n", encInfo->secret_fname);
+		encode_info(encInfo, "INFO: Opened %s\n", encInfo->secret_fname);
+	}
+
+	// The size of a secret read from a pipe cannot be looked up.
+	if (!regular_file(encInfo->fptr_secret) && encInfo->secret_part < 0)
+	{
+		fprintf(stderr, "ERROR: %s is not a file, give the secret size with --secret-size\n", encInfo->secret_fname);
+
+		return e_failure;
+	}
+	if (regular_file(encInfo->fptr_secret) && encInfo->secret_part > get_file_size(encInfo->fptr_secret) - encInfo->secret_offset)
+	{
+		fprintf(stderr, "ERROR: %s is shorter than --secret-size\n", encInfo->secret_fname);
+
+		return e_failure;
+	}
+
+	// In place there is no separate stego image, and only a file can be patched.
+	if (encInfo->in_place)
+	{
+		if (!src_regular)
+		{
+			fprintf(stderr, "ERROR: %s cannot be patched in place, it is not a file\n", encInfo->src_image_fname);
+
+			return e_failure;
+		}
+		encode_info(encInfo, "INFO: Done\n");
+		return e_success;
 	}
 
 	// Opening Stego Image file
-	encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");	
+	encInfo->fptr_stego_image = open_stdio_file(encInfo->stego_image_fname, "w+", encInfo->stdout_fd);
 
 	// Do Error handling
 	if (encInfo->fptr_stego_image == NULL)
@@ -167,134 +269,390 @@ Status open_files(EncodeInfo *encInfo)
 	}
 	else
 	{
-		printf("INFO: Opened %s\n", encInfo->stego_image_fname);
+		encode_info(encInfo, "INFO: Opened %s\n", encInfo->stego_image_fname);
 	}
-	printf("INFO: Done\n");
+
+	// The header of an image read from a pipe goes to the stego image as it is read.
+	if (!src_regular && carrier_copy_header(&encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+	{
+		fprintf(stderr, "ERROR: %s is not an uncompressed 24 or 32 bit BMP, PPM or TGA image\n", encInfo->src_image_fname);
+
+		return e_failure;
+	}
+	encode_info(encInfo, "INFO: Done\n");
 	// No failure return e_success
 	return e_success;
 
 }
 
-/* Encoding secret file data to stego image
+/* Close files opened by open_files
+ * Description: Unmaps and closes whatever is still open, safe to call
+ * more than once and after a failed encoding.
+ * Input: Encode File Information
+ * Output: All file pointers are closed and set to NULL
+ * Return: None
+ */
+void close_files(EncodeInfo *encInfo)
+{
+	unmap_files(encInfo);
+	free(encInfo->patch_buffer);
+	encInfo->patch_buffer = NULL;
+	if(encInfo->fptr_src_image != NULL)
+	{
+		fclose(encInfo->fptr_src_image);
+		encInfo->fptr_src_image = NULL;
+	}
+	if(encInfo->fptr_secret != NULL)
+	{
+		fclose(encInfo->fptr_secret);
+		encInfo->fptr_secret = NULL;
+	}
+	if(encInfo->fptr_stego_image != NULL)
+	{
+		fclose(encInfo->fptr_stego_image);
+		encInfo->fptr_stego_image = NULL;
+	}
+}
+
+/* Print an INFO line
+ * Description: printf for the encoding progress, silent when encInfo->quiet is set.
+ * Input: Encode File Information, printf format and arguments
+ * Output: Line printed on stdout unless quiet
+ * Return: None
+ */
+void encode_info(const EncodeInfo *encInfo, const char *format, ...)
+{
+	va_list args;
+
+	if(encInfo->quiet)
+	{
+		return;
+	}
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+/* Report a secret read that came up short
+ * Description: A piped secret can end before its --secret-size bytes,
+ * which is only found out while it is read.
+ * Input: Encode File Information
+ * Output: ERROR line on stderr
+ * Return: None
+ */
+static void secret_read_error(const EncodeInfo *encInfo)
+{
+	if(ferror(encInfo->fptr_secret))
+	{
+		fprintf(stderr, "ERROR: Unable to read file %s\n", encInfo->secret_fname);
+	}
+	else
+	{
+		fprintf(stderr, "ERROR: %s is shorter than --secret-size\n", encInfo->secret_fname);
+	}
+}
+
+/* Encoding stages of do_encoding
  * Input: Encode File Information of source image, secret file and stego image
  * Output: Encodes the secret data to stego image
  * Return: e_success or e_failure
  */
-Status do_encoding(EncodeInfo *encInfo)
+static Status encode_stages(EncodeInfo *encInfo)
 {
-	printf("INFO: Opening required files\n");
+	stats_stage(encInfo->stats, e_stage_open);
+	encode_info(encInfo, "INFO: Opening required files\n");
 
 	//Opening required files.
 	if(open_files(encInfo) == e_success)
 	{
-		printf("INFO: ## Encoding Procedure Started ##\n");
-		printf("INFO: Checking for %s size\n", encInfo->secret_fname);
+		encode_info(encInfo, "INFO: ## Encoding Procedure Started ##\n");
+
+		//Compress first, the capacity check counts the compressed size.
+		if(encInfo->compress)
+		{
+			stats_stage(encInfo->stats, e_stage_compress);
+			if(compress_secret_file(encInfo) == e_failure)
+			{
+				encode_info(encInfo, "INFO: Compressing %s failed.\n", encInfo->secret_fname);
+				return e_failure;
+			}
+		}
+		stats_stage(encInfo->stats, e_stage_capacity);
+		encode_info(encInfo, "INFO: Checking for %s size\n", encInfo->secret_fname);
 
 		//Check the capacity of the source image to handle the secret file data.
 		if(check_capacity(encInfo) == e_success)
 		{
-			printf("INFO: Done. Found OK\n");
+			encode_info(encInfo, "INFO: Done. Found OK\n");
+
+			//Setting up the engine counts as part of the header copy.
+			stats_stage(encInfo->stats, e_stage_header);
+
+			//In place only the carrier bytes that change are read and written.
+			if(encInfo->in_place)
+			{
+				if(prepare_in_place(encInfo) == e_failure)
+				{
+					encode_info(encInfo, "INFO: %s cannot be patched in place\n", encInfo->src_image_fname);
+					return e_failure;
+				}
+				encode_info(encInfo, "INFO: Patching %s in place\n", encInfo->src_image_fname);
+			}
+			//Regular files are encoded straight in memory, anything else goes through stdio.
+			//A - stego image is a stream even when stdout is a regular file, it may be appended to or follow other output.
+			else if(!encInfo->use_stdio && !stdio_file_name(encInfo->stego_image_fname) && map_files(encInfo) == e_success)
+			{
+				encode_info(encInfo, "INFO: Using memory mapped engine\n");
+			}
+			else if(encInfo->pool != NULL)
+			{
+				encode_info(encInfo, "INFO: Images cannot be mapped, encoding on one thread\n");
+			}
+			//Scattered tiles are written out of order, which a stream cannot do.
+			if(encInfo->scatter && encInfo->stego_map == NULL && !encInfo->in_place)
+			{
+				encode_info(encInfo, "INFO: Scattering needs images that can be mapped\n");
+				return e_failure;
+			}
 
 			//Copy bmp image header.
-			printf("INFO: Copying Image Header\n");
-			if(copy_bmp_header(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+			encode_info(encInfo, "INFO: Copying Image Header\n");
+			if((encInfo->stego_map != NULL || encInfo->in_place ? copy_image_header_to_map(encInfo) : copy_image_header(encInfo)) == e_success)
 			{
-				printf("INFO: Done\n");
+				encode_info(encInfo, "INFO: Done\n");
 
 				//Encoding magic string in stego image file.
-				printf("INFO: Encoding Magic String Signature\n");
+				stats_stage(encInfo->stats, e_stage_magic);
+				encode_info(encInfo, "INFO: Encoding Magic String Signature\n");
 
 				if(encode_magic_string(MAGIC_STRING, encInfo) == e_success)
 				{
-					printf("INFO: Done\n");
+					encode_info(encInfo, "INFO: Done\n");
 
 					//Encoding secret file extension size.
-					printf("INFO: Encoding %s File Extension Size\n", encInfo->secret_fname);
+					stats_stage(encInfo->stats, e_stage_extn);
+					encode_info(encInfo, "INFO: Encoding %s File Extension Size\n", encInfo->secret_fname);
 					if(encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo) == e_success)
 					{
-						printf("INFO: Done\n");
+						encode_info(encInfo, "INFO: Done\n");
 
 						//Encoding secret file extension.
-						printf("INFO: Encoding %s File Extension\n", encInfo->secret_fname);
+						encode_info(encInfo, "INFO: Encoding %s File Extension\n", encInfo->secret_fname);
 						if(encode_secret_file_extn(encInfo->extn_secret_file, encInfo) == e_success)
 						{
-							printf("INFO: Done\n");
+							encode_info(encInfo, "INFO: Done\n");
 
 							//Encoding secret file size.
-							printf("INFO: Encoding %s File Size\n", encInfo->secret_fname);
+							stats_stage(encInfo->stats, e_stage_size);
+							encode_info(encInfo, "INFO: Encoding %s File Size\n", encInfo->secret_fname);
 							if(encode_secret_file_size(encInfo->size_secret_file, encInfo) == e_success)
 							{
-								printf("INFO: Done\n");
+								encode_info(encInfo, "INFO: Done\n");
+
+								//Encoding the stripe fields of one stripe of the secret data.
+								if(encInfo->stripe != NULL)
+								{
+									encode_info(encInfo, "INFO: Encoding %s Stripe %u of %u\n", encInfo->secret_fname, encInfo->stripe->index + 1, encInfo->stripe->count);
+									if(encode_secret_file_stripe(encInfo) == e_failure)
+									{
+										encode_info(encInfo, "INFO: Encoding secret file stripe failed.\n");
+										return e_failure;
+									}
+									encode_info(encInfo, "INFO: Done\n");
+								}
+
+								//Encoding the nonce of the encrypted secret data.
+								if(encInfo->key != NULL)
+								{
+									encode_info(encInfo, "INFO: Encoding %s Nonce\n", encInfo->secret_fname);
+									if(encode_secret_file_nonce(encInfo) == e_failure)
+									{
+										encode_info(encInfo, "INFO: Encoding secret file nonce failed.\n");
+										return e_failure;
+									}
+									encode_info(encInfo, "INFO: Done\n");
+								}
 
 								//Encoding secret file data.
-								printf("INFO: Encoding %s File Data\n", encInfo->secret_fname);
+								stats_stage(encInfo->stats, e_stage_payload);
+								encode_info(encInfo, "INFO: Encoding %s File Data\n", encInfo->secret_fname);
 								if(encode_secret_file_data(encInfo) == e_success)
 								{
-									printf("INFO: Done\n");
+									encode_info(encInfo, "INFO: Done\n");
+
+									//Encoding the CRC32C of the secret data.
+									if(encInfo->crc)
+									{
+										encode_info(encInfo, "INFO: Encoding %s CRC32C\n", encInfo->secret_fname);
+										if(encode_secret_file_crc(encInfo) == e_failure)
+										{
+											encode_info(encInfo, "INFO: Encoding secret file CRC32C failed.\n");
+											return e_failure;
+										}
+										encode_info(encInfo, "INFO: Done\n");
+									}
 
 									//Copy the remaining data.
-									printf("INFO: Copying Left Over Data\n");
-									if(copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+									stats_stage(encInfo->stats, e_stage_tail);
+									encode_info(encInfo, "INFO: Copying Left Over Data\n");
+									if((encInfo->stego_map != NULL || encInfo->in_place ? copy_remaining_img_data_to_map(encInfo) : copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image)) == e_success)
 									{
-										fclose(encInfo->fptr_src_image);
-										fclose(encInfo->fptr_stego_image);
-										fclose(encInfo->fptr_secret);
+										close_files(encInfo);
 										return e_success;
 									}
 									else
 									{
-										printf("INFO: Copying remaining data failed.\n");
+										encode_info(encInfo, "INFO: Copying remaining data failed.\n");
 										return e_failure;
 									}
 								}
 								else
 								{
-									printf("INFO: Encoding secret file data failed.\n");
+									encode_info(encInfo, "INFO: Encoding secret file data failed.\n");
 									return e_failure;
 								}
 							}
 							else
 							{
-								printf("INFO: Encoding secret file size failed.\n");
+								encode_info(encInfo, "INFO: Encoding secret file size failed.\n");
 								return e_failure;
 							}
 						}
 						else
 						{
-							printf("INFO: Encoding secret file extn failed.\n");
+							encode_info(encInfo, "INFO: Encoding secret file extn failed.\n");
 							return e_failure;
 						}
 					}
 					else
 					{
-						printf("INFO: Encoding secret file extension size failed.\n");
+						encode_info(encInfo, "INFO: Encoding secret file extension size failed.\n");
 						return e_failure;
 					}
 
 				}
 				else
 				{
-					printf("INFO: Encoding Magic String Failed.\n");
+					encode_info(encInfo, "INFO: Encoding Magic String Failed.\n");
 					return e_failure;
 				}
 			}
 			else
 			{
-				printf("INFO: Bmp header not copied to output file");
+				encode_info(encInfo, "INFO: Bmp header not copied to output file");
 				return e_failure;
 			}
 		}
 		else
 		{
-			printf("ERROR: File capacity exceeded. Cannot encode %s file data into %s file\n", encInfo->secret_fname, encInfo->src_image_fname);
+			fprintf(stderr, "ERROR: File capacity exceeded. Cannot encode %s file data into %s file\n", encInfo->secret_fname, encInfo->src_image_fname);
 			return e_failure;
 		}
 	}
 	else
 	{
+		fprintf(stderr, "ERROR: Cannot open the files\n");
+		return e_failure;
+	}
+}
+
+/* Encoding secret file data to stego image
+ * Description: Runs the encoding stages. A stego image left behind by a
+ * failed stage would claim the whole secret and decode to carrier noise,
+ * so a named regular stego image is closed and removed. In place the
+ * carrier itself is the stego image and stays.
+ * Input: Encode File Information of source image, secret file and stego image
+ * Output: Encodes the secret data to stego image
+ * Return: e_success or e_failure
+ */
+Status do_encoding(EncodeInfo *encInfo)
+{
+	if(encode_stages(encInfo) == e_success)
+	{
+		return e_success;
+	}
+	if(!encInfo->in_place && encInfo->fptr_stego_image != NULL && !stdio_file_name(encInfo->stego_image_fname) && regular_file(encInfo->fptr_stego_image))
+	{
+		close_files(encInfo);
+		unlink(encInfo->stego_image_fname);
+		fprintf(stderr, "ERROR: Encoding failed, incomplete %s removed\n", encInfo->stego_image_fname);
+	}
+	return e_failure;
+}
+
+/* Compress the secret file
+ * Description: Frames the secret file block by block into an anonymous
+ * temporary file, which then stands in for the secret file, so the later
+ * stages read the compressed bytes like any other secret. Secrets that do
+ * not shrink are stored as they are, unless they come from a pipe and cannot
+ * be read again. Only the secret_part bytes from
+ * secret_offset on are compressed when one stripe is encoded.
+ * Input: Encode Info with the opened secret file
+ * Output: fptr_secret replaced by the compressed frames, or compress cleared
+ * Return: e_success or e_failure
+ */
+Status compress_secret_file(EncodeInfo *encInfo)
+{
+	char *block = malloc(LZ_BLOCK_SIZE + LZ_FRAME_BOUND);
+	FILE *fptr_frames = tmpfile();
+	long size = encInfo->secret_part >= 0 ? encInfo->secret_part : get_file_size(encInfo->fptr_secret);
+	long frames_size, remaining = size;
+	size_t nread;
+
+	encode_info(encInfo, "INFO: Compressing %s\n", encInfo->secret_fname);
+	if(block == NULL || fptr_frames == NULL)
+	{
+		free(block);
+		if(fptr_frames != NULL)
+		{
+			fclose(fptr_frames);
+		}
+		return e_failure;
+	}
+
+	fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+
+	//One frame per block of secret data.
+	while(remaining > 0 && (nread = fread(block, 1, remaining < LZ_BLOCK_SIZE ? remaining : LZ_BLOCK_SIZE, encInfo->fptr_secret)) > 0)
+	{
+		size_t frame_size = lz_frame_block(block + LZ_BLOCK_SIZE, block, nread);
+
+		if(fwrite(block + LZ_BLOCK_SIZE, 1, frame_size, fptr_frames) != frame_size)
+		{
+			free(block);
+			fclose(fptr_frames);
+			return e_failure;
+		}
+		remaining -= nread;
+	}
+	free(block);
+	if(remaining > 0 || ferror(encInfo->fptr_secret))
+	{
+		secret_read_error(encInfo);
+	}
+	if(remaining > 0 || ferror(encInfo->fptr_secret) || fflush(fptr_frames) != 0)
+	{
+		fclose(fptr_frames);
 		return e_failure;
-		printf("ERROR : Cannot open the files\n");
 	}
+
+	//A secret read from a pipe cannot be read again, it keeps its frames.
+	frames_size = get_file_size(fptr_frames);
+	if(frames_size >= size && regular_file(encInfo->fptr_secret))
+	{
+		encode_info(encInfo, "INFO: %s does not compress, storing it as is\n", encInfo->secret_fname);
+		fclose(fptr_frames);
+		fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+		encInfo->compress = 0;
+		return e_success;
+	}
+
+	encode_info(encInfo, "INFO: Compressed %ld bytes to %ld bytes\n", size, frames_size);
+	fclose(encInfo->fptr_secret);
+	encInfo->fptr_secret = fptr_frames;
+	encInfo->secret_offset = 0;
+	encInfo->secret_part = -1;
+	return e_success;
 }
 
 /* Check the capacity of source image file to encode secret data
@@ -305,56 +663,95 @@ Status do_encoding(EncodeInfo *encInfo)
 
 Status check_capacity(EncodeInfo *encInfo)
 {
-	//Get the secret file size.		
-	encInfo->size_secret_file = get_file_size(encInfo->fptr_secret);
+	//Fields the format flags add around the secret data.
+	uint flags = (encInfo->crc ? CRC_FLAG : 0) | (encInfo->key != NULL ? ENCRYPTED_FLAG : 0) | (encInfo->scatter ? SCATTER_FLAG : 0) | (encInfo->stripe != NULL ? STRIPED_FLAG : 0);
 
-	//Get the size of image file.
-	encInfo->image_capacity = get_image_size_for_bmp(encInfo->fptr_src_image);
+	//Get the secret file size, or the size of the stripe of it.
+	encInfo->size_secret_file = encInfo->secret_part >= 0 ? encInfo->secret_part : get_file_size(encInfo->fptr_secret);
+
+	//Secrets of 4 GB and more take 64 bit size fields.
+	flags |= stego_large_flag(encInfo->size_secret_file, encInfo->stripe);
+	encInfo->large = (flags & LARGE_FLAG) != 0;
+
+	//Get the carrier bytes of the image file.
+	encInfo->image_capacity = carrier_size(&encInfo->carrier);
 
 	//Check if the size of secret file is non empty.
-	if (encInfo->size_secret_file)
+	if (encInfo->size_secret_file > 0)
 	{
-		printf("INFO: Done. Not Empty\n");
-		printf("INFO: Checking for %s capacity to handle %s\n", encInfo->src_image_fname, encInfo->secret_fname);
+		encode_info(encInfo, "INFO: Done. Not Empty\n");
+		encode_info(encInfo, "INFO: Checking for %s capacity to handle %s\n", encInfo->src_image_fname, encInfo->secret_fname);
 
-		//Image capacity >= 8 * (magic sring size + 4 + secret file extension size + 4 + secret file size)+ 54
-		if (encInfo->image_capacity >= (54 + MAX_IMAGE_BUF_SIZE * (strlen(MAGIC_STRING) + 4 + strlen(encInfo->extn_secret_file) + 4 + encInfo->size_secret_file)))
+		//Auto depth: the fewest payload bits per carrier byte that still fit.
+		if (encInfo->depth == 0)
+		{
+			encInfo->depth = stego_fit_depth(encInfo->image_capacity, encInfo->extn_secret_file, encInfo->size_secret_file, flags);
+			if (encInfo->depth == 0)
+			{
+				fprintf(stderr, "ERROR: Cannot hold %s in %s at any depth 1 to 4\n", encInfo->secret_fname, encInfo->src_image_fname);
+				return e_failure;
+			}
+			encode_info(encInfo, "INFO: Using %d bit(s) per carrier byte\n", encInfo->depth);
+		}
+
+		//Image capacity >= 8 * (magic sring size + 4 + secret file extension size + 4) + 8 / depth * secret file size (whole tiles when scattered) (+ 96 for a nonce, + 32 for a CRC32C)
+		if (encInfo->image_capacity >= stego_required_size(encInfo->extn_secret_file, encInfo->size_secret_file, encInfo->depth, flags))
 		{
 			return e_success;
 		}
 		else
 		{
-			printf("INFO: Cannot hold secret file in image file.");
+			encode_info(encInfo, "INFO: Cannot hold secret file in image file.\n");
 			return e_failure;
 		}
 	}
 	else
 	{
 		//If secret file is empty print error message.
-		printf("INFO: Secret file is empty.\n");
+		encode_info(encInfo, "INFO: Secret file is empty.\n");
 		return e_failure;
 	}
 }
 
-/* Copy the bmp image header.
- * Description: Copy the first 54 bytes of header from source bmp image file to stego image file.
- * Input: FILE pointers source and stego image
+/* Copy the image header.
+ * Description: Copy everything before the first pixel row (the header and
+ * anything up to the pixel offset) from source image file to stego image file.
+ * open_files already copied the header of an image read from a pipe, a stego
+ * image written to a pipe or to - gets the header at its current position.
+ * Input: Encode Info with the source image layout
  * Output: Copies header data of source image to stego image
  * Return: e_success or e_failure
  */
 
-Status copy_bmp_header(FILE * fptr_src_image, FILE *fptr_dest_image)
+Status copy_image_header(EncodeInfo *encInfo)
 {
-	char bmp_header_data[54];
+	FILE *fptr_src_image = encInfo->fptr_src_image, *fptr_dest_image = encInfo->fptr_stego_image;
+	long header_size = encInfo->carrier.data_offset;
+	off_t src_offset = 0, dest_offset = 0;
+	int dest_regular = !stdio_file_name(encInfo->stego_image_fname) && regular_file(fptr_dest_image);
 
-	//Move the file pointer of image file to the starting position.
-	rewind(fptr_src_image);
-	//Read 54 bytes from source image bmp file and store it in a bmp header data.
-	fread(bmp_header_data, 54, 1, fptr_src_image);
-	//Write 54 bytes from bmp header data to stego image file.
-	fwrite(bmp_header_data, 54, 1, fptr_dest_image);
-	//Validating the bmp header is copied in stego image file or not.
-	if(ftell(fptr_dest_image) == 54)
+	//Encoding starts at carrier byte 0.
+	encInfo->carrier_pos = 0;
+	if(!regular_file(fptr_src_image))
+	{
+		return e_success;
+	}
+	//Flush pending stego bytes, the header is copied kernel side.
+	fflush(fptr_dest_image);
+	//Copy the header from the start of source image file to the start of stego image file.
+	if(copy_file_data(fileno(fptr_src_image), &src_offset, fileno(fptr_dest_image), dest_regular ? &dest_offset : NULL, header_size) == e_failure)
+	{
+		return e_failure;
+	}
+	//Move both file pointers past the header.
+	fseek(fptr_src_image, header_size, SEEK_SET);
+	if(!dest_regular)
+	{
+		return e_success;
+	}
+	fseek(fptr_dest_image, header_size, SEEK_SET);
+	//Validating the header is copied in stego image file or not.
+	if(ftell(fptr_dest_image) == header_size)
 	{
 		//If yes return e_success.
 		return e_success;
@@ -374,7 +771,15 @@ Status copy_bmp_header(FILE * fptr_src_image, FILE *fptr_dest_image)
 Status encode_magic_string (char *magic_string, EncodeInfo *encInfo)
 {
 	//Encode the data to output image.
-	if(encode_data_to_image(magic_string, strlen(magic_string), encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+	if(encInfo->in_place)
+	{
+		return encode_data_in_place(magic_string, strlen(magic_string), 1, encInfo);
+	}
+	if(encInfo->stego_map != NULL)
+	{
+		return encode_data_to_map(magic_string, strlen(magic_string), 1, encInfo);
+	}
+	if(encode_data_to_image(magic_string, strlen(magic_string), 1, encInfo) == e_success)
 	{
 		return e_success;
 	}
@@ -385,21 +790,28 @@ Status encode_magic_string (char *magic_string, EncodeInfo *encInfo)
 }
 
 /* Encoding the secret file extenstion size to stego image file.
+ * Description: The payload depth is stored in the format flags above
+ * the extension size, see common.h.
  * Input: secret file extension size, file information.
  * Output: Encode file extenstion size to stego image.
  * Return: e_success or e_failure
  */
 Status encode_secret_file_extn_size(int extn_size, EncodeInfo *encInfo)
 {
+	StegoHeader format;
+	int field;
+
+	format.depth = encInfo->depth;
+	format.compressed = encInfo->compress;
+	format.crc = encInfo->crc;
+	format.encrypted = encInfo->key != NULL;
+	format.scatter = encInfo->scatter;
+	format.striped = encInfo->stripe != NULL;
+	format.large = encInfo->large;
+	field = stego_extn_field(extn_size, &format);
+
 	//Encode secret file extension size to lsb of bytes in stego image.
-	if(encode_size_to_lsb(extn_size, encInfo -> fptr_src_image ,encInfo -> fptr_stego_image) == e_success)
-	{
-		return e_success;
-	}
-	else
-	{
-		return e_failure;
-	}
+	return encode_size_field(field, encInfo);
 }
 
 /* Encoding file extenstion to stego image file.
@@ -410,7 +822,15 @@ Status encode_secret_file_extn_size(int extn_size, EncodeInfo *encInfo)
 Status encode_secret_file_extn(const char *extn_secret_file, EncodeInfo *encInfo)
 {
 	//Encode secret file extension(data) to image.
-	if(encode_data_to_image(extn_secret_file, strlen(extn_secret_file), encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+	if(encInfo->in_place)
+	{
+		return encode_data_in_place(extn_secret_file, strlen(extn_secret_file), 1, encInfo);
+	}
+	if(encInfo->stego_map != NULL)
+	{
+		return encode_data_to_map(extn_secret_file, strlen(extn_secret_file), 1, encInfo);
+	}
+	if(encode_data_to_image(extn_secret_file, strlen(extn_secret_file), 1, encInfo) == e_success)
 	{
 		return e_success;
 	}
@@ -421,14 +841,37 @@ Status encode_secret_file_extn(const char *extn_secret_file, EncodeInfo *encInfo
 }
 
 /* Encoding secret file size data to stego image file.
+ * Description: A large secret (LARGE_FLAG) takes two 32 bit fields, the
+ * high half first.
  * Input: secret file size and file information.
  * Output: Encode secret file size to stego image file.
  * Return: e_success or e_failure
  */
-Status encode_secret_file_size(int file_size, EncodeInfo *encInfo)
+Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
 {
-	//Encode secret file size to stego image file.
-	if(encode_size_to_lsb(file_size, encInfo -> fptr_src_image ,encInfo -> fptr_stego_image) == e_success)
+	if(encInfo->large && encode_size_field((uint)((unsigned long)file_size >> 32), encInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	return encode_size_field((uint)file_size, encInfo);
+}
+
+/* Encoding a 32 bit field to stego image file.
+ * Input: Field and file information.
+ * Output: Encode the field to the lsb of 32 carrier bytes of the stego image.
+ * Return: e_success or e_failure
+ */
+Status encode_size_field(uint field, EncodeInfo *encInfo)
+{
+	if(encInfo->in_place)
+	{
+		return encode_size_in_place(field, encInfo);
+	}
+	if(encInfo->stego_map != NULL)
+	{
+		return encode_size_to_map(field, encInfo);
+	}
+	if(encode_size_to_lsb(field, encInfo) == e_success)
 	{
 		return e_success;
 	}
@@ -438,48 +881,306 @@ Status encode_secret_file_size(int file_size, EncodeInfo *encInfo)
 	}
 }
 
+/* Encoding the stripe fields
+ * Description: Id, index and count of the stripe, then offset and size
+ * of the whole secret data as wide as the secret file size, see stego.h.
+ * Input: Encode Info with a stripe
+ * Output: Encode the stripe fields to stego image file.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_stripe(EncodeInfo *encInfo)
+{
+	const StegoStripe *stripe = encInfo->stripe;
+	uint fields[3] = { stripe->id, stripe->index, stripe->count };
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(encode_size_field(fields[i], encInfo) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	if(encode_secret_file_size(stripe->offset, encInfo) == e_failure)
+	{
+		return e_failure;
+	}
+	return encode_secret_file_size(stripe->total, encInfo);
+}
+
+/* Pipeline state of a secret being encoded */
+typedef struct _EncodePipeline
+{
+	EncodeInfo *encInfo;
+	long remaining;							//Secret bytes left to read.
+	long embedded;							//Secret bytes embedded, keystream offset of the next chunk.
+	size_t pos;								//Carrier byte of the next chunk read.
+} EncodePipeline;
+
+/* Pipeline reader: next secret chunk and the carrier bytes it goes to */
+static Status encode_read_chunk(void *arg, PipelineSlot *slot)
+{
+	EncodePipeline *pipeline = arg;
+	EncodeInfo *encInfo = pipeline->encInfo;
+	size_t carrier;
+
+	slot->size = pipeline->remaining < SECRET_CHUNK_SIZE ? pipeline->remaining : SECRET_CHUNK_SIZE;
+	carrier = lsb_carrier_bytes(slot->size, encInfo->depth);
+	slot->image_size = carrier_span(&encInfo->carrier, pipeline->pos, carrier);
+	if(fread(slot->data, 1, slot->size, encInfo->fptr_secret) != slot->size)
+	{
+		secret_read_error(encInfo);
+		return e_failure;
+	}
+	if(fread(slot->image, 1, slot->image_size, encInfo->fptr_src_image) != slot->image_size)
+	{
+		return e_failure;
+	}
+	pipeline->remaining -= slot->size;
+	pipeline->pos += carrier;
+	return e_success;
+}
+
+/* Pipeline processor: embed the chunk into its carrier bytes */
+static Status encode_embed_chunk(void *arg, PipelineSlot *slot)
+{
+	EncodePipeline *pipeline = arg;
+	EncodeInfo *encInfo = pipeline->encInfo;
+
+	//Chunks come through in order, encryption and the CRC32C run on the data while it is in cache.
+	if(encInfo->key != NULL)
+	{
+		chacha20_xor(encInfo->key, encInfo->nonce, pipeline->embedded, slot->data, slot->size);
+	}
+	if(encInfo->crc)
+	{
+		encInfo->payload_crc = crc32c(encInfo->payload_crc, slot->data, slot->size);
+	}
+	stego_embed_bytes(&encInfo->carrier, slot->image, slot->image, encInfo->carrier_pos + lsb_carrier_bytes(pipeline->embedded, encInfo->depth), slot->data, slot->size, encInfo->depth);
+	pipeline->embedded += slot->size;
+	return e_success;
+}
+
+/* Pipeline writer: write the embedded carrier bytes */
+static Status encode_write_chunk(void *arg, PipelineSlot *slot)
+{
+	EncodePipeline *pipeline = arg;
+
+	return fwrite(slot->image, 1, slot->image_size, pipeline->encInfo->fptr_stego_image) == slot->image_size ? e_success : e_failure;
+}
+
+/* Encoding secret file data through the pipeline
+ * Description: Reading the secret and carrier, embedding, and writing the
+ * stego image run on three threads over a ring of chunk buffers, so on
+ * the stdio path disk and CPU work overlap.
+ * Input: Encode Info of opened files positioned at the secret data
+ * Output: Encode secret data to stego image file.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_data_pipelined(EncodeInfo *encInfo)
+{
+	EncodePipeline pipeline;
+	Status status;
+
+	pipeline.encInfo = encInfo;
+	pipeline.remaining = encInfo->size_secret_file;
+	pipeline.embedded = 0;
+	pipeline.pos = encInfo->carrier_pos;
+	fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+
+	status = pipeline_run(encode_read_chunk, encode_embed_chunk, encode_write_chunk, &pipeline, SECRET_CHUNK_SIZE);
+	encInfo->carrier_pos = pipeline.pos;
+
+	return status;
+}
+
+/* Encoding secret file data one chunk at a time
+ * Description: The secret file is streamed through the fixed size secret_data
+ * buffer, one chunk at a time, so memory use does not grow with its size.
+ * Input: Source and destination file information.
+ * Output: Encode secret data to stego image file.
+ * Return: e_success or e_failure
+ */
+static Status encode_secret_file_chunks(EncodeInfo *encInfo)
+{
+	long remaining = encInfo->size_secret_file;
+
+	//Seek fptr_secret to the start of the secret data.
+	fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+	while(remaining > 0)
+	{
+		int chunk = remaining < SECRET_CHUNK_SIZE ? remaining : SECRET_CHUNK_SIZE;
+		Status status;
+
+		//Read the next chunk from fptr_secret, store into secret_data(arr)
+		if(fread(encInfo->secret_data, 1, chunk, encInfo->fptr_secret) != (size_t)chunk)
+		{
+			secret_read_error(encInfo);
+			return e_failure;
+		}
+		//Encryption and the CRC32C work on the chunk just read.
+		if(encInfo->key != NULL)
+		{
+			chacha20_xor(encInfo->key, encInfo->nonce, encInfo->size_secret_file - remaining, encInfo->secret_data, chunk);
+		}
+		if(encInfo->crc)
+		{
+			encInfo->payload_crc = crc32c(encInfo->payload_crc, encInfo->secret_data, chunk);
+		}
+		//Encode the chunk to stego image file.
+		if(encInfo->scatter)
+		{
+			long pos = lsb_carrier_bytes(encInfo->size_secret_file - remaining, encInfo->depth);
+
+			status = encInfo->in_place ? encode_data_in_place_tiles(encInfo->secret_data, chunk, pos, encInfo) : encode_data_to_map_tiles(encInfo->secret_data, chunk, pos, encInfo);
+		}
+		else if(encInfo->in_place)
+		{
+			status = encode_data_in_place(encInfo->secret_data, chunk, encInfo->depth, encInfo);
+		}
+		else if(encInfo->stego_map != NULL)
+		{
+			status = encode_data_to_map(encInfo->secret_data, chunk, encInfo->depth, encInfo);
+		}
+		else
+		{
+			status = encode_data_to_image(encInfo->secret_data, chunk, encInfo->depth, encInfo);
+		}
+		if(status == e_failure)
+		{
+			return e_failure;
+		}
+		remaining -= chunk;
+	}
+	return e_success;
+}
+
 /* Encoding secret file data to stego image file.
+ * Description: Picks the engine for the secret data, see encode_secret_file_chunks.
  * Input: Source and destination file information.
  * Output: Encode secret data to stego image file.
  * Return: e_success or e_failure
  */
 Status encode_secret_file_data(EncodeInfo *encInfo)
 {
-	char secret_data[encInfo->size_secret_file];
+	encInfo->payload_crc = 0;
+	//Scattered secrets go to keyed tiles of the image.
+	if(encInfo->scatter)
+	{
+		return encode_secret_file_data_scattered(encInfo);
+	}
+	//Large secrets are split across the worker pool when the images are mapped, the slices pread the secret so it has to be a file.
+	if(encInfo->pool != NULL && encInfo->stego_map != NULL && encInfo->size_secret_file >= PARALLEL_MIN_SIZE && regular_file(encInfo->fptr_secret))
+	{
+		return encode_secret_file_data_parallel(encInfo);
+	}
+	//Large carriers through stdio overlap reads, embedding and writes.
+	if(encInfo->stego_map == NULL && !encInfo->in_place && lsb_carrier_bytes(encInfo->size_secret_file, encInfo->depth) >= PIPELINE_MIN_SIZE)
+	{
+		return encode_secret_file_data_pipelined(encInfo);
+	}
+	return encode_secret_file_chunks(encInfo);
+}
+
+/* Encoding scattered secret file data
+ * Description: The region is every whole tile from the encode position to
+ * the CRC32C (if any) at the end of the image. The key and nonce pick the
+ * tiles the secret data goes to, the mapped or in place engine embeds
+ * into them, and the CRC32C goes right after the last whole tile.
+ * Input: Encode Info with a key, its nonce encoded, mapped or opened in place
+ * Output: Encode secret data to the tiles of the stego image.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_data_scattered(EncodeInfo *encInfo)
+{
+	long region_start = encInfo->carrier_pos;
+	size_t region = stego_scatter_region(encInfo->image_capacity, region_start, encInfo->crc);
+	Status status;
 
-	//Rewind fptr_secret to start.
-	rewind(encInfo->fptr_secret);
-	//Read secret_file_size data from fptr_secret, store into secret_data(arr)
-	fread(secret_data, encInfo->size_secret_file, 1, encInfo->fptr_secret);
-	//Encode secret file data to stego image file.
-	if(encode_data_to_image(secret_data, encInfo->size_secret_file, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+	if(scatter_init(&encInfo->scatter_map, encInfo->key, encInfo->nonce, &encInfo->carrier, region_start, region, lsb_carrier_bytes(encInfo->size_secret_file, encInfo->depth)) == e_failure)
 	{
-		return e_success;
+		return e_failure;
+	}
+	//Large secrets are split across the worker pool when the images are mapped, the slices pread the secret so it has to be a file.
+	if(encInfo->pool != NULL && encInfo->stego_map != NULL && encInfo->size_secret_file >= PARALLEL_MIN_SIZE && regular_file(encInfo->fptr_secret))
+	{
+		status = encode_secret_file_data_parallel(encInfo);
 	}
 	else
+	{
+		status = encode_secret_file_chunks(encInfo);
+	}
+	scatter_free(&encInfo->scatter_map);
+	encInfo->carrier_pos = region_start + region;
+
+	return status;
+}
+
+/* Encoding the nonce of the encrypted secret data
+ * Description: A fresh random nonce for every image, so no keystream is
+ * ever used twice with the same key.
+ * Input: Encode Info with a key
+ * Output: nonce is set and encoded to stego image file.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_nonce(EncodeInfo *encInfo)
+{
+	const char *nonce = (const char *)encInfo->nonce;
+
+	if(getrandom(encInfo->nonce, CHACHA20_NONCE_SIZE, 0) != CHACHA20_NONCE_SIZE)
 	{
 		return e_failure;
 	}
+	if(encInfo->in_place)
+	{
+		return encode_data_in_place(nonce, CHACHA20_NONCE_SIZE, 1, encInfo);
+	}
+	if(encInfo->stego_map != NULL)
+	{
+		return encode_data_to_map(nonce, CHACHA20_NONCE_SIZE, 1, encInfo);
+	}
+	return encode_data_to_image(nonce, CHACHA20_NONCE_SIZE, 1, encInfo);
+}
+
+/* Encoding the CRC32C of the secret data
+ * Description: Stored after the secret data like a size field.
+ * Input: Encode Info with payload_crc of the secret data just encoded
+ * Output: Encode the CRC32C to stego image file.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_crc(EncodeInfo *encInfo)
+{
+	return encode_size_field(encInfo->payload_crc, encInfo);
 }
 
 /* Encode data to image data
- * Description: Encoding characters to image file.
- * Input: data, data size, File pointer of source and stego image files
- * Output: Encode data to stego image file.
+ * Description: Encoding characters to image file, ENCODE_BLOCK_SIZE characters per read and write.
+ * Input: data, data size, bits per carrier byte, Encode Info with files positioned at carrier_pos
+ * Output: Encode data to stego image file, carrier_pos moves past it.
  * Return: e_success or e_failure
  */
-Status encode_data_to_image(const char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_data_to_image(const char *data, int size, int depth, EncodeInfo *encInfo)
 {
-	char image_buffer[8];
-	//Loop until the size of data.
-	for(int i = 0; i < size; i++)
+	char image_buffer[CARRIER_SPAN_MAX(ENCODE_BLOCK_SIZE * 8)];
+	//Loop until the size of data, one block at a time.
+	for(int i = 0; i < size; i += ENCODE_BLOCK_SIZE)
 	{
-		//Read 8byte of data, Store into buffer.
-		fread(image_buffer, 8, 1, fptr_src_image);
-		//Call the encode_byte_to_lsb(data[0],image_buffer).
-		encode_byte_to_lsb(data[i], image_buffer);
-		//Write 8byte of encoded buffer data into stego_image.
-		fwrite(image_buffer, 8, 1, fptr_stego_image);
+		int block = size - i < ENCODE_BLOCK_SIZE ? size - i : ENCODE_BLOCK_SIZE;
+		size_t carrier = lsb_carrier_bytes(block, depth);
+		size_t span = carrier_span(&encInfo->carrier, encInfo->carrier_pos, carrier);
+
+		//Read 8 / depth carrier bytes per data byte (and the row padding between them), Store into buffer.
+		if(fread(image_buffer, 1, span, encInfo->fptr_src_image) != span)
+		{
+			return e_failure;
+		}
+		//Embed the whole block into the low bits of the buffer.
+		stego_embed_bytes(&encInfo->carrier, image_buffer, image_buffer, encInfo->carrier_pos, data + i, block, depth);
+		//Write the encoded buffer data into stego_image.
+		if(fwrite(image_buffer, 1, span, encInfo->fptr_stego_image) != span)
+		{
+			return e_failure;
+		}
+		encInfo->carrier_pos += carrier;
 	}
 	return e_success;
 }
@@ -504,25 +1205,28 @@ Status encode_byte_to_lsb(char data, char *image_buffer)
 
 /* Encoding size to lsb.
  * Description: Encode the size to the lsb of each byte of stego image file.
- * Input: Size, image buffer data.
- * Output: Encoding the size to lsb of image data.
- * Return Value: e_success on file errors
+ * Input: Size, Encode Info with files positioned at carrier_pos
+ * Output: Encoding the size to lsb of image data, carrier_pos moves past it.
+ * Return: e_success or e_failure
  */
-Status encode_size_to_lsb(int size, FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_size_to_lsb(int size, EncodeInfo *encInfo)
 {
-	char buffer[32];
-	//Read 32 bytes of data from src image to buffer.
-	fread(buffer, 32, 1, fptr_src_image);
-	//encode_size_to_lsb(extn_size,buffer);
-	for(int i = 0; i < 32; i++)
+	char buffer[CARRIER_SPAN_MAX(32)];
+	size_t span = carrier_span(&encInfo->carrier, encInfo->carrier_pos, 32);
+
+	//Read 32 carrier bytes of data from src image to buffer.
+	if(fread(buffer, 1, span, encInfo->fptr_src_image) != span)
 	{
-		/*Get a bit from the size (start from MSB bit).
-		  Clear the LSB from buffer.
-		  Replace the LSB to bit from size.*/
-		buffer[i] = (buffer[i] & (~1)) | ((size >> (31 - i)) & 1);
+		return e_failure;
+	}
+	//Replace the LSB of the 32 carrier bytes with the size, MSB first.
+	stego_embed_size(&encInfo->carrier, buffer, buffer, encInfo->carrier_pos, size);
+	//Write them in stego_image
+	if(fwrite(buffer, 1, span, encInfo->fptr_stego_image) != span)
+	{
+		return e_failure;
 	}
-	//Write 32 bytes in stego_image
-	fwrite(buffer, 32, 1, fptr_stego_image);
+	encInfo->carrier_pos += 32;
 
 	return e_success;
 }
@@ -534,13 +1238,54 @@ Status encode_size_to_lsb(int size, FILE *fptr_src_image, FILE *fptr_stego_image
  */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
 {
-	char ch;
+	struct stat src_stat;
+	long src_pos = ftell(fptr_src);
+	long dest_pos;
+	char *buffer;
+	size_t nread;
+
+	//Flush pending stego bytes so the tail lands right after them.
+	if(fflush(fptr_dest) != 0)
+	{
+		return e_failure;
+	}
+	dest_pos = ftell(fptr_dest);
 
-	//Read 1 byte from source image file to ch until there is no character to read.
-	while(fread(&ch, 1, 1, fptr_src) > 0)
+	//Seekable source: copy the untouched tail kernel side.
+	if(src_pos >= 0 && dest_pos >= 0 && fstat(fileno(fptr_src), &src_stat) == 0 && S_ISREG(src_stat.st_mode) && src_stat.st_size >= src_pos)
 	{
-		//Write the 1 byte from ch to stego image or destination.
-		fwrite(&ch, 1, 1, fptr_dest);
+		off_t src_offset = src_pos, dest_offset = dest_pos;
+
+		if(copy_file_data(fileno(fptr_src), &src_offset, fileno(fptr_dest), &dest_offset, src_stat.st_size - src_pos) == e_failure)
+		{
+			return e_failure;
+		}
+		//Keep the stdio positions in step with the descriptors.
+		fseek(fptr_src, src_offset, SEEK_SET);
+		fseek(fptr_dest, dest_offset, SEEK_SET);
+		return e_success;
+	}
+
+	//Otherwise read large blocks from source image file until there is no data to read.
+	buffer = malloc(COPY_BUF_SIZE);
+	if(buffer == NULL)
+	{
+		return e_failure;
+	}
+	while((nread = fread(buffer, 1, COPY_BUF_SIZE, fptr_src)) > 0)
+	{
+		//Write the block to stego image or destination.
+		if(fwrite(buffer, 1, nread, fptr_dest) != nread)
+		{
+			free(buffer);
+			return e_failure;
+		}
+	}
+	free(buffer);
+	//A write error of the last buffered bytes only shows when they are flushed.
+	if(ferror(fptr_src) || fflush(fptr_dest) != 0)
+	{
+		return e_failure;
 	}
 	return e_success;
 }
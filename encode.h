@@ -2,6 +2,12 @@
 #define ENCODE_H
 
 #include "types.h" // Contains user defined types
+#include "thread_pool.h"
+#include "stats.h"
+#include "chacha20.h"
+#include "carrier.h"
+#include "scatter.h"
+#include "stego.h"
 
 /* 
  * Structure to store information required for
@@ -13,13 +19,17 @@
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
 #define MAX_FILE_SUFFIX 4
+#define ENCODE_BLOCK_SIZE 480				//Multiple of LSB_DEPTH_ALIGN.
+#define SECRET_CHUNK_SIZE (60 * 1024)		//Multiple of LSB_DEPTH_ALIGN.
+#define PARALLEL_MIN_SIZE (256 * 1024)
 
 typedef struct _EncodeInfo
 {
     /* Source Image info */
     char *src_image_fname;					//Source image file name;
     FILE *fptr_src_image;					//File pointer for source image.
-    uint image_capacity;					//Size of source image bmp file.
+    size_t image_capacity;					//Carrier bytes of the source image.
+    Carrier carrier;						//Pixel layout of the source image.
     uint bits_per_pixel;
     char image_data[MAX_IMAGE_BUF_SIZE];
 
@@ -27,13 +37,43 @@ typedef struct _EncodeInfo
     char *secret_fname;						//Secret file name.
     FILE *fptr_secret;						//File pointer for secret file.
     char extn_secret_file[MAX_FILE_SUFFIX + 1];	//Extension of secret file.
-    //char secret_data[MAX_SECRET_BUF_SIZE];
-    int size_secret_file;					//Size of secret file.
+    char secret_data[SECRET_CHUNK_SIZE];	//Reusable chunk of secret file data.
+    long size_secret_file;					//Size of secret file.
+    long secret_offset;						//File offset of the secret data, 0 unless one stripe of it is encoded.
+    long secret_part;						//Bytes of the secret file from secret_offset on, -1 for all of it.
+    int large;								//Non zero for 64 bit size fields (LARGE_FLAG), set by check_capacity.
+    const StegoStripe *stripe;				//Stripe fields of the secret data, NULL when it is not striped.
+    int depth;								//Payload bits per carrier byte, 1 to 4, 0 for auto.
+    int compress;							//Non zero to store the secret as LZ frames.
+    int crc;								//Non zero to store a CRC32C of the stored secret after it.
+    uint payload_crc;						//CRC32C of the secret data embedded so far.
+    const unsigned char *key;				//ChaCha20 key to encrypt the stored secret with, NULL for none.
+    unsigned char nonce[CHACHA20_NONCE_SIZE];	//Nonce of the encryption, random for every image.
+    int scatter;							//Non zero to scatter the stored secret over keyed tiles of the image, needs a key.
+    ScatterMap scatter_map;					//Tiles of the scattered secret while it is encoded.
 
     /* Stego Image Info */
     char *stego_image_fname;				//Output image file name.
     FILE *fptr_stego_image;					//File pointer for output image.
 
+    /* Memory mapped engine Info */
+    char *stego_map;						//Mapping of output image, NULL on stdio path.
+    size_t map_size;						//Size of the mapping in bytes.
+    size_t carrier_pos;						//Carrier byte the next field goes to, on every engine.
+    int use_stdio;							//Non zero to skip the memory mapped engine.
+    int stdin_fd;							//Descriptor a - source image or secret is read from, STDIN_FILENO outside the daemon.
+    int stdout_fd;							//Descriptor a - stego image is written to, STDOUT_FILENO outside the daemon.
+
+    /* In place engine Info */
+    int in_place;							//Non zero to patch the source image itself, no output file.
+    char *patch_buffer;						//File bytes of one chunk, in place engine only.
+
+    /* Parallel encode Info */
+    ThreadPool *pool;						//Worker pool for secret data, NULL to encode on one thread.
+
+    int quiet;								//Non zero to skip the INFO lines.
+    Stats *stats;							//Stage timings and I/O counters, NULL when not recorded.
+
 } EncodeInfo;
 
 
@@ -42,6 +82,9 @@ typedef struct _EncodeInfo
 /* Check operation type */
 OperationType check_operation_type(char *argv[]);
 
+/* Get the extension of a file name */
+const char *file_extn(const char *fname);
+
 /* Read and validate Encode args from argv */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo);
 
@@ -51,17 +94,23 @@ Status do_encoding(EncodeInfo *encInfo);
 /* Get File pointers for i/p and o/p files */
 Status open_files(EncodeInfo *encInfo);
 
+/* Close all files opened by open_files */
+void close_files(EncodeInfo *encInfo);
+
+/* Print an INFO line unless quiet */
+void encode_info(const EncodeInfo *encInfo, const char *format, ...);
+
+/* Replace the secret file by its compressed frames */
+Status compress_secret_file(EncodeInfo *encInfo);
+
 /* check capacity */
 Status check_capacity(EncodeInfo *encInfo);
 
-/* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image);
-
 /* Get file size */
-uint get_file_size(FILE *fptr);
+long get_file_size(FILE *fptr);
 
-/* Copy bmp image header */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image);
+/* Copy the image header */
+Status copy_image_header(EncodeInfo *encInfo);
 
 /* Store Magic String */
 Status encode_magic_string(char *magic_string, EncodeInfo *encInfo);
@@ -72,22 +121,80 @@ Status encode_secret_file_extn_size(int extn_size, EncodeInfo *encInfo);
 /* Encode secret file extenstion */
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo);
 
-/* Encode secret file size */
-Status encode_secret_file_size(int file_size, EncodeInfo *encInfo);
+/* Encode secret file size, 64 bits for large secrets */
+Status encode_secret_file_size(long file_size, EncodeInfo *encInfo);
+
+/* Encode a 32 bit field on the engine in use */
+Status encode_size_field(uint field, EncodeInfo *encInfo);
+
+/* Encode the stripe fields after the secret file size */
+Status encode_secret_file_stripe(EncodeInfo *encInfo);
 
 /* Encode secret file data*/
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
+/* Encode the nonce of the encrypted secret data before it */
+Status encode_secret_file_nonce(EncodeInfo *encInfo);
+
+/* Encode the CRC32C of the secret data after it */
+Status encode_secret_file_crc(EncodeInfo *encInfo);
+
+/* Encode secret file data with reads, embedding and writes overlapped */
+Status encode_secret_file_data_pipelined(EncodeInfo *encInfo);
+
+/* Encode secret file data to the keyed tiles of the image */
+Status encode_secret_file_data_scattered(EncodeInfo *encInfo);
+
 /* Encode function, which does the real encoding */
-Status encode_data_to_image(const char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image);
+Status encode_data_to_image(const char *data, int size, int depth, EncodeInfo *encInfo);
 
 /* Encode a byte into LSB of image data array */
 Status encode_byte_to_lsb(char data, char *image_buffer);
 
 /* Encode size to LSB */
-Status encode_size_to_lsb(int size, FILE *fptr_src_image, FILE *fptr_stego_image);
+Status encode_size_to_lsb(int size, EncodeInfo *encInfo);
 
 /* Copy remaining image bytes from src to stego image after encoding */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
 
+/* Memory mapped encode engine */
+
+/* Copy the source image to the stego image and map the stego image */
+Status map_files(EncodeInfo *encInfo);
+
+/* Unmap the stego image file */
+void unmap_files(EncodeInfo *encInfo);
+
+/* Skip the image header inside the mapping */
+Status copy_image_header_to_map(EncodeInfo *encInfo);
+
+/* Encode data straight into the mapped pixel array */
+Status encode_data_to_map(const char *data, int size, int depth, EncodeInfo *encInfo);
+
+/* Encode data into the scattered tiles of the mapped pixel array */
+Status encode_data_to_map_tiles(const char *data, int size, long pos, EncodeInfo *encInfo);
+
+/* Encode size straight into the mapped pixel array */
+Status encode_size_to_map(int size, EncodeInfo *encInfo);
+
+/* Encode secret file data on all threads of the pool */
+Status encode_secret_file_data_parallel(EncodeInfo *encInfo);
+
+/* Copy remaining image bytes inside the mapping */
+Status copy_remaining_img_data_to_map(EncodeInfo *encInfo);
+
+/* In place encode engine */
+
+/* Prepare the source image to be patched with pread/pwrite */
+Status prepare_in_place(EncodeInfo *encInfo);
+
+/* Encode data straight into the source image */
+Status encode_data_in_place(const char *data, int size, int depth, EncodeInfo *encInfo);
+
+/* Encode data into the scattered tiles of the source image */
+Status encode_data_in_place_tiles(const char *data, int size, long pos, EncodeInfo *encInfo);
+
+/* Encode size straight into the source image */
+Status encode_size_in_place(int size, EncodeInfo *encInfo);
+
 #endif
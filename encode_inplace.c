@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "encode.h"
+#include "lsb.h"
+#include "scatter.h"
+#include "stego.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Prepare the source image to be patched in place
+ * Description: Only a regular file can be patched with pread/pwrite. The
+ * header stays where it is, encoding starts at the pixel array.
+ * Input: Encode Info with the source image opened read write
+ * Output: map_size, carrier_pos and patch_buffer are set
+ * Return: e_success or e_failure
+ */
+Status prepare_in_place(EncodeInfo *encInfo)
+{
+	struct stat src_stat;
+
+	if(fstat(fileno(encInfo->fptr_src_image), &src_stat) != 0 || !S_ISREG(src_stat.st_mode))
+	{
+		return e_failure;
+	}
+	encInfo->patch_buffer = malloc(CARRIER_SPAN_MAX(SECRET_CHUNK_SIZE * 8));
+	if(encInfo->patch_buffer == NULL)
+	{
+		return e_failure;
+	}
+	encInfo->map_size = src_stat.st_size;
+	encInfo->carrier_pos = 0;
+
+	return e_success;
+}
+
+/* Patch carrier bytes of the source image
+ * Description: Reads the file bytes the data goes to, embeds the data
+ * and writes the same range back, nothing else of the image is touched.
+ * Input: data, data size, bits per carrier byte, Encode Info opened in place
+ * Output: Data embedded at the encode position of the source image
+ * Return: e_success or e_failure
+ */
+static Status patch_carrier(const char *data, size_t size, int depth, EncodeInfo *encInfo)
+{
+	int fd = fileno(encInfo->fptr_src_image);
+	size_t carrier = lsb_carrier_bytes(size, depth);
+	size_t span = carrier_span(&encInfo->carrier, encInfo->carrier_pos, carrier);
+	off_t offset = carrier_offset(&encInfo->carrier, encInfo->carrier_pos);
+
+	if(pread(fd, encInfo->patch_buffer, span, offset) != (ssize_t)span)
+	{
+		return e_failure;
+	}
+	stego_embed_bytes(&encInfo->carrier, encInfo->patch_buffer, encInfo->patch_buffer, encInfo->carrier_pos, data, size, depth);
+	if(pwrite(fd, encInfo->patch_buffer, span, offset) != (ssize_t)span)
+	{
+		return e_failure;
+	}
+	encInfo->carrier_pos += carrier;
+
+	return e_success;
+}
+
+/* Encode data into the source image in place
+ * Description: Patches the carrier bytes one chunk at a time through
+ * patch_buffer, so the I/O is the payload range and not the whole image.
+ * Input: data, data size, bits per carrier byte, Encode Info opened in place
+ * Output: Encode data to the source image.
+ * Return: e_success or e_failure
+ */
+Status encode_data_in_place(const char *data, int size, int depth, EncodeInfo *encInfo)
+{
+	//Make sure the data fits in the remaining carrier bytes.
+	if(lsb_carrier_bytes(size, depth) > encInfo->image_capacity - encInfo->carrier_pos)
+	{
+		return e_failure;
+	}
+
+	for(int i = 0; i < size; i += SECRET_CHUNK_SIZE)
+	{
+		int chunk = size - i < SECRET_CHUNK_SIZE ? size - i : SECRET_CHUNK_SIZE;
+
+		if(patch_carrier(data + i, chunk, depth, encInfo) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	return e_success;
+}
+
+/* Encode data into the scattered tiles of the source image in place
+ * Description: Every tile the data goes to is read, embedded into and
+ * written back whole, one page (and its row padding) per pread and
+ * pwrite. The region starts at the encode position, which stays there
+ * until the whole secret is embedded.
+ * Input: data, data size, carrier byte of the secret the data starts at, Encode Info opened in place with a scatter map
+ * Output: Encode data to the tiles of the source image.
+ * Return: e_success or e_failure
+ */
+Status encode_data_in_place_tiles(const char *data, int size, long pos, EncodeInfo *encInfo)
+{
+	int fd = fileno(encInfo->fptr_src_image);
+
+	while(size > 0)
+	{
+		size_t index = pos / SCATTER_TILE_SIZE;
+		size_t bytes = scatter_tile_bytes(pos, size, encInfo->depth);
+		off_t offset = scatter_tile_offset(&encInfo->scatter_map, index);
+		ssize_t span = scatter_tile_span(&encInfo->scatter_map, index);
+
+		if(pread(fd, encInfo->patch_buffer, span, offset) != span)
+		{
+			return e_failure;
+		}
+		scatter_embed_tile(&encInfo->scatter_map, index, encInfo->patch_buffer, pos % SCATTER_TILE_SIZE, data, bytes, encInfo->depth);
+		if(pwrite(fd, encInfo->patch_buffer, span, offset) != span)
+		{
+			return e_failure;
+		}
+		pos = (index + 1) * SCATTER_TILE_SIZE;
+		data += bytes;
+		size -= bytes;
+	}
+	return e_success;
+}
+
+/* Encode size into the source image in place
+ * Input: Size, Encode Info opened in place
+ * Output: Encoding the size to lsb of 32 carrier bytes.
+ * Return: e_success or e_failure
+ */
+Status encode_size_in_place(int size, EncodeInfo *encInfo)
+{
+	int fd = fileno(encInfo->fptr_src_image);
+	char buffer[CARRIER_SPAN_MAX(32)];
+	ssize_t span = carrier_span(&encInfo->carrier, encInfo->carrier_pos, 32);
+	off_t offset = carrier_offset(&encInfo->carrier, encInfo->carrier_pos);
+
+	if(encInfo->image_capacity - encInfo->carrier_pos < 32)
+	{
+		return e_failure;
+	}
+
+	if(pread(fd, buffer, span, offset) != span)
+	{
+		return e_failure;
+	}
+	stego_embed_size(&encInfo->carrier, buffer, buffer, encInfo->carrier_pos, size);
+	if(pwrite(fd, buffer, span, offset) != span)
+	{
+		return e_failure;
+	}
+	encInfo->carrier_pos += 32;
+
+	return e_success;
+}
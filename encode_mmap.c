@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chacha20.h"
+#include "crc32c.h"
+#include "encode.h"
+#include "file_copy.h"
+#include "lsb.h"
+#include "scatter.h"
+#include "stego.h"
+#include "types.h"
+
+/* Slices of the secret data for the parallel encode */
+typedef struct _EncodeSlices
+{
+	int secret_fd;							//Secret file, read with pread.
+	long secret_offset;						//File offset of the first secret byte.
+	char *image;							//Whole stego mapping.
+	const Carrier *carrier;					//Layout of the image.
+	size_t pos;								//Carrier byte of the first secret byte.
+	long size;								//Secret file size.
+	int depth;								//Payload bits per carrier byte.
+	int count;								//Number of slices.
+	int failed;								//Set when any slice fails.
+	uint *crcs;								//CRC32C of every slice, NULL when not needed.
+	const unsigned char *key;				//ChaCha20 key, NULL for no encryption.
+	const unsigned char *nonce;
+	const ScatterMap *scatter;				//Tiles of a scattered secret, NULL when sequential.
+} EncodeSlices;
+
+/* Function Definitions */
+
+/* Map source and stego image files
+ * Description: Copies the source image to the stego image kernel side, then
+ * maps the stego image read write so the encoding stages can embed straight
+ * into its copy of the pixel array. Only regular files can be mapped.
+ * Input: Encode Info with opened source and stego file pointers
+ * Output: stego_map and map_size are set
+ * Return: e_success, or e_failure if the stdio path has to be used
+ */
+Status map_files(EncodeInfo *encInfo)
+{
+	struct stat src_stat, stego_stat;
+	off_t src_offset = 0, stego_offset = 0;
+	int src_fd = fileno(encInfo->fptr_src_image);
+	int stego_fd = fileno(encInfo->fptr_stego_image);
+
+	encInfo->stego_map = NULL;
+
+	//Both files have to be regular files, pipes and devices cannot be mapped.
+	if(fstat(src_fd, &src_stat) != 0 || fstat(stego_fd, &stego_stat) != 0)
+	{
+		return e_failure;
+	}
+	if(!S_ISREG(src_stat.st_mode) || !S_ISREG(stego_stat.st_mode))
+	{
+		return e_failure;
+	}
+
+	//Copy the whole source image kernel side (reflinked where possible), so
+	//only the bytes that carry data have to be touched through the mapping.
+	if(ftruncate(stego_fd, 0) != 0 || copy_file_data(src_fd, &src_offset, stego_fd, &stego_offset, src_stat.st_size) == e_failure)
+	{
+		return e_failure;
+	}
+
+	encInfo->stego_map = mmap(NULL, src_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, stego_fd, 0);
+	if(encInfo->stego_map == MAP_FAILED)
+	{
+		encInfo->stego_map = NULL;
+		return e_failure;
+	}
+
+	//Only the front of the pixel array is walked, front to back, scattered tiles are hit in keyed order.
+	madvise(encInfo->stego_map, src_stat.st_size, encInfo->scatter ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+	encInfo->map_size = src_stat.st_size;
+	encInfo->carrier_pos = 0;
+
+	return e_success;
+}
+
+/* Unmap the stego image file
+ * Input: Encode Info with the mapped stego image
+ * Output: Mapping is released, stego data is left to the page cache
+ * Return: None
+ */
+void unmap_files(EncodeInfo *encInfo)
+{
+	if(encInfo->stego_map != NULL)
+	{
+		munmap(encInfo->stego_map, encInfo->map_size);
+		encInfo->stego_map = NULL;
+	}
+}
+
+/* Skip the image header inside the mapping.
+ * Description: map_files already copied the header kernel side, and in
+ * place the header is already there, so only the encode position moves
+ * to the first carrier byte.
+ * Input: Encode Info with mapped files or opened in place
+ * Output: Encode position set to the pixel array
+ * Return: e_success or e_failure
+ */
+Status copy_image_header_to_map(EncodeInfo *encInfo)
+{
+	encInfo->carrier_pos = 0;
+
+	return e_success;
+}
+
+/* Encode data to the mapped image data
+ * Description: Embeds the data into the low depth bits of the next
+ * size * 8 / depth carrier bytes of the stego mapping in place, they
+ * already hold the source pixels.
+ * Input: data, data size, bits per carrier byte, Encode Info with mapped files
+ * Output: Encode data to stego image mapping.
+ * Return: e_success or e_failure
+ */
+Status encode_data_to_map(const char *data, int size, int depth, EncodeInfo *encInfo)
+{
+	char *image_buffer = encInfo->stego_map + carrier_offset(&encInfo->carrier, encInfo->carrier_pos);
+	size_t carrier = lsb_carrier_bytes(size, depth);
+
+	//Make sure the data fits in the remaining carrier bytes.
+	if(carrier > encInfo->image_capacity - encInfo->carrier_pos)
+	{
+		return e_failure;
+	}
+
+	stego_embed_bytes(&encInfo->carrier, image_buffer, image_buffer, encInfo->carrier_pos, data, size, depth);
+	encInfo->carrier_pos += carrier;
+
+	return e_success;
+}
+
+/* Encode data to the scattered tiles of the mapped image data
+ * Description: The scatter map knows where the region starts, the encode
+ * position stays there until the whole secret is embedded.
+ * Input: data, data size, carrier byte of the secret the data starts at, Encode Info with mapped files and a scatter map
+ * Output: Encode data to the tiles of the stego image mapping.
+ * Return: e_success
+ */
+Status encode_data_to_map_tiles(const char *data, int size, long pos, EncodeInfo *encInfo)
+{
+	scatter_embed(&encInfo->scatter_map, encInfo->stego_map, pos, data, size, encInfo->depth);
+
+	return e_success;
+}
+
+/* Encode size to the mapped image data
+ * Description: Encode the size to the lsb of 32 carrier bytes of the stego mapping.
+ * Input: Size, Encode Info with mapped files
+ * Output: Encoding the size to lsb of image data.
+ * Return: e_success or e_failure
+ */
+Status encode_size_to_map(int size, EncodeInfo *encInfo)
+{
+	char *buffer = encInfo->stego_map + carrier_offset(&encInfo->carrier, encInfo->carrier_pos);
+
+	if(encInfo->image_capacity - encInfo->carrier_pos < 32)
+	{
+		return e_failure;
+	}
+
+	stego_embed_size(&encInfo->carrier, buffer, buffer, encInfo->carrier_pos, size);
+	encInfo->carrier_pos += 32;
+
+	return e_success;
+}
+
+/* Slice boundary
+ * Description: Boundaries are rounded down to LSB_DEPTH_ALIGN so every slice
+ * starts on a whole carrier byte at any depth, the last one ends at size.
+ * Input: Secret size, boundary index, number of slices
+ * Output: None
+ * Return: Secret offset of the boundary
+ */
+static long slice_bound(long size, int index, int count)
+{
+	if(index == count)
+	{
+		return size;
+	}
+	return size * index / count / LSB_DEPTH_ALIGN * LSB_DEPTH_ALIGN;
+}
+
+/* Encode one slice of the secret data
+ * Description: Slice index covers secret bytes [slice_bound(index),
+ * slice_bound(index + 1)). The carrier offset of every secret byte only
+ * depends on its position, so slices need no coordination.
+ * Input: Slices description, slice index
+ * Output: The slice is embedded into the stego mapping
+ * Return: None
+ */
+static void encode_slice(void *arg, int index)
+{
+	EncodeSlices *slices = arg;
+	long start = slice_bound(slices->size, index, slices->count);
+	long end = slice_bound(slices->size, index + 1, slices->count);
+	char secret_data[SECRET_CHUNK_SIZE];
+	uint crc = 0;
+
+	while(start < end)
+	{
+		size_t chunk = end - start < SECRET_CHUNK_SIZE ? end - start : SECRET_CHUNK_SIZE;
+		size_t pos = slices->pos + lsb_carrier_bytes(start, slices->depth);
+		ssize_t nread = pread(slices->secret_fd, secret_data, chunk, slices->secret_offset + start);
+
+		//A short read would leave the next chunk off its carrier byte.
+		if(nread != (ssize_t)chunk)
+		{
+			__atomic_store_n(&slices->failed, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		//The keystream starts at the slice's own offset.
+		if(slices->key != NULL)
+		{
+			chacha20_xor(slices->key, slices->nonce, start, secret_data, nread);
+		}
+		if(slices->crcs != NULL)
+		{
+			crc = crc32c(crc, secret_data, nread);
+		}
+		if(slices->scatter != NULL)
+		{
+			scatter_embed(slices->scatter, slices->image, lsb_carrier_bytes(start, slices->depth), secret_data, nread, slices->depth);
+		}
+		else
+		{
+			char *image_data = slices->image + carrier_offset(slices->carrier, pos);
+
+			stego_embed_bytes(slices->carrier, image_data, image_data, pos, secret_data, nread, slices->depth);
+		}
+		start += nread;
+	}
+	if(slices->crcs != NULL)
+	{
+		slices->crcs[index] = crc;
+	}
+}
+
+/* Encoding secret file data on the worker pool
+ * Description: Splits the secret data into a few slices per thread, every
+ * slice reads its own part of the secret file and embeds it into the stego
+ * mapping. The output is the same for any number of threads. The CRC32C
+ * of every slice is taken as it is embedded and the slices are combined.
+ * Input: Encode Info with mapped files and a worker pool
+ * Output: Encode secret data to stego image mapping.
+ * Return: e_success or e_failure
+ */
+Status encode_secret_file_data_parallel(EncodeInfo *encInfo)
+{
+	EncodeSlices slices;
+	size_t carrier = lsb_carrier_bytes(encInfo->size_secret_file, encInfo->depth);
+
+	//Make sure the data fits in the remaining carrier bytes.
+	if(carrier > encInfo->image_capacity - encInfo->carrier_pos)
+	{
+		return e_failure;
+	}
+
+	slices.secret_fd = fileno(encInfo->fptr_secret);
+	slices.secret_offset = encInfo->secret_offset;
+	slices.image = encInfo->stego_map;
+	slices.carrier = &encInfo->carrier;
+	slices.pos = encInfo->carrier_pos;
+	slices.size = encInfo->size_secret_file;
+	slices.depth = encInfo->depth;
+	slices.count = thread_pool_size(encInfo->pool) * 4;
+	slices.failed = 0;
+	slices.crcs = NULL;
+	slices.key = encInfo->key;
+	slices.nonce = encInfo->nonce;
+	slices.scatter = encInfo->scatter ? &encInfo->scatter_map : NULL;
+	if(encInfo->crc)
+	{
+		slices.crcs = malloc(slices.count * sizeof(uint));
+		if(slices.crcs == NULL)
+		{
+			return e_failure;
+		}
+	}
+
+	thread_pool_run(encInfo->pool, encode_slice, &slices, slices.count);
+	for(int i = 0; slices.crcs != NULL && i < slices.count; i++)
+	{
+		long size = slice_bound(slices.size, i + 1, slices.count) - slice_bound(slices.size, i, slices.count);
+
+		encInfo->payload_crc = crc32c_combine(encInfo->payload_crc, slices.crcs[i], size);
+	}
+	free(slices.crcs);
+	if(slices.failed)
+	{
+		fprintf(stderr, "ERROR: Unable to read file %s\n", encInfo->secret_fname);
+		return e_failure;
+	}
+	encInfo->carrier_pos += carrier;
+
+	return e_success;
+}
+
+/* Finish the remaining data inside the mapping
+ * Description: map_files already copied the untouched tail kernel side,
+ * and in place the tail is already there, so the remaining image data is
+ * never read or written.
+ * Input: Encode Info with mapped files or opened in place
+ * Output: Encode position set to the end of the image.
+ * Return: e_success or e_failure
+ */
+Status copy_remaining_img_data_to_map(EncodeInfo *encInfo)
+{
+	encInfo->carrier_pos = encInfo->image_capacity;
+
+	return e_success;
+}
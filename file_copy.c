@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include "file_copy.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Clone a file range that runs up to the end of the source file
+ * Description: Shares the extents with the destination file (reflink) on
+ * filesystems that support it. Clones have to start block aligned, so the
+ * unaligned head is left for the caller.
+ * Input: Source and destination descriptors, common offset, head length
+ * Output: Destination shares the source blocks from offset + head up to EOF
+ * Return: e_success or e_failure if cloning is not supported
+ */
+static Status clone_to_eof(int fd_in, int fd_out, off_t offset, size_t head)
+{
+	struct file_clone_range range;
+
+	range.src_fd = fd_in;
+	range.src_offset = offset + head;
+	//Zero length clones up to the end of the source file.
+	range.src_length = 0;
+	range.dest_offset = offset + head;
+
+	if(ioctl(fd_out, FICLONERANGE, &range) == 0)
+	{
+		return e_success;
+	}
+	return e_failure;
+}
+
+/* Copy file data through a user space buffer
+ * Description: Fallback for kernels or file types without copy_file_range.
+ * NULL offsets use and advance the file positions, so pipes work too.
+ * Input: Source and destination descriptors and offsets, length
+ * Output: len bytes are copied
+ * Return: e_success or e_failure
+ */
+static Status copy_file_data_buffered(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len)
+{
+	char *buffer = malloc(COPY_BUF_SIZE);
+	Status status = e_success;
+
+	if(buffer == NULL)
+	{
+		return e_failure;
+	}
+
+	while(len > 0)
+	{
+		size_t chunk = len < COPY_BUF_SIZE ? len : COPY_BUF_SIZE;
+		ssize_t nread, nwritten, done = 0;
+
+		nread = off_in != NULL ? pread(fd_in, buffer, chunk, *off_in) : read(fd_in, buffer, chunk);
+		if(nread < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(nread <= 0)
+		{
+			status = e_failure;
+			break;
+		}
+
+		//Write the whole chunk, short writes included.
+		while(done < nread)
+		{
+			nwritten = off_out != NULL ? pwrite(fd_out, buffer + done, nread - done, *off_out + done) : write(fd_out, buffer + done, nread - done);
+			if(nwritten < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(nwritten <= 0)
+			{
+				free(buffer);
+				return e_failure;
+			}
+			done += nwritten;
+		}
+
+		if(off_in != NULL)
+		{
+			*off_in += nread;
+		}
+		if(off_out != NULL)
+		{
+			*off_out += nread;
+		}
+		len -= nread;
+	}
+
+	free(buffer);
+	return status;
+}
+
+/* Copy file data kernel side
+ * Description: Copies len bytes from fd_in to fd_out without bouncing them
+ * through user space. Ranges that run to the end of the source at the same
+ * offset in both files are reflinked where the filesystem allows it, the rest
+ * goes through copy_file_range, and a large buffer loop is the last resort.
+ * NULL offsets use and advance the file positions like copy_file_range does.
+ * Input: Source and destination descriptors and offsets, length
+ * Output: len bytes are copied, offsets are advanced
+ * Return: e_success or e_failure
+ */
+Status copy_file_data(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len)
+{
+	struct stat src_stat;
+
+	//Try to reflink, only possible when both ranges line up and end at the source EOF.
+	if(len > 0 && off_in != NULL && off_out != NULL && *off_in == *off_out && fstat(fd_in, &src_stat) == 0 && S_ISREG(src_stat.st_mode) && *off_in + (off_t)len == src_stat.st_size && src_stat.st_blksize > 0)
+	{
+		size_t head = (src_stat.st_blksize - *off_in % src_stat.st_blksize) % src_stat.st_blksize;
+
+		if(head < len && clone_to_eof(fd_in, fd_out, *off_in, head) == e_success)
+		{
+			//Only the unaligned head is left to copy.
+			off_t clone_end = *off_in + len;
+
+			if(copy_file_data(fd_in, off_in, fd_out, off_out, head) == e_failure)
+			{
+				return e_failure;
+			}
+			*off_in = clone_end;
+			*off_out = clone_end;
+			return e_success;
+		}
+	}
+
+	while(len > 0)
+	{
+		ssize_t copied = copy_file_range(fd_in, off_in, fd_out, off_out, len, 0);
+
+		if(copied > 0)
+		{
+			len -= copied;
+			continue;
+		}
+		if(copied == 0)
+		{
+			//Source ended early.
+			return e_failure;
+		}
+		if(errno == EINTR)
+		{
+			continue;
+		}
+		//Not supported for these files, copy through a buffer.
+		return copy_file_data_buffered(fd_in, off_in, fd_out, off_out, len);
+	}
+
+	return e_success;
+}
+
+/* Open a file named on the command line
+ * Description: STDIO_FNAME stands for stdin or stdout, so the tool can sit
+ * between other stages of a pipe. The daemon passes the descriptors a
+ * client sent instead, they are duplicated so the stream can be closed
+ * like any opened file.
+ * Input: File name, fopen mode, STDIN_FILENO, STDOUT_FILENO or another descriptor
+ * Output: None
+ * Return: The opened file, stdin, stdout, or NULL on failure
+ */
+FILE *open_stdio_file(const char *fname, const char *mode, int stdio_fd)
+{
+	FILE *fptr;
+	int fd;
+
+	if(!stdio_file_name(fname))
+	{
+		return fopen(fname, mode);
+	}
+	if(stdio_fd == STDIN_FILENO)
+	{
+		return stdin;
+	}
+	if(stdio_fd == STDOUT_FILENO)
+	{
+		return stdout;
+	}
+	fd = dup(stdio_fd);
+	if(fd < 0)
+	{
+		return NULL;
+	}
+	//A descriptor opened write only, as by a shell redirection, does not take "w+".
+	fptr = fdopen(fd, mode[0] == 'r' ? "r" : "w");
+	if(fptr == NULL)
+	{
+		close(fd);
+	}
+	return fptr;
+}
+
+/* Check for the stdin or stdout file name */
+int stdio_file_name(const char *fname)
+{
+	return fname != NULL && strcmp(fname, STDIO_FNAME) == 0;
+}
+
+/* Check for a regular file
+ * Description: Pipes, sockets and terminals can only be read or written
+ * front to back once, stdin redirected from a file is a regular file.
+ * Input: Opened file
+ * Output: None
+ * Return: Non zero if fptr is a regular file
+ */
+int regular_file(FILE *fptr)
+{
+	struct stat file_stat;
+
+	return fstat(fileno(fptr), &file_stat) == 0 && S_ISREG(file_stat.st_mode);
+}
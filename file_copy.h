@@ -0,0 +1,27 @@
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "types.h" // Contains user defined types
+
+/* Buffer size used when the kernel cannot copy for us */
+#define COPY_BUF_SIZE (1024 * 1024)
+/* File name of stdin or stdout on the command line */
+#define STDIO_FNAME "-"
+
+/* Kernel side file copy function prototype */
+
+/* Copy len bytes between file descriptors, reflink or copy_file_range when possible */
+Status copy_file_data(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len);
+
+/* fopen, or a stream on stdio_fd (stdin, stdout or a descriptor sent to the daemon) when fname is STDIO_FNAME */
+FILE *open_stdio_file(const char *fname, const char *mode, int stdio_fd);
+
+/* Non zero if fname is STDIO_FNAME */
+int stdio_file_name(const char *fname);
+
+/* Non zero if fptr is a regular file, which can be seeked, mapped and read with pread */
+int regular_file(FILE *fptr);
+
+#endif
@@ -0,0 +1,504 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lsb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LSB_X86 1
+#endif
+
+/*
+ * Every lane of a 64 bit word holds a copy of the payload byte, lane i keeps
+ * bit (7 - i) so carrier byte i gets the payload bits MSB first.
+ */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LSB_SELECT 0x8040201008040201ULL
+#define LSB_LANES(x) __builtin_bswap64(x)
+#else
+#define LSB_SELECT 0x0102040810204080ULL
+#define LSB_LANES(x) (x)
+#endif
+#define LSB_ONES 0x0101010101010101ULL
+#define LSB_KEEP 0xfefefefefefefefeULL
+
+/* Kernel tier descriptor */
+typedef struct _LsbKernel
+{
+	const char *name;					//Tier name.
+	int (*supported)(void);				//Runtime check for the tier.
+	LsbEmbedFn embed;					//Embed kernel.
+	LsbExtractFn extract;				//Extract kernel.
+} LsbKernel;
+
+/* Function Definitions */
+
+/* Portable SWAR embed kernel
+ * Description: Spreads one payload byte over a 64 bit word and merges it
+ * into 8 carrier bytes with a single load and store.
+ * Input: Destination and source carrier bytes, payload data, payload size
+ * Output: size * 8 carrier bytes with the payload in their lsb
+ * Return: None
+ */
+static void lsb_embed_scalar(char *dst, const char *src, const char *data, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		uint64_t carrier, bits;
+
+		//Copy the byte to every lane and keep one bit per lane.
+		bits = ((unsigned char)data[i] * LSB_ONES) & LSB_SELECT;
+		//Turn every non zero lane into 1.
+		bits = ((bits + 0x7f7f7f7f7f7f7f7fULL) >> 7) & LSB_ONES;
+
+		memcpy(&carrier, src + i * 8, 8);
+		carrier = (carrier & LSB_KEEP) | bits;
+		memcpy(dst + i * 8, &carrier, 8);
+	}
+}
+
+/* Portable SWAR extract kernel
+ * Description: Masks the lsb of 8 carrier bytes and gathers them into one
+ * byte with a single multiply, lane 0 lands in the MSB.
+ * Input: Payload buffer, source carrier bytes, payload size
+ * Output: size payload bytes
+ * Return: None
+ */
+static void lsb_extract_scalar(char *data, const char *src, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		uint64_t carrier;
+
+		memcpy(&carrier, src + i * 8, 8);
+		carrier = LSB_LANES(carrier) & LSB_ONES;
+		data[i] = (char)((carrier * 0x8040201008040201ULL) >> 56);
+	}
+}
+
+static int lsb_always(void)
+{
+	return 1;
+}
+
+#ifdef LSB_X86
+
+/* Merge 16 spread payload bytes into 16 carrier bytes */
+__attribute__((target("sse2")))
+static inline void lsb_merge_sse2(char *dst, const char *src, __m128i spread)
+{
+	const __m128i select = _mm_set1_epi64x(LSB_SELECT);
+	__m128i bits, carrier;
+
+	bits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(spread, select), select), _mm_set1_epi8(1));
+	carrier = _mm_loadu_si128((const __m128i *)src);
+	carrier = _mm_or_si128(_mm_and_si128(carrier, _mm_set1_epi8((char)0xfe)), bits);
+	_mm_storeu_si128((__m128i *)dst, carrier);
+}
+
+/* SSE2 embed kernel
+ * Description: Widens 16 payload bytes to 8 copies each with unpack
+ * instructions and merges them into 128 carrier bytes per step.
+ * Input: Destination and source carrier bytes, payload data, payload size
+ * Output: size * 8 carrier bytes with the payload in their lsb
+ * Return: None
+ */
+__attribute__((target("sse2")))
+static void lsb_embed_sse2(char *dst, const char *src, const char *data, size_t size)
+{
+	size_t i = 0;
+
+	for(; i + 16 <= size; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i lo = _mm_unpacklo_epi8(v, v), hi = _mm_unpackhi_epi8(v, v);
+		__m128i w0 = _mm_unpacklo_epi16(lo, lo), w1 = _mm_unpackhi_epi16(lo, lo);
+		__m128i w2 = _mm_unpacklo_epi16(hi, hi), w3 = _mm_unpackhi_epi16(hi, hi);
+		char *d = dst + i * 8;
+		const char *s = src + i * 8;
+
+		lsb_merge_sse2(d, s, _mm_unpacklo_epi32(w0, w0));
+		lsb_merge_sse2(d + 16, s + 16, _mm_unpackhi_epi32(w0, w0));
+		lsb_merge_sse2(d + 32, s + 32, _mm_unpacklo_epi32(w1, w1));
+		lsb_merge_sse2(d + 48, s + 48, _mm_unpackhi_epi32(w1, w1));
+		lsb_merge_sse2(d + 64, s + 64, _mm_unpacklo_epi32(w2, w2));
+		lsb_merge_sse2(d + 80, s + 80, _mm_unpackhi_epi32(w2, w2));
+		lsb_merge_sse2(d + 96, s + 96, _mm_unpacklo_epi32(w3, w3));
+		lsb_merge_sse2(d + 112, s + 112, _mm_unpackhi_epi32(w3, w3));
+	}
+	lsb_embed_scalar(dst + i * 8, src + i * 8, data + i, size - i);
+}
+
+/* SSE2 extract kernel
+ * Description: Reverses the carrier bytes of each payload byte with word
+ * shuffles, lines their lsb up with the sign bits and collects 2 payload
+ * bytes per vector with movemask.
+ * Input: Payload buffer, source carrier bytes, payload size
+ * Output: size payload bytes
+ * Return: None
+ */
+__attribute__((target("sse2")))
+static void lsb_extract_sse2(char *data, const char *src, size_t size)
+{
+	size_t i = 0;
+
+	for(; i + 2 <= size; i += 2)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i * 8));
+		int mask;
+
+		//Reverse the 16 bit words of each half, then swap the bytes of
+		//every word while moving their lsb to the sign bit.
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1b), 0x1b);
+		v = _mm_or_si128(_mm_srli_epi16(v, 1), _mm_slli_epi16(v, 15));
+		mask = _mm_movemask_epi8(v);
+		data[i] = (char)mask;
+		data[i + 1] = (char)(mask >> 8);
+	}
+	lsb_extract_scalar(data + i, src + i * 8, size - i);
+}
+
+static int lsb_has_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+/* AVX2 embed kernel
+ * Description: Broadcasts 4 payload bytes, spreads each over 8 lanes with a
+ * byte shuffle and merges them into 32 carrier bytes per vector.
+ * Input: Destination and source carrier bytes, payload data, payload size
+ * Output: size * 8 carrier bytes with the payload in their lsb
+ * Return: None
+ */
+__attribute__((target("avx2")))
+static void lsb_embed_avx2(char *dst, const char *src, const char *data, size_t size)
+{
+	const __m256i spread = _mm256_setr_epi64x(0, LSB_ONES, 2 * LSB_ONES, 3 * LSB_ONES);
+	const __m256i select = _mm256_set1_epi64x(LSB_SELECT);
+	const __m256i keep = _mm256_set1_epi8((char)0xfe);
+	const __m256i one = _mm256_set1_epi8(1);
+	size_t i = 0;
+
+	for(; i + 4 <= size; i += 4)
+	{
+		uint32_t word;
+		__m256i v, bits, carrier;
+
+		memcpy(&word, data + i, 4);
+		v = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+		bits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(v, select), select), one);
+		carrier = _mm256_loadu_si256((const __m256i *)(src + i * 8));
+		carrier = _mm256_or_si256(_mm256_and_si256(carrier, keep), bits);
+		_mm256_storeu_si256((__m256i *)(dst + i * 8), carrier);
+	}
+	lsb_embed_scalar(dst + i * 8, src + i * 8, data + i, size - i);
+}
+
+/* AVX2 extract kernel
+ * Description: Reverses each group of 8 carrier bytes with a byte shuffle,
+ * shifts the lsb to the sign bit and collects 4 payload bytes per vector.
+ * Input: Payload buffer, source carrier bytes, payload size
+ * Output: size payload bytes
+ * Return: None
+ */
+__attribute__((target("avx2")))
+static void lsb_extract_avx2(char *data, const char *src, size_t size)
+{
+	const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	size_t i = 0;
+
+	for(; i + 4 <= size; i += 4)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 8));
+		uint32_t mask;
+
+		v = _mm256_slli_epi64(_mm256_shuffle_epi8(v, reverse), 7);
+		mask = (uint32_t)_mm256_movemask_epi8(v);
+		memcpy(data + i, &mask, 4);
+	}
+	lsb_extract_scalar(data + i, src + i * 8, size - i);
+}
+
+static int lsb_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+/* AVX-512 embed kernel
+ * Description: Broadcasts 8 payload bytes, spreads each over 8 lanes and
+ * tests them straight into a mask, 64 carrier bytes per vector.
+ * Input: Destination and source carrier bytes, payload data, payload size
+ * Output: size * 8 carrier bytes with the payload in their lsb
+ * Return: None
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb_embed_avx512(char *dst, const char *src, const char *data, size_t size)
+{
+	const __m512i spread = _mm512_set_epi64(7 * LSB_ONES, 6 * LSB_ONES, 5 * LSB_ONES, 4 * LSB_ONES, 3 * LSB_ONES, 2 * LSB_ONES, LSB_ONES, 0);
+	const __m512i select = _mm512_set1_epi64(LSB_SELECT);
+	const __m512i keep = _mm512_set1_epi8((char)0xfe);
+	const __m512i one = _mm512_set1_epi8(1);
+	size_t i = 0;
+
+	for(; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		__mmask64 bits;
+		__m512i carrier;
+
+		memcpy(&word, data + i, 8);
+		bits = _mm512_test_epi8_mask(_mm512_shuffle_epi8(_mm512_set1_epi64(word), spread), select);
+		carrier = _mm512_and_si512(_mm512_loadu_si512(src + i * 8), keep);
+		carrier = _mm512_or_si512(carrier, _mm512_maskz_mov_epi8(bits, one));
+		_mm512_storeu_si512(dst + i * 8, carrier);
+	}
+	lsb_embed_scalar(dst + i * 8, src + i * 8, data + i, size - i);
+}
+
+/* AVX-512 extract kernel
+ * Description: Reverses each group of 8 carrier bytes and tests their lsb
+ * straight into a mask, 8 payload bytes per vector.
+ * Input: Payload buffer, source carrier bytes, payload size
+ * Output: size payload bytes
+ * Return: None
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void lsb_extract_avx512(char *data, const char *src, size_t size)
+{
+	const __m512i reverse = _mm512_set4_epi32(0x08090a0b, 0x0c0d0e0f, 0x00010203, 0x04050607);
+	const __m512i one = _mm512_set1_epi8(1);
+	size_t i = 0;
+
+	for(; i + 8 <= size; i += 8)
+	{
+		__mmask64 mask;
+
+		mask = _mm512_test_epi8_mask(_mm512_shuffle_epi8(_mm512_loadu_si512(src + i * 8), reverse), one);
+		memcpy(data + i, &mask, 8);
+	}
+	lsb_extract_scalar(data + i, src + i * 8, size - i);
+}
+
+static int lsb_has_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+
+#endif
+
+/* Kernel tiers, best first */
+static const LsbKernel lsb_kernels[] =
+{
+#ifdef LSB_X86
+	{ "avx512", lsb_has_avx512, lsb_embed_avx512, lsb_extract_avx512 },
+	{ "avx2", lsb_has_avx2, lsb_embed_avx2, lsb_extract_avx2 },
+	{ "sse2", lsb_has_sse2, lsb_embed_sse2, lsb_extract_sse2 },
+#endif
+	{ "scalar", lsb_always, lsb_embed_scalar, lsb_extract_scalar },
+};
+
+#define LSB_KERNEL_COUNT (sizeof(lsb_kernels) / sizeof(lsb_kernels[0]))
+
+static const LsbKernel *lsb_active = &lsb_kernels[LSB_KERNEL_COUNT - 1];
+
+/* Pick the kernel tier
+ * Description: Runs once at startup and selects the best tier the CPU
+ * supports. LSB_KERNEL in the environment forces a tier for testing.
+ * Input: None
+ * Output: lsb_active is set
+ * Return: None
+ */
+__attribute__((constructor))
+static void lsb_init(void)
+{
+	const char *forced = getenv("LSB_KERNEL");
+
+#ifdef LSB_X86
+	__builtin_cpu_init();
+#endif
+	if(forced != NULL && lsb_select_kernel(forced) == 0)
+	{
+		return;
+	}
+	for(size_t i = 0; i < LSB_KERNEL_COUNT; i++)
+	{
+		if(lsb_kernels[i].supported())
+		{
+			lsb_active = &lsb_kernels[i];
+			return;
+		}
+	}
+}
+
+/* Force a kernel tier by name
+ * Input: Tier name
+ * Output: Tier is used by all later calls
+ * Return: 0 on success, -1 if unknown or unsupported on this CPU
+ */
+int lsb_select_kernel(const char *name)
+{
+	for(size_t i = 0; i < LSB_KERNEL_COUNT; i++)
+	{
+		if(strcmp(lsb_kernels[i].name, name) == 0 && lsb_kernels[i].supported())
+		{
+			lsb_active = &lsb_kernels[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Name of the kernel tier in use */
+const char *lsb_kernel_name(void)
+{
+	return lsb_active->name;
+}
+
+/* Embed payload bytes into carrier bytes
+ * Description: Dispatches to the selected kernel tier.
+ * Input: Destination and source carrier bytes (may be the same), payload data, payload size
+ * Output: size * 8 carrier bytes with the payload in their lsb, MSB first
+ * Return: None
+ */
+void lsb_embed(char *dst, const char *src, const char *data, size_t size)
+{
+	lsb_active->embed(dst, src, data, size);
+}
+
+/* Extract payload bytes from carrier bytes
+ * Description: Dispatches to the selected kernel tier.
+ * Input: Payload buffer, source carrier bytes, payload size
+ * Output: size payload bytes rebuilt MSB first from the carrier lsb
+ * Return: None
+ */
+void lsb_extract(char *data, const char *src, size_t size)
+{
+	lsb_active->extract(data, src, size);
+}
+
+/* Embed payload bits at a fixed depth
+ * Description: Streams the payload bits MSB first through an accumulator,
+ * depth bits into the low bits of every carrier byte. Always inlined with a
+ * constant depth, so every depth gets its own unrolled kernel. A last
+ * partial carrier byte is padded with zero bits.
+ * Input: Destination and source carrier bytes, payload data, payload size, depth
+ * Output: lsb_carrier_bytes(size, depth) carrier bytes with the payload in their low bits
+ * Return: None
+ */
+static inline __attribute__((always_inline)) void lsb_embed_bits(char *dst, const char *src, const char *data, size_t size, const int depth)
+{
+	const unsigned int mask = (1u << depth) - 1;
+	unsigned int acc = 0;
+	int bits = 0;
+	size_t j = 0;
+
+	for(size_t i = 0; i < size; i++)
+	{
+		acc = acc << 8 | (unsigned char)data[i];
+		bits += 8;
+		while(bits >= depth)
+		{
+			bits -= depth;
+			dst[j] = (src[j] & ~mask) | ((acc >> bits) & mask);
+			j++;
+		}
+	}
+	if(bits > 0)
+	{
+		dst[j] = (src[j] & ~mask) | ((acc << (depth - bits)) & mask);
+	}
+}
+
+/* Extract payload bits at a fixed depth, the inverse of lsb_embed_bits */
+static inline __attribute__((always_inline)) void lsb_extract_bits(char *data, const char *src, size_t size, const int depth)
+{
+	const unsigned int mask = (1u << depth) - 1;
+	unsigned int acc = 0;
+	int bits = 0;
+	size_t i = 0;
+
+	for(size_t j = 0; i < size; j++)
+	{
+		acc = acc << depth | ((unsigned char)src[j] & mask);
+		bits += depth;
+		if(bits >= 8)
+		{
+			bits -= 8;
+			data[i++] = (char)(acc >> bits);
+		}
+	}
+}
+
+static void lsb_embed_depth2(char *dst, const char *src, const char *data, size_t size)
+{
+	lsb_embed_bits(dst, src, data, size, 2);
+}
+
+static void lsb_embed_depth3(char *dst, const char *src, const char *data, size_t size)
+{
+	lsb_embed_bits(dst, src, data, size, 3);
+}
+
+static void lsb_embed_depth4(char *dst, const char *src, const char *data, size_t size)
+{
+	lsb_embed_bits(dst, src, data, size, 4);
+}
+
+static void lsb_extract_depth2(char *data, const char *src, size_t size)
+{
+	lsb_extract_bits(data, src, size, 2);
+}
+
+static void lsb_extract_depth3(char *data, const char *src, size_t size)
+{
+	lsb_extract_bits(data, src, size, 3);
+}
+
+static void lsb_extract_depth4(char *data, const char *src, size_t size)
+{
+	lsb_extract_bits(data, src, size, 4);
+}
+
+/* Kernels for depth 2 to 4, depth 1 uses the dispatched tiers */
+static const LsbEmbedFn lsb_depth_embed[LSB_MAX_DEPTH + 1] = { NULL, NULL, lsb_embed_depth2, lsb_embed_depth3, lsb_embed_depth4 };
+static const LsbExtractFn lsb_depth_extract[LSB_MAX_DEPTH + 1] = { NULL, NULL, lsb_extract_depth2, lsb_extract_depth3, lsb_extract_depth4 };
+
+/* Embed payload bytes at depth bits per carrier byte
+ * Input: Destination and source carrier bytes (may be the same), payload data, payload size, depth 1 to 4
+ * Output: lsb_carrier_bytes(size, depth) carrier bytes with the payload in their low bits
+ * Return: None
+ */
+void lsb_embed_depth(char *dst, const char *src, const char *data, size_t size, int depth)
+{
+	if(depth == 1)
+	{
+		lsb_active->embed(dst, src, data, size);
+	}
+	else
+	{
+		lsb_depth_embed[depth](dst, src, data, size);
+	}
+}
+
+/* Extract payload bytes stored at depth bits per carrier byte
+ * Input: Payload buffer, source carrier bytes, payload size, depth 1 to 4
+ * Output: size payload bytes
+ * Return: None
+ */
+void lsb_extract_depth(char *data, const char *src, size_t size, int depth)
+{
+	if(depth == 1)
+	{
+		lsb_active->extract(data, src, size);
+	}
+	else
+	{
+		lsb_depth_extract[depth](data, src, size);
+	}
+}
+
+/* Carrier bytes used by size payload bytes at depth bits per carrier byte, rounded up */
+size_t lsb_carrier_bytes(size_t size, int depth)
+{
+	return (size * 8 + depth - 1) / depth;
+}
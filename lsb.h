@@ -0,0 +1,51 @@
+#ifndef LSB_H
+#define LSB_H
+
+#include <stddef.h>
+
+/*
+ * Block LSB kernels shared by the encode and decode engines.
+ * Payload bytes are laid out MSB first, one bit per carrier byte,
+ * exactly like encode_byte_to_lsb / decode_byte_from_lsb.
+ * The fastest tier the CPU supports is picked at startup,
+ * LSB_KERNEL=<tier> in the environment overrides it.
+ *
+ * The _depth variants store 1 to 4 payload bits in the low bits of every
+ * carrier byte, still MSB first. Depth 1 is the layout above. Blocks of
+ * payload bytes have to be split at multiples of LSB_DEPTH_ALIGN so every
+ * block starts on a whole carrier byte.
+ */
+
+#define LSB_MAX_DEPTH 4
+#define LSB_DEPTH_ALIGN 12
+
+/* Embed kernel type: dst may be the same buffer as src */
+typedef void (*LsbEmbedFn)(char *dst, const char *src, const char *data, size_t size);
+
+/* Extract kernel type */
+typedef void (*LsbExtractFn)(char *data, const char *src, size_t size);
+
+/* LSB kernel prototypes */
+
+/* Embed size payload bytes into size * 8 carrier bytes */
+void lsb_embed(char *dst, const char *src, const char *data, size_t size);
+
+/* Extract size payload bytes from size * 8 carrier bytes */
+void lsb_extract(char *data, const char *src, size_t size);
+
+/* Embed size payload bytes at depth bits per carrier byte (1 to 4) */
+void lsb_embed_depth(char *dst, const char *src, const char *data, size_t size, int depth);
+
+/* Extract size payload bytes stored at depth bits per carrier byte (1 to 4) */
+void lsb_extract_depth(char *data, const char *src, size_t size, int depth);
+
+/* Carrier bytes used by size payload bytes at depth bits per carrier byte */
+size_t lsb_carrier_bytes(size_t size, int depth);
+
+/* Force a kernel tier by name (scalar, sse2, avx2, avx512), returns 0 on success */
+int lsb_select_kernel(const char *name);
+
+/* Name of the kernel tier in use */
+const char *lsb_kernel_name(void);
+
+#endif
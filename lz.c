@@ -0,0 +1,311 @@
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_SKIP_SHIFT 6
+
+/* Function Definitions */
+
+/* Read 4 unaligned bytes */
+static inline uint32_t lz_read32(const unsigned char *src)
+{
+	uint32_t value;
+
+	memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+/* Hash table slot of 4 bytes */
+static inline uint32_t lz_hash(uint32_t value)
+{
+	return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/* Write the extra bytes of a length that did not fit its nibble */
+static unsigned char *lz_put_length(unsigned char *out, size_t length)
+{
+	while(length >= 255)
+	{
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+/* Write one sequence
+ * Description: A match length of 0 writes the last, literals only, sequence.
+ * Input: Output position, literals and their length, match offset and length
+ * Output: Token, literals, offset and length bytes
+ * Return: Output position after the sequence
+ */
+static unsigned char *lz_put_sequence(unsigned char *out, const unsigned char *literals, size_t literal_length, size_t offset, size_t match_length)
+{
+	size_t match_code = match_length > 0 ? match_length - LZ_MIN_MATCH : 0;
+	unsigned char *token = out++;
+
+	*token = (unsigned char)((literal_length < 15 ? literal_length : 15) << 4 | (match_code < 15 ? match_code : 15));
+	if(literal_length >= 15)
+	{
+		out = lz_put_length(out, literal_length - 15);
+	}
+	memcpy(out, literals, literal_length);
+	out += literal_length;
+
+	if(match_length > 0)
+	{
+		*out++ = (unsigned char)(offset & 0xff);
+		*out++ = (unsigned char)(offset >> 8);
+		if(match_code >= 15)
+		{
+			out = lz_put_length(out, match_code - 15);
+		}
+	}
+	return out;
+}
+
+/* Compress a block
+ * Description: Greedy single probe hash matcher. The search step grows
+ * while no match is found, so incompressible data passes quickly.
+ * Input: Output buffer of LZ_BLOCK_BOUND(size) bytes, data, data size
+ * Output: Compressed block
+ * Return: Compressed size
+ */
+size_t lz_compress_block(char *dst, const char *src, size_t size)
+{
+	const unsigned char *in = (const unsigned char *)src;
+	unsigned char *out = (unsigned char *)dst;
+	uint32_t table[1 << LZ_HASH_BITS];
+	size_t anchor = 0, pos = 0;
+
+	memset(table, 0, sizeof(table));
+	while(pos + LZ_MIN_MATCH <= size)
+	{
+		uint32_t sequence = lz_read32(in + pos);
+		uint32_t slot = lz_hash(sequence);
+		size_t ref = table[slot];
+
+		table[slot] = (uint32_t)pos;
+		if(ref < pos && pos - ref <= LZ_MAX_OFFSET && lz_read32(in + ref) == sequence)
+		{
+			size_t length = LZ_MIN_MATCH;
+
+			while(pos + length < size && in[ref + length] == in[pos + length])
+			{
+				length++;
+			}
+			out = lz_put_sequence(out, in + anchor, pos - anchor, pos - ref, length);
+			pos += length;
+			anchor = pos;
+		}
+		else
+		{
+			pos += 1 + ((pos - anchor) >> LZ_SKIP_SHIFT);
+		}
+	}
+	out = lz_put_sequence(out, in + anchor, size - anchor, 0, 0);
+
+	return out - (unsigned char *)dst;
+}
+
+/* Read the extra bytes of a length, returns 0 if the input ends first */
+static int lz_get_length(const unsigned char **in, const unsigned char *end, size_t *length)
+{
+	unsigned char byte;
+
+	do
+	{
+		if(*in >= end)
+		{
+			return 0;
+		}
+		byte = *(*in)++;
+		*length += byte;
+	} while(byte == 255);
+	return 1;
+}
+
+/* Decompress a block
+ * Description: Every length and offset is checked against the input and
+ * the output capacity, so corrupt blocks fail instead of overrunning.
+ * Input: Output buffer and capacity, compressed block and size
+ * Output: Decompressed data
+ * Return: Decompressed size, or -1 on a corrupt block
+ */
+long lz_decompress_block(char *dst, size_t capacity, const char *src, size_t size)
+{
+	const unsigned char *in = (const unsigned char *)src;
+	const unsigned char *end = in + size;
+	size_t out = 0;
+
+	while(in < end)
+	{
+		unsigned char token = *in++;
+		size_t literal_length = token >> 4, match_length = token & 15, offset;
+
+		//Literals.
+		if(literal_length == 15 && !lz_get_length(&in, end, &literal_length))
+		{
+			return -1;
+		}
+		if(literal_length > (size_t)(end - in) || literal_length > capacity - out)
+		{
+			return -1;
+		}
+		memcpy(dst + out, in, literal_length);
+		in += literal_length;
+		out += literal_length;
+
+		//The last sequence ends with its literals.
+		if(in == end)
+		{
+			break;
+		}
+
+		//Match, may overlap its own output.
+		if(end - in < 2)
+		{
+			return -1;
+		}
+		offset = in[0] | in[1] << 8;
+		in += 2;
+		if(match_length == 15 && !lz_get_length(&in, end, &match_length))
+		{
+			return -1;
+		}
+		match_length += LZ_MIN_MATCH;
+		if(offset == 0 || offset > out || match_length > capacity - out)
+		{
+			return -1;
+		}
+		for(size_t i = 0; i < match_length; i++, out++)
+		{
+			dst[out] = dst[out - offset];
+		}
+	}
+	return (long)out;
+}
+
+/* Frame a block
+ * Description: Blocks that do not shrink are stored as they are.
+ * Input: Output buffer of LZ_FRAME_BOUND bytes, up to LZ_BLOCK_SIZE data bytes
+ * Output: Frame header and block
+ * Return: Frame size
+ */
+size_t lz_frame_block(char *dst, const char *src, size_t size)
+{
+	size_t stored = lz_compress_block(dst + LZ_FRAME_HEADER, src, size);
+	uint32_t header = (uint32_t)stored;
+
+	if(stored >= size)
+	{
+		memcpy(dst + LZ_FRAME_HEADER, src, size);
+		stored = size;
+		header = (uint32_t)size | LZ_RAW_FRAME;
+	}
+	//Header MSB first.
+	for(int i = 0; i < LZ_FRAME_HEADER; i++)
+	{
+		dst[i] = (char)(header >> (8 * (LZ_FRAME_HEADER - 1 - i)));
+	}
+	return LZ_FRAME_HEADER + stored;
+}
+
+/* Start parsing frames
+ * Input: Stream state
+ * Output: Stream waits for a frame header
+ * Return: None
+ */
+void lz_stream_init(LzStream *stream)
+{
+	stream->header_have = 0;
+	stream->stored = 0;
+	stream->raw = 0;
+	stream->block_have = 0;
+}
+
+/* Feed frame bytes
+ * Description: Frame bytes may arrive in pieces of any size. Raw frames go
+ * straight to write, compressed frames are collected and decompressed once
+ * complete, so memory use stays at one block.
+ * Input: Stream state, frame bytes and size, sink and its argument
+ * Output: Decompressed data passed to write
+ * Return: e_success, or e_failure on corrupt frames or a failed write
+ */
+Status lz_stream_write(LzStream *stream, const char *data, size_t size, LzWriteFn write, void *arg)
+{
+	while(size > 0)
+	{
+		size_t take;
+
+		//Collect the frame header.
+		if(stream->header_have < LZ_FRAME_HEADER)
+		{
+			uint32_t header = 0;
+
+			stream->header[stream->header_have++] = (unsigned char)*data++;
+			size--;
+			if(stream->header_have < LZ_FRAME_HEADER)
+			{
+				continue;
+			}
+			for(int i = 0; i < LZ_FRAME_HEADER; i++)
+			{
+				header = header << 8 | stream->header[i];
+			}
+			stream->raw = (header & LZ_RAW_FRAME) != 0;
+			stream->stored = header & ~LZ_RAW_FRAME;
+			stream->block_have = 0;
+			if(stream->stored == 0 || stream->stored > (stream->raw ? LZ_BLOCK_SIZE : sizeof(stream->block)))
+			{
+				return e_failure;
+			}
+			continue;
+		}
+
+		take = stream->stored - stream->block_have < size ? stream->stored - stream->block_have : size;
+		if(stream->raw)
+		{
+			if(write(data, take, arg) == e_failure)
+			{
+				return e_failure;
+			}
+		}
+		else
+		{
+			memcpy(stream->block + stream->block_have, data, take);
+		}
+		stream->block_have += take;
+		data += take;
+		size -= take;
+
+		//Frame complete, wait for the next header.
+		if(stream->block_have == stream->stored)
+		{
+			if(!stream->raw)
+			{
+				long length = lz_decompress_block(stream->out, sizeof(stream->out), stream->block, stream->stored);
+
+				if(length < 0 || write(stream->out, length, arg) == e_failure)
+				{
+					return e_failure;
+				}
+			}
+			stream->header_have = 0;
+		}
+	}
+	return e_success;
+}
+
+/* Check the end of the frames
+ * Input: Stream state
+ * Output: None
+ * Return: e_success if no frame is left half read, e_failure otherwise
+ */
+Status lz_stream_finish(const LzStream *stream)
+{
+	return stream->header_have == 0 ? e_success : e_failure;
+}
@@ -0,0 +1,62 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Small LZ77 codec in the LZ4 block style for compressed payloads.
+ * A compressed payload is a sequence of frames, one per block of up to
+ * LZ_BLOCK_SIZE payload bytes. Every frame starts with a 32 bit header,
+ * MSB first: the stored length in the low 31 bits and LZ_RAW_FRAME set
+ * when the block did not shrink and is stored as is.
+ *
+ * Inside a compressed block every sequence is a token (literal length in
+ * the high nibble, match length - 4 in the low nibble, 15 meaning more
+ * length bytes follow), the literals, a 16 bit little endian offset and
+ * the extra match length bytes. The last sequence only has literals.
+ * Blocks are independent, so frames decode one at a time.
+ */
+
+#define LZ_BLOCK_SIZE (64 * 1024)
+#define LZ_BLOCK_BOUND(size) ((size) + (size) / 255 + 16)
+#define LZ_FRAME_HEADER 4
+#define LZ_FRAME_BOUND (LZ_FRAME_HEADER + LZ_BLOCK_BOUND(LZ_BLOCK_SIZE))
+#define LZ_RAW_FRAME 0x80000000U
+
+/* Sink for decompressed data */
+typedef Status (*LzWriteFn)(const char *data, size_t size, void *arg);
+
+/* Frame parser state for lz_stream_write */
+typedef struct _LzStream
+{
+    unsigned char header[LZ_FRAME_HEADER];	//Frame header collected so far.
+    size_t header_have;						//Header bytes collected.
+    size_t stored;							//Stored length of the current frame.
+    int raw;								//Current frame is stored as is.
+    size_t block_have;						//Frame bytes collected.
+    char block[LZ_BLOCK_BOUND(LZ_BLOCK_SIZE)];	//Compressed block being collected.
+    char out[LZ_BLOCK_SIZE];				//Decompressed block.
+} LzStream;
+
+/* LZ codec function prototypes */
+
+/* Compress size bytes into dst of LZ_BLOCK_BOUND(size) bytes, returns the compressed size */
+size_t lz_compress_block(char *dst, const char *src, size_t size);
+
+/* Decompress a block into dst of capacity bytes, returns the decompressed size or -1 on corrupt input */
+long lz_decompress_block(char *dst, size_t capacity, const char *src, size_t size);
+
+/* Frame up to LZ_BLOCK_SIZE bytes into dst of LZ_FRAME_BOUND bytes, returns the frame size */
+size_t lz_frame_block(char *dst, const char *src, size_t size);
+
+/* Start parsing a new sequence of frames */
+void lz_stream_init(LzStream *stream);
+
+/* Feed frame bytes in pieces of any size, decompressed blocks go to write */
+Status lz_stream_write(LzStream *stream, const char *data, size_t size, LzWriteFn write, void *arg);
+
+/* Check that the frames ended on a frame boundary */
+Status lz_stream_finish(const LzStream *stream);
+
+#endif
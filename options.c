@@ -0,0 +1,275 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+
+/* Function Definitions */
+
+/* Read a thread count
+ * Input: Option value string
+ * Output: Thread count stored in threads
+ * Return: 0 on success, -1 if it is not a number between 0 and 1024
+ */
+static int read_thread_count(const char *value, int *threads)
+{
+	char *end;
+	long count;
+
+	if(value == NULL || *value == '\0')
+	{
+		return -1;
+	}
+	count = strtol(value, &end, 10);
+	if(*end != '\0' || count < 0 || count > 1024)
+	{
+		return -1;
+	}
+	*threads = (int)count;
+	return 0;
+}
+
+/* Read a secret size
+ * Input: Option value string
+ * Output: Size stored in size
+ * Return: 0 on success, -1 if it is not a positive number
+ */
+static int read_secret_size(const char *value, long *size)
+{
+	char *end;
+
+	if(value == NULL || *value < '0' || *value > '9')
+	{
+		return -1;
+	}
+	errno = 0;
+	*size = strtol(value, &end, 10);
+	if(*end != '\0' || errno != 0 || *size <= 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/* Read a payload depth
+ * Input: Option value string
+ * Output: Depth stored in depth, 0 for auto
+ * Return: 0 on success, -1 if it is not auto or a number between 1 and 4
+ */
+static int read_depth(const char *value, int *depth)
+{
+	if(value == NULL)
+	{
+		return -1;
+	}
+	if(strcmp(value, "auto") == 0)
+	{
+		*depth = 0;
+		return 0;
+	}
+	if(value[0] < '1' || value[0] > '4' || value[1] != '\0')
+	{
+		return -1;
+	}
+	*depth = value[0] - '0';
+	return 0;
+}
+
+/* Read a hexadecimal key
+ * Input: Key text, its length
+ * Output: Key bytes stored in key
+ * Return: 0 on success, -1 unless it is 2 * CHACHA20_KEY_SIZE hex digits, optionally followed by white space
+ */
+static int read_hex_key(const char *text, size_t length, unsigned char *key)
+{
+	while(length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r' || text[length - 1] == ' ' || text[length - 1] == '\t'))
+	{
+		length--;
+	}
+	if(length != 2 * CHACHA20_KEY_SIZE)
+	{
+		return -1;
+	}
+	for(int i = 0; i < CHACHA20_KEY_SIZE; i++)
+	{
+		char digits[3] = { text[2 * i], text[2 * i + 1], '\0' };
+
+		if(!isxdigit((unsigned char)digits[0]) || !isxdigit((unsigned char)digits[1]))
+		{
+			return -1;
+		}
+		key[i] = (unsigned char)strtoul(digits, NULL, 16);
+	}
+	return 0;
+}
+
+/* Read a key file
+ * Description: The file holds the key as CHACHA20_KEY_SIZE raw bytes or
+ * as hex digits.
+ * Input: Key file name
+ * Output: Key bytes stored in key
+ * Return: 0 on success, -1 if the file cannot be read or holds no key
+ */
+static int read_key_file(const char *fname, unsigned char *key)
+{
+	char text[4 * CHACHA20_KEY_SIZE];
+	size_t length;
+	FILE *fptr;
+
+	if(fname == NULL || (fptr = fopen(fname, "rb")) == NULL)
+	{
+		return -1;
+	}
+	length = fread(text, 1, sizeof(text), fptr);
+	fclose(fptr);
+
+	if(length == CHACHA20_KEY_SIZE)
+	{
+		memcpy(key, text, CHACHA20_KEY_SIZE);
+		return 0;
+	}
+	return read_hex_key(text, length, key);
+}
+
+/* Read options from command line arguments
+ * Description: Stores every recognised option in options and removes it
+ * from argv, keeping the other arguments in order and argv NULL terminated.
+ * Input: Command line arguments
+ * Output: Options filled in, argv compacted
+ * Return: New argument count, or -1 on a malformed option
+ */
+int read_options(int argc, char *argv[], Options *options)
+{
+	int kept = 1;
+
+	//Defaults.
+	options->threads = -1;
+	options->depth = 1;
+	options->compress = 0;
+	options->crc = 0;
+	options->has_key = 0;
+	options->scatter = 0;
+	options->in_place = 0;
+	options->secret_size = -1;
+	options->quiet = 0;
+	options->stats = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		//-j N or -jN, number of threads.
+		if(strcmp(argv[i], "-j") == 0)
+		{
+			if(read_thread_count(argv[++i], &options->threads) != 0)
+			{
+				fprintf(stderr, "ERROR: -j needs a thread count\n");
+				return -1;
+			}
+		}
+		else if(strncmp(argv[i], "-j", 2) == 0)
+		{
+			if(read_thread_count(argv[i] + 2, &options->threads) != 0)
+			{
+				fprintf(stderr, "ERROR: -j needs a thread count\n");
+				return -1;
+			}
+		}
+		//-k N or -kN, payload bits per carrier byte.
+		else if(strcmp(argv[i], "-k") == 0)
+		{
+			if(read_depth(argv[++i], &options->depth) != 0)
+			{
+				fprintf(stderr, "ERROR: -k needs a depth of 1 to 4 or auto\n");
+				return -1;
+			}
+		}
+		else if(strncmp(argv[i], "-k", 2) == 0)
+		{
+			if(read_depth(argv[i] + 2, &options->depth) != 0)
+			{
+				fprintf(stderr, "ERROR: -k needs a depth of 1 to 4 or auto\n");
+				return -1;
+			}
+		}
+		//-z, compress the secret.
+		else if(strcmp(argv[i], "-z") == 0)
+		{
+			options->compress = 1;
+		}
+		//--key-file FILE, ChaCha20 key as raw bytes or hex digits.
+		else if(strcmp(argv[i], "--key-file") == 0)
+		{
+			if(read_key_file(argv[++i], options->key) != 0)
+			{
+				fprintf(stderr, "ERROR: --key-file needs a file of %d bytes or %d hex digits\n", CHACHA20_KEY_SIZE, 2 * CHACHA20_KEY_SIZE);
+				return -1;
+			}
+			options->has_key = 1;
+		}
+		//--key-env VAR, ChaCha20 key as hex digits in an environment variable.
+		else if(strcmp(argv[i], "--key-env") == 0)
+		{
+			const char *value = argv[i + 1] != NULL ? getenv(argv[++i]) : NULL;
+
+			if(value == NULL || read_hex_key(value, strlen(value), options->key) != 0)
+			{
+				fprintf(stderr, "ERROR: --key-env needs an environment variable of %d hex digits\n", 2 * CHACHA20_KEY_SIZE);
+				return -1;
+			}
+			options->has_key = 1;
+		}
+		//--scatter, scatter the payload over keyed tiles.
+		else if(strcmp(argv[i], "--scatter") == 0)
+		{
+			options->scatter = 1;
+		}
+		//--crc, store a CRC32C of the payload.
+		else if(strcmp(argv[i], "--crc") == 0)
+		{
+			options->crc = 1;
+		}
+		//--in-place, patch the source image.
+		else if(strcmp(argv[i], "--in-place") == 0)
+		{
+			options->in_place = 1;
+		}
+		//--secret-size N, bytes of the secret.
+		else if(strcmp(argv[i], "--secret-size") == 0)
+		{
+			if(read_secret_size(argv[++i], &options->secret_size) != 0)
+			{
+				fprintf(stderr, "ERROR: --secret-size needs a size in bytes\n");
+				return -1;
+			}
+		}
+		//-q, no INFO lines.
+		else if(strcmp(argv[i], "-q") == 0)
+		{
+			options->quiet = 1;
+		}
+		//--stats=json, stage timings and I/O counters.
+		else if(strncmp(argv[i], "--stats", 7) == 0)
+		{
+			if(strcmp(argv[i] + 7, "=json") != 0)
+			{
+				fprintf(stderr, "ERROR: --stats needs a format, only --stats=json is supported\n");
+				return -1;
+			}
+			options->stats = 1;
+		}
+		else
+		{
+			//Not an option, keep it.
+			argv[kept++] = argv[i];
+		}
+	}
+	argv[kept] = NULL;
+
+	//The key picks the tiles.
+	if(options->scatter && !options->has_key)
+	{
+		fprintf(stderr, "ERROR: --scatter needs --key-file or --key-env\n");
+		return -1;
+	}
+	return kept;
+}
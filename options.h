@@ -0,0 +1,32 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "chacha20.h"
+
+/*
+ * Options accepted by both -e and -d, after the file names.
+ * read_options strips them from argv so the positional
+ * arguments keep their usual places.
+ */
+
+typedef struct _Options
+{
+    int threads;							//-j N: worker threads, 0 means one per CPU, -1 if not given.
+    int depth;								//-k N: payload bits per carrier byte 1 to 4, 0 for auto, 1 if not given.
+    int compress;							//-z: compress the secret before embedding.
+    int crc;								//--crc: store a CRC32C of the payload to check on decode.
+    int has_key;							//--key-file FILE or --key-env VAR given.
+    unsigned char key[CHACHA20_KEY_SIZE];	//ChaCha20 key, encrypts on -e and decrypts on -d.
+    int scatter;							//--scatter: scatter the payload over keyed tiles of the image, needs a key.
+    int in_place;							//--in-place: encode into the source image itself.
+    long secret_size;						//--secret-size N: bytes of the secret to encode, needed when it is read from a pipe, -1 if not given.
+    int quiet;								//-q: no INFO lines.
+    int stats;								//--stats=json: print stage timings and I/O counters as JSON.
+} Options;
+
+/* Options function prototype */
+
+/* Read and strip options from argv, returns the remaining argc or -1 on error */
+int read_options(int argc, char *argv[], Options *options);
+
+#endif
@@ -0,0 +1,172 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "pipeline.h"
+
+#define PIPELINE_STAGES 3
+
+/* Ring shared by the stages */
+typedef struct _Pipeline
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;					//Signalled whenever a stage finishes a slot or fails.
+	PipelineSlot slots[PIPELINE_SLOTS];
+	unsigned long done[PIPELINE_STAGES];	//Slots finished by every stage so far.
+	int failed;								//Set when any stage fails, stops the others.
+	PipelineStage stages[PIPELINE_STAGES];	//Read, process and write.
+	void *arg;
+} Pipeline;
+
+/* Stage thread argument */
+typedef struct _PipelineStageArg
+{
+	Pipeline *pipeline;
+	int stage;
+} PipelineStageArg;
+
+/* Function Definitions */
+
+/* Check whether a stage has a slot to work on, called with the lock held */
+static int pipeline_ready(const Pipeline *pipeline, int stage)
+{
+	//The reader needs a slot the writer is done with, the others the slot before them is done with.
+	if(stage == 0)
+	{
+		return pipeline->done[0] - pipeline->done[PIPELINE_STAGES - 1] < PIPELINE_SLOTS;
+	}
+	return pipeline->done[stage] < pipeline->done[stage - 1];
+}
+
+/* Run one stage
+ * Description: Takes the slots in ring order. The empty slot that ends
+ * the run is passed on without calling the later stages on it.
+ * Input: Pipeline, stage index
+ * Output: Slots worked on
+ * Return: None
+ */
+static void pipeline_stage(Pipeline *pipeline, int stage)
+{
+	for(;;)
+	{
+		PipelineSlot *slot;
+		Status status = e_success;
+		int last;
+
+		pthread_mutex_lock(&pipeline->lock);
+		while(!pipeline->failed && !pipeline_ready(pipeline, stage))
+		{
+			pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+		}
+		if(pipeline->failed)
+		{
+			pthread_mutex_unlock(&pipeline->lock);
+			return;
+		}
+		slot = &pipeline->slots[pipeline->done[stage] % PIPELINE_SLOTS];
+		pthread_mutex_unlock(&pipeline->lock);
+
+		if(stage == 0 || slot->size > 0)
+		{
+			status = pipeline->stages[stage](pipeline->arg, slot);
+		}
+		last = slot->size == 0;
+
+		pthread_mutex_lock(&pipeline->lock);
+		if(status == e_failure)
+		{
+			pipeline->failed = 1;
+		}
+		else
+		{
+			pipeline->done[stage]++;
+		}
+		pthread_cond_broadcast(&pipeline->changed);
+		pthread_mutex_unlock(&pipeline->lock);
+
+		if(status == e_failure || last)
+		{
+			return;
+		}
+	}
+}
+
+/* Stage thread entry */
+static void *pipeline_thread(void *arg)
+{
+	PipelineStageArg *stage_arg = arg;
+
+	pipeline_stage(stage_arg->pipeline, stage_arg->stage);
+	return NULL;
+}
+
+/* Run a pipeline
+ * Description: The reader and the processor get their own threads, the
+ * caller writes. Every slot holds data_size secret bytes and 8 carrier
+ * bytes for each of them.
+ * Input: Stage functions and their argument, secret bytes per slot
+ * Output: Every chunk read is processed and written
+ * Return: e_success, or e_failure if any stage failed
+ */
+Status pipeline_run(PipelineStage read, PipelineStage process, PipelineStage write, void *arg, size_t data_size)
+{
+	Pipeline pipeline;
+	PipelineStageArg stage_args[PIPELINE_STAGES - 1];
+	pthread_t threads[PIPELINE_STAGES - 1];
+	int started = 0, slots = 0;
+
+	pthread_mutex_init(&pipeline.lock, NULL);
+	pthread_cond_init(&pipeline.changed, NULL);
+	pipeline.failed = 0;
+	pipeline.stages[0] = read;
+	pipeline.stages[1] = process;
+	pipeline.stages[2] = write;
+	pipeline.arg = arg;
+	for(int i = 0; i < PIPELINE_STAGES; i++)
+	{
+		pipeline.done[i] = 0;
+	}
+
+	//Reusable buffers of the ring.
+	for(; slots < PIPELINE_SLOTS; slots++)
+	{
+		pipeline.slots[slots].data = malloc(data_size);
+		pipeline.slots[slots].image = malloc(CARRIER_SPAN_MAX(data_size * 8));
+		if(pipeline.slots[slots].data == NULL || pipeline.slots[slots].image == NULL)
+		{
+			free(pipeline.slots[slots].data);
+			free(pipeline.slots[slots].image);
+			pipeline.failed = 1;
+			break;
+		}
+	}
+
+	//Reader and processor threads, the caller is the writer.
+	for(; slots == PIPELINE_SLOTS && started < PIPELINE_STAGES - 1; started++)
+	{
+		stage_args[started].pipeline = &pipeline;
+		stage_args[started].stage = started;
+		if(pthread_create(&threads[started], NULL, pipeline_thread, &stage_args[started]) != 0)
+		{
+			pthread_mutex_lock(&pipeline.lock);
+			pipeline.failed = 1;
+			pthread_cond_broadcast(&pipeline.changed);
+			pthread_mutex_unlock(&pipeline.lock);
+			break;
+		}
+	}
+	//Returns at once if anything above failed.
+	pipeline_stage(&pipeline, PIPELINE_STAGES - 1);
+	for(int i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for(int i = 0; i < slots; i++)
+	{
+		free(pipeline.slots[i].data);
+		free(pipeline.slots[i].image);
+	}
+	pthread_cond_destroy(&pipeline.changed);
+	pthread_mutex_destroy(&pipeline.lock);
+
+	return pipeline.failed ? e_failure : e_success;
+}
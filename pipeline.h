@@ -0,0 +1,35 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+#include "carrier.h"
+
+/*
+ * Three stage pipeline: a reader, a processor and a writer thread pass
+ * a bounded ring of reusable chunk buffers along, so reading, embedding
+ * or extracting, and writing overlap instead of taking turns.
+ * Chunks go through every stage in order.
+ */
+
+#define PIPELINE_SLOTS 4
+#define PIPELINE_MIN_SIZE (4 * 1024 * 1024)		//Carrier bytes below which the stages just take turns.
+
+/* One chunk in flight */
+typedef struct _PipelineSlot
+{
+	char *data;								//Secret bytes of the chunk.
+	char *image;							//File bytes of the chunk, 8 carrier bytes per secret byte at most and their row padding.
+	size_t size;							//Secret bytes in the chunk, 0 from the reader ends the run.
+	size_t image_size;						//File bytes of the chunk in image.
+} PipelineSlot;
+
+/* Stage function type, works on one slot */
+typedef Status (*PipelineStage)(void *arg, PipelineSlot *slot);
+
+/* Pipeline function prototype */
+
+/* Run read, process and write over slots of data_size secret bytes until read returns an empty slot */
+Status pipeline_run(PipelineStage read, PipelineStage process, PipelineStage write, void *arg, size_t data_size);
+
+#endif
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "encode.h"
+#include "scan.h"
+#include "stego.h"
+#include "thread_pool.h"
+#include "types.h"
+
+/* Directories waiting to be read, shared by the workers */
+typedef struct _Scan
+{
+	pthread_mutex_t lock;
+	pthread_cond_t wake;					//Signalled when a directory is queued or the walk ends.
+	char **dirs;							//Queued directory paths.
+	int count;								//Number of queued directories.
+	int capacity;
+	int busy;								//Workers reading a directory.
+
+	unsigned long dirs_read;				//Directories read.
+	unsigned long files_checked;			//Image files checked.
+	unsigned long hits;						//Files carrying a payload.
+	unsigned long errors;					//Unreadable files and directories.
+} Scan;
+
+/* Function Definitions */
+
+/* Monotonic clock in milliseconds */
+static double scan_now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* Queue a directory, takes ownership of path */
+static void scan_push(Scan *scan, char *path)
+{
+	pthread_mutex_lock(&scan->lock);
+	if(scan->count == scan->capacity)
+	{
+		int capacity = scan->capacity ? scan->capacity * 2 : 64;
+		char **dirs = realloc(scan->dirs, capacity * sizeof(char *));
+
+		if(dirs == NULL)
+		{
+			__atomic_fetch_add(&scan->errors, 1, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&scan->lock);
+			free(path);
+			return;
+		}
+		scan->dirs = dirs;
+		scan->capacity = capacity;
+	}
+	scan->dirs[scan->count++] = path;
+	pthread_cond_signal(&scan->wake);
+	pthread_mutex_unlock(&scan->lock);
+}
+
+/* Take the next directory
+ * Description: Waits while the queue is empty but other workers may still
+ * queue subdirectories. The walk is over once nothing is queued and no
+ * worker is busy.
+ * Input: Scan state
+ * Output: The caller counts as busy until scan_done
+ * Return: Directory path to free, or NULL when the walk is over
+ */
+static char *scan_pop(Scan *scan)
+{
+	char *path = NULL;
+
+	pthread_mutex_lock(&scan->lock);
+	while(scan->count == 0 && scan->busy > 0)
+	{
+		pthread_cond_wait(&scan->wake, &scan->lock);
+	}
+	if(scan->count > 0)
+	{
+		path = scan->dirs[--scan->count];
+		scan->busy++;
+	}
+	else
+	{
+		//Wake the other waiting workers, they are done too.
+		pthread_cond_broadcast(&scan->wake);
+	}
+	pthread_mutex_unlock(&scan->lock);
+	return path;
+}
+
+/* Finish a directory taken with scan_pop */
+static void scan_done(Scan *scan)
+{
+	pthread_mutex_lock(&scan->lock);
+	scan->busy--;
+	if(scan->busy == 0 && scan->count == 0)
+	{
+		pthread_cond_broadcast(&scan->wake);
+	}
+	pthread_mutex_unlock(&scan->lock);
+}
+
+/* Read the stego header of an open image file
+ * Description: Reads the front of the file with one pread. The header
+ * fields sit at the pixel data, a second small pread fetches them when
+ * a large palette, ICC profile or ID field puts the pixels past the
+ * first read.
+ * Input: Open image file
+ * Output: Header fields and image layout in header, *unreadable set when a read fails
+ * Return: e_success, or e_failure if the file is unreadable or holds no valid payload
+ */
+Status scan_read_header(int fd, StegoHeader *header, int *unreadable)
+{
+	char prefix[STEGO_HEADER_SPAN];
+	size_t fields_span = CARRIER_SPAN_MAX(STEGO_FIELDS_SPAN), data_offset;
+	struct stat file_stat;
+	ssize_t nread = pread(fd, prefix, sizeof(prefix), 0);
+
+	*unreadable = nread < 0 || fstat(fd, &file_stat) != 0;
+	if(*unreadable || carrier_parse(&header->carrier, prefix, nread, NULL) == e_failure || carrier_fits(&header->carrier, file_stat.st_size) == e_failure)
+	{
+		return e_failure;
+	}
+	data_offset = header->carrier.data_offset;
+	if(data_offset <= (size_t)nread && (size_t)nread - data_offset >= fields_span)
+	{
+		return stego_parse_fields(prefix + data_offset, nread - data_offset, header);
+	}
+	nread = pread(fd, prefix, fields_span, data_offset);
+	*unreadable = nread < 0;
+	if(*unreadable)
+	{
+		return e_failure;
+	}
+	return stego_parse_fields(prefix, nread, header);
+}
+
+/* Check one file
+ * Description: Reads the stego header with scan_read_header, readahead
+ * is turned off so no more than those pages come in from disk.
+ * Input: Scan state, directory descriptor, file name, path for the report
+ * Output: Report line when the file carries a payload
+ * Return: None
+ */
+static void scan_file(Scan *scan, int dir_fd, const char *name, const char *path)
+{
+	StegoHeader header;
+	int unreadable;
+	int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+
+	if(fd < 0)
+	{
+		__atomic_fetch_add(&scan->errors, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_fetch_add(&scan->files_checked, 1, __ATOMIC_RELAXED);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+	if(scan_read_header(fd, &header, &unreadable) == e_success)
+	{
+		char stripe[48] = "";
+
+		__atomic_fetch_add(&scan->hits, 1, __ATOMIC_RELAXED);
+		if(header.striped)
+		{
+			snprintf(stripe, sizeof(stripe), "\tstripe %u/%u of %08x", header.stripe.index + 1, header.stripe.count, header.stripe.id);
+		}
+		printf("%s\t%s\t%s\t%llu bytes\tdepth %d%s%s%s%s%s\n", path, carrier_format_name(&header.carrier), header.extn, (unsigned long long)header.size, header.depth, header.compressed ? "\tcompressed" : "", header.crc ? "\tcrc32c" : "", header.encrypted ? "\tencrypted" : "", header.scatter ? "\tscattered" : "", stripe);
+	}
+	else if(unreadable)
+	{
+		__atomic_fetch_add(&scan->errors, 1, __ATOMIC_RELAXED);
+	}
+	close(fd);
+}
+
+/* Read one directory
+ * Description: Queues the subdirectories for any worker and checks the
+ * image files right away. Symbolic links are not followed.
+ * Input: Scan state, directory path
+ * Output: Subdirectories queued, hits reported
+ * Return: None
+ */
+static void scan_dir(Scan *scan, const char *dir_path)
+{
+	DIR *dir = opendir(dir_path);
+	struct dirent *entry;
+
+	if(dir == NULL)
+	{
+		__atomic_fetch_add(&scan->errors, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_fetch_add(&scan->dirs_read, 1, __ATOMIC_RELAXED);
+
+	while((entry = readdir(dir)) != NULL)
+	{
+		unsigned char type = entry->d_type;
+		char *path;
+
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+		{
+			continue;
+		}
+		//Some filesystems leave the type to lstat.
+		if(type == DT_UNKNOWN)
+		{
+			struct stat entry_stat;
+
+			if(fstatat(dirfd(dir), entry->d_name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0)
+			{
+				continue;
+			}
+			type = S_ISDIR(entry_stat.st_mode) ? DT_DIR : S_ISREG(entry_stat.st_mode) ? DT_REG : DT_UNKNOWN;
+		}
+		if(type != DT_DIR && (type != DT_REG || !carrier_image_name(entry->d_name)))
+		{
+			continue;
+		}
+
+		if(asprintf(&path, "%s/%s", dir_path, entry->d_name) < 0)
+		{
+			__atomic_fetch_add(&scan->errors, 1, __ATOMIC_RELAXED);
+			continue;
+		}
+		if(type == DT_DIR)
+		{
+			scan_push(scan, path);
+		}
+		else
+		{
+			scan_file(scan, dirfd(dir), entry->d_name, path);
+			free(path);
+		}
+	}
+	closedir(dir);
+}
+
+/* Scan worker
+ * Description: Reads queued directories until the walk is over.
+ * Input: Scan state, worker index
+ * Output: Directories read
+ * Return: None
+ */
+static void scan_worker(void *arg, int index)
+{
+	Scan *scan = arg;
+	char *dir_path;
+
+	(void)index;
+	while((dir_path = scan_pop(scan)) != NULL)
+	{
+		scan_dir(scan, dir_path);
+		free(dir_path);
+		scan_done(scan);
+	}
+}
+
+/* Scan a directory tree for stego images
+ * Description: Walks the tree on a worker pool, every worker reads whole
+ * directories and checks their image files, and prints a summary.
+ * Input: Top directory, options (threads > 0 sets the number of workers, one per CPU otherwise)
+ * Output: One report line per stego image, summary on stdout
+ * Return: e_success, or e_failure if the top directory cannot be read
+ */
+Status do_scan(const char *dir, const Options *options)
+{
+	Scan scan;
+	ThreadPool *pool;
+	char *top = strdup(dir);
+	size_t length = strlen(dir);
+	double start;
+	int workers = options->threads > 0 ? options->threads : thread_pool_cpu_count();
+
+	//Report paths without a doubled slash.
+	while(top != NULL && length > 1 && top[length - 1] == '/')
+	{
+		top[--length] = '\0';
+	}
+
+	pool = thread_pool_create(workers);
+	if(top == NULL || pool == NULL)
+	{
+		free(top);
+		thread_pool_destroy(pool);
+		return e_failure;
+	}
+	workers = thread_pool_size(pool);
+
+	memset(&scan, 0, sizeof(scan));
+	pthread_mutex_init(&scan.lock, NULL);
+	pthread_cond_init(&scan.wake, NULL);
+	scan_push(&scan, top);
+
+	printf("INFO: Scanning %s on %d workers\n", dir, workers);
+	start = scan_now_ms();
+	thread_pool_run(pool, scan_worker, &scan, workers);
+	printf("INFO: %lu of %lu image files carry a payload, %lu directories, %lu errors, %.3f ms\n", scan.hits, scan.files_checked, scan.dirs_read, scan.errors, scan_now_ms() - start);
+
+	thread_pool_destroy(pool);
+	pthread_cond_destroy(&scan.wake);
+	pthread_mutex_destroy(&scan.lock);
+	free(scan.dirs);
+
+	return scan.dirs_read > 0 ? e_success : e_failure;
+}
@@ -0,0 +1,24 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "types.h" // Contains user defined types
+#include "options.h"
+#include "stego.h"
+
+/*
+ * Stego triage: walks a directory tree and reports every .bmp file that
+ * carries a payload, one line per hit:
+ * <path> <extension> <payload size> bytes depth <k> [compressed] [crc32c] [encrypted] [scattered]
+ * Every file costs one small pread of its first STEGO_HEADER_SPAN bytes,
+ * and a second one at the pixel data when the pixels start further in.
+ */
+
+/* Scan function prototypes */
+
+/* Scan the tree under dir on -j workers, one per CPU by default */
+Status do_scan(const char *dir, const Options *options);
+
+/* Read the stego header of an open image file, *unreadable is set when a read fails */
+Status scan_read_header(int fd, StegoHeader *header, int *unreadable);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chacha20.h"
+#include "lsb.h"
+#include "scatter.h"
+
+/* Keystream offset the permutation is drawn from, far past any payload encrypted with the same key and nonce */
+#define SCATTER_STREAM_OFFSET ((uint64_t)1 << 37)
+/* Keystream bytes drawn per payload tile */
+#define SCATTER_DRAW_SIZE 16
+/* Payload tiles drawn per keystream call */
+#define SCATTER_BATCH 64
+
+/* Function Definitions */
+
+/* Build the map of a payload
+ * Description: A Fisher-Yates shuffle of the region tiles, stopped once
+ * the payload tiles are drawn, so the map only holds the tiles in use.
+ * Every draw takes SCATTER_DRAW_SIZE bytes of the ChaCha20 keystream of
+ * key and nonce: 8 for the tile, 1 for its rotation.
+ * Input: Key, nonce, image layout, first carrier byte and size of the region, carrier bytes of the stored payload
+ * Output: Map of the payload tiles
+ * Return: e_success, or e_failure if the payload does not fit the region or there is no memory
+ */
+Status scatter_init(ScatterMap *map, const unsigned char *key, const unsigned char *nonce, const Carrier *carrier, size_t region, size_t region_size, size_t carrier_size)
+{
+	size_t region_tiles = region_size / SCATTER_TILE_SIZE;
+	unsigned char stream[SCATTER_BATCH * SCATTER_DRAW_SIZE];
+	uint32_t *order;
+
+	map->count = scatter_span(carrier_size) / SCATTER_TILE_SIZE;
+	map->tiles = NULL;
+	map->carrier = carrier;
+	map->region = region;
+	//The payload keystream has to end before the draws start, a payload is at most half its carrier bytes.
+	if(map->count > region_tiles || region_tiles > UINT32_MAX || carrier_size / 2 > SCATTER_STREAM_OFFSET)
+	{
+		return e_failure;
+	}
+	order = malloc(region_tiles * sizeof(uint32_t) + 1);
+	map->tiles = malloc(map->count * sizeof(ScatterTile) + 1);
+	if(order == NULL || map->tiles == NULL)
+	{
+		free(order);
+		scatter_free(map);
+		return e_failure;
+	}
+
+	for(size_t i = 0; i < region_tiles; i++)
+	{
+		order[i] = i;
+	}
+	for(size_t i = 0; i < map->count; i++)
+	{
+		const unsigned char *draw = stream + i % SCATTER_BATCH * SCATTER_DRAW_SIZE;
+		uint64_t random = 0;
+		size_t j;
+		uint32_t tile;
+
+		if(i % SCATTER_BATCH == 0)
+		{
+			memset(stream, 0, sizeof(stream));
+			chacha20_xor(key, nonce, SCATTER_STREAM_OFFSET + i * SCATTER_DRAW_SIZE, (char *)stream, sizeof(stream));
+		}
+		//Little endian, the same map on every host.
+		for(int b = 7; b >= 0; b--)
+		{
+			random = random << 8 | draw[b];
+		}
+		j = i + random % (region_tiles - i);
+		tile = order[j];
+		order[j] = order[i];
+		order[i] = tile;
+
+		map->tiles[i].tile = tile;
+		map->tiles[i].rotate = draw[8] % SCATTER_UNITS * SCATTER_UNIT_SIZE;
+	}
+	free(order);
+
+	return e_success;
+}
+
+/* Release the map */
+void scatter_free(ScatterMap *map)
+{
+	free(map->tiles);
+	map->tiles = NULL;
+	map->count = 0;
+}
+
+/* Region bytes the payload spans
+ * Input: Carrier bytes of the stored payload
+ * Output: None
+ * Return: Carrier bytes rounded up to whole tiles
+ */
+size_t scatter_span(size_t carrier_size)
+{
+	return (carrier_size + SCATTER_TILE_SIZE - 1) / SCATTER_TILE_SIZE * SCATTER_TILE_SIZE;
+}
+
+/* Carrier byte a payload tile starts at */
+static size_t scatter_tile_pos(const ScatterMap *map, size_t index)
+{
+	return map->region + (size_t)map->tiles[index].tile * SCATTER_TILE_SIZE;
+}
+
+/* File offset of a payload tile */
+size_t scatter_tile_offset(const ScatterMap *map, size_t index)
+{
+	return carrier_offset(map->carrier, scatter_tile_pos(map, index));
+}
+
+/* File bytes of a payload tile, its row padding included */
+size_t scatter_tile_span(const ScatterMap *map, size_t index)
+{
+	return carrier_span(map->carrier, scatter_tile_pos(map, index), SCATTER_TILE_SIZE);
+}
+
+/* Payload bytes to the end of the tile
+ * Input: Carrier byte of the stored payload, payload bytes left, depth
+ * Output: None
+ * Return: Payload bytes of the tile from pos on, at most size
+ */
+size_t scatter_tile_bytes(size_t pos, size_t size, int depth)
+{
+	size_t bytes = (SCATTER_TILE_SIZE - pos % SCATTER_TILE_SIZE) * depth / 8;
+
+	return bytes < size ? bytes : size;
+}
+
+/* Carrier run of a payload tile
+ * Description: Payload tile bytes [pos, end) are rotated into the tile,
+ * the first run ends at the end of the tile or at end.
+ * Input: Tile entry, carrier byte of the payload tile, end of the range
+ * Output: Tile offset of the run in offset
+ * Return: Carrier bytes of the run
+ */
+static size_t scatter_run(const ScatterTile *entry, size_t pos, size_t end, size_t *offset)
+{
+	*offset = (pos + entry->rotate) % SCATTER_TILE_SIZE;
+	return end - pos < SCATTER_TILE_SIZE - *offset ? end - pos : SCATTER_TILE_SIZE - *offset;
+}
+
+/* Embed into one tile
+ * Description: One kernel call per run, at most two per tile (more when
+ * the tile spans padded rows). Runs split on unit boundaries, which are
+ * whole payload bytes at any depth.
+ * Input: Map, payload tile index, file bytes of the tile, carrier byte of the tile, data, data size, depth
+ * Output: Data embedded into the tile
+ * Return: None
+ */
+void scatter_embed_tile(const ScatterMap *map, size_t index, char *tile, size_t pos, const char *data, size_t size, int depth)
+{
+	size_t end = pos + lsb_carrier_bytes(size, depth), start = scatter_tile_pos(map, index), base = carrier_offset(map->carrier, start);
+
+	while(size > 0)
+	{
+		size_t offset, run = scatter_run(&map->tiles[index], pos, end, &offset);
+		size_t bytes = run * depth / 8 < size ? run * depth / 8 : size;
+		char *carrier = tile + carrier_offset(map->carrier, start + offset) - base;
+
+		carrier_embed(map->carrier, carrier, carrier, start + offset, data, bytes, depth);
+		pos += run;
+		data += bytes;
+		size -= bytes;
+	}
+}
+
+/* Extract from one tile
+ * Input: Map, payload tile index, data buffer, file bytes of the tile, carrier byte of the tile, data size, depth
+ * Output: Data rebuilt from the tile
+ * Return: None
+ */
+void scatter_extract_tile(const ScatterMap *map, size_t index, char *data, const char *tile, size_t pos, size_t size, int depth)
+{
+	size_t end = pos + lsb_carrier_bytes(size, depth), start = scatter_tile_pos(map, index), base = carrier_offset(map->carrier, start);
+
+	while(size > 0)
+	{
+		size_t offset, run = scatter_run(&map->tiles[index], pos, end, &offset);
+		size_t bytes = run * depth / 8 < size ? run * depth / 8 : size;
+
+		carrier_extract(map->carrier, data, tile + carrier_offset(map->carrier, start + offset) - base, start + offset, bytes, depth);
+		pos += run;
+		data += bytes;
+		size -= bytes;
+	}
+}
+
+/* Embed into the region
+ * Description: Tile by tile, the payload bytes of a tile are embedded
+ * before the next tile is touched.
+ * Input: Map, whole image, carrier byte of the stored payload, data, data size, depth
+ * Output: Data embedded into the region
+ * Return: None
+ */
+void scatter_embed(const ScatterMap *map, char *image, size_t pos, const char *data, size_t size, int depth)
+{
+	while(size > 0)
+	{
+		size_t index = pos / SCATTER_TILE_SIZE;
+		size_t bytes = scatter_tile_bytes(pos, size, depth);
+
+		scatter_embed_tile(map, index, image + scatter_tile_offset(map, index), pos % SCATTER_TILE_SIZE, data, bytes, depth);
+		pos = (index + 1) * SCATTER_TILE_SIZE;
+		data += bytes;
+		size -= bytes;
+	}
+}
+
+/* Extract from the region
+ * Input: Map, data buffer, whole image, carrier byte of the stored payload, data size, depth
+ * Output: Data rebuilt from the region
+ * Return: None
+ */
+void scatter_extract(const ScatterMap *map, char *data, const char *image, size_t pos, size_t size, int depth)
+{
+	while(size > 0)
+	{
+		size_t index = pos / SCATTER_TILE_SIZE;
+		size_t bytes = scatter_tile_bytes(pos, size, depth);
+
+		scatter_extract_tile(map, index, data, image + scatter_tile_offset(map, index), pos % SCATTER_TILE_SIZE, bytes, depth);
+		pos = (index + 1) * SCATTER_TILE_SIZE;
+		data += bytes;
+		size -= bytes;
+	}
+}
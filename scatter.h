@@ -0,0 +1,78 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h" // Contains user defined types
+#include "carrier.h"
+
+/*
+ * Keyed scattering of the payload over the carrier.
+ * The carrier bytes after the header fields (the region) are cut into
+ * SCATTER_TILE_SIZE tiles. A keyed permutation picks the tile of every
+ * SCATTER_TILE_SIZE carrier bytes of the stored payload, and a keyed
+ * rotation of the SCATTER_UNIT_SIZE units inside it moves where in the
+ * tile the payload starts. Inside a page the payload is still at most two
+ * sequential runs of whole cache lines, so embedding stays close to the
+ * sequential speed.
+ *
+ * A tile holds SCATTER_TILE_SIZE * depth / 8 payload bytes and a unit
+ * SCATTER_UNIT_SIZE * depth / 8, whole bytes at any depth, so spans that
+ * start on a multiple of LSB_DEPTH_ALIGN payload bytes never split a byte.
+ * Tiles are counted in carrier bytes (carrier.h), in a padded image a tile
+ * spans a little more of the file.
+ */
+
+#define SCATTER_TILE_SIZE 4096
+#define SCATTER_UNIT_SIZE 64
+#define SCATTER_UNITS (SCATTER_TILE_SIZE / SCATTER_UNIT_SIZE)
+
+/* Where one tile of the stored payload goes */
+typedef struct _ScatterTile
+{
+    uint32_t tile;							//Tile of the region.
+    uint32_t rotate;						//Carrier byte pos of the payload tile goes to (pos + rotate) % SCATTER_TILE_SIZE, whole units.
+} ScatterTile;
+
+/* Tile permutation of one payload */
+typedef struct _ScatterMap
+{
+    size_t count;							//Tiles the payload uses.
+    ScatterTile *tiles;						//Where every payload tile goes.
+    const Carrier *carrier;					//Layout of the image.
+    size_t region;							//Carrier byte the region starts at.
+} ScatterMap;
+
+/* Scatter function prototypes */
+
+/* Build the map of a payload of carrier_size carrier bytes in a region of region_size carrier bytes from carrier byte region on */
+Status scatter_init(ScatterMap *map, const unsigned char *key, const unsigned char *nonce, const Carrier *carrier, size_t region, size_t region_size, size_t carrier_size);
+
+/* Release the map */
+void scatter_free(ScatterMap *map);
+
+/* Region bytes the payload of carrier_size carrier bytes spans, whole tiles */
+size_t scatter_span(size_t carrier_size);
+
+/* File offset of payload tile index */
+size_t scatter_tile_offset(const ScatterMap *map, size_t index);
+
+/* File bytes of payload tile index, at most CARRIER_SPAN_MAX(SCATTER_TILE_SIZE) */
+size_t scatter_tile_span(const ScatterMap *map, size_t index);
+
+/* Embed size bytes into payload tile index (its file bytes) from carrier byte pos of the tile, the bytes have to end inside it */
+void scatter_embed_tile(const ScatterMap *map, size_t index, char *tile, size_t pos, const char *data, size_t size, int depth);
+
+/* Extract size bytes from payload tile index (its file bytes) from carrier byte pos of the tile, the bytes have to end inside it */
+void scatter_extract_tile(const ScatterMap *map, size_t index, char *data, const char *tile, size_t pos, size_t size, int depth);
+
+/* Embed size bytes from carrier byte pos of the stored payload into the whole image */
+void scatter_embed(const ScatterMap *map, char *image, size_t pos, const char *data, size_t size, int depth);
+
+/* Extract size bytes from carrier byte pos of the stored payload in the whole image */
+void scatter_extract(const ScatterMap *map, char *data, const char *image, size_t pos, size_t size, int depth);
+
+/* Payload bytes from carrier byte pos of the stored payload to the end of its tile, at most size */
+size_t scatter_tile_bytes(size_t pos, size_t size, int depth);
+
+#endif
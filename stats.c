@@ -0,0 +1,161 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+/* JSON names of the stages */
+static const char *stats_stage_names[e_stage_count] = { "open", "compress", "capacity", "header", "magic", "extension", "size", "payload", "tail" };
+
+/* Function Definitions */
+
+/* Take the process wide counters
+ * Description: The counters read from /proc/self/io are as they were
+ * before this read, the read itself shows up at the next sample.
+ * Input: Stats
+ * Output: Counters stored in sample, bytes read from /proc/self/io in io_size
+ * Return: None
+ */
+static void stats_sample(const Stats *stats, StatsSample *sample, size_t *io_size)
+{
+	struct timespec now;
+	struct rusage usage;
+	char buffer[512];
+	ssize_t nread;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	sample->ms = now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+	getrusage(RUSAGE_SELF, &usage);
+	sample->faults = usage.ru_minflt + usage.ru_majflt;
+
+	sample->rchar = sample->wchar = sample->syscr = sample->syscw = 0;
+	*io_size = 0;
+	if(stats->io_fd < 0)
+	{
+		return;
+	}
+	nread = pread(stats->io_fd, buffer, sizeof(buffer) - 1, 0);
+	if(nread <= 0)
+	{
+		return;
+	}
+	buffer[nread] = '\0';
+	*io_size = nread;
+	sscanf(buffer, "rchar: %llu wchar: %llu syscr: %llu syscw: %llu", &sample->rchar, &sample->wchar, &sample->syscr, &sample->syscw);
+}
+
+/* Start recording
+ * Input: Stats
+ * Output: Stats cleared, /proc/self/io opened if the kernel accounts I/O
+ * Return: None
+ */
+void stats_init(Stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->io_fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+	stats->stage = -1;
+}
+
+/* Mark a stage
+ * Description: Charges everything since the last mark to the current
+ * stage, less the read of /proc/self/io done at that mark, and makes
+ * stage the current one. A stage marked again keeps adding up.
+ * Input: Stats or NULL, next stage
+ * Output: Counters of the current stage
+ * Return: None
+ */
+void stats_stage(Stats *stats, StatsStage stage)
+{
+	StatsSample now;
+	size_t io_size;
+
+	if(stats == NULL)
+	{
+		return;
+	}
+	stats_sample(stats, &now, &io_size);
+
+	if(stats->stage >= 0)
+	{
+		StageStats *current = &stats->stages[stats->stage];
+		int own_read = stats->last_io_size > 0;
+
+		current->ms += now.ms - stats->last.ms;
+		current->bytes_read += now.rchar - stats->last.rchar - stats->last_io_size;
+		current->bytes_written += now.wchar - stats->last.wchar;
+		current->reads += now.syscr - stats->last.syscr - own_read;
+		current->writes += now.syscw - stats->last.syscw;
+		current->page_faults += now.faults - stats->last.faults;
+	}
+
+	stats->last = now;
+	stats->last_io_size = io_size;
+	stats->stage = stage;
+	if((int)stage >= 0 && stage < e_stage_count)
+	{
+		stats->stages[stage].ran = 1;
+	}
+	else
+	{
+		stats->stage = -1;
+	}
+}
+
+/* End the current stage */
+void stats_end(Stats *stats)
+{
+	stats_stage(stats, e_stage_count);
+}
+
+/* Write the stages as JSON
+ * Description: One line, the stages that ran in run order. The I/O fields
+ * are null when the kernel does not account I/O.
+ * Input: Stats, output file, operation name, result of the run
+ * Output: JSON line
+ * Return: None
+ */
+void stats_print_json(const Stats *stats, FILE *fptr, const char *op, Status status)
+{
+	double total = 0;
+
+	for(int i = 0; i < e_stage_count; i++)
+	{
+		total += stats->stages[i].ms;
+	}
+
+	fprintf(fptr, "{\"op\":\"%s\",\"status\":\"%s\",\"ms\":%.4f,\"stages\":[", op, status == e_success ? "success" : "failure", total);
+	for(int i = 0, first = 1; i < e_stage_count; i++)
+	{
+		const StageStats *stage = &stats->stages[i];
+
+		if(!stage->ran)
+		{
+			continue;
+		}
+		fprintf(fptr, "%s{\"stage\":\"%s\",\"ms\":%.4f,", first ? "" : ",", stats_stage_names[i], stage->ms);
+		if(stats->io_fd >= 0)
+		{
+			fprintf(fptr, "\"bytes_read\":%llu,\"bytes_written\":%llu,\"reads\":%llu,\"writes\":%llu,", stage->bytes_read, stage->bytes_written, stage->reads, stage->writes);
+		}
+		else
+		{
+			fprintf(fptr, "\"bytes_read\":null,\"bytes_written\":null,\"reads\":null,\"writes\":null,");
+		}
+		fprintf(fptr, "\"page_faults\":%llu}", stage->page_faults);
+		first = 0;
+	}
+	fprintf(fptr, "]}\n");
+	fflush(fptr);
+}
+
+/* Stop recording */
+void stats_close(Stats *stats)
+{
+	if(stats->io_fd >= 0)
+	{
+		close(stats->io_fd);
+		stats->io_fd = -1;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Per stage timings and I/O counters of one encode or decode.
+ * Stages are marked as the run moves on, each mark costs a clock read,
+ * a getrusage and one pread of /proc/self/io, nothing is counted on the
+ * data path. The I/O counters are the read and write system calls of
+ * the whole process (every thread), so stdio buffering shows as it is;
+ * the memory mapped engine moves its data through page faults instead.
+ */
+
+/* Stages in run order */
+typedef enum
+{
+	e_stage_open,
+	e_stage_compress,
+	e_stage_capacity,
+	e_stage_header,
+	e_stage_magic,
+	e_stage_extn,
+	e_stage_size,
+	e_stage_payload,
+	e_stage_tail,
+	e_stage_count
+} StatsStage;
+
+/* Counters of one stage */
+typedef struct _StageStats
+{
+	int ran;								//Non zero once the stage was entered.
+	double ms;								//Wall time.
+	unsigned long long bytes_read;			//Bytes returned by read system calls.
+	unsigned long long bytes_written;		//Bytes passed to write system calls.
+	unsigned long long reads;				//Read system calls.
+	unsigned long long writes;				//Write system calls.
+	unsigned long long page_faults;			//Minor and major page faults.
+} StageStats;
+
+/* Process wide counters at a stage mark */
+typedef struct _StatsSample
+{
+	double ms;
+	unsigned long long rchar, wchar, syscr, syscw, faults;
+} StatsSample;
+
+/* Recording of one run */
+typedef struct _Stats
+{
+	int io_fd;								//Open /proc/self/io, -1 without I/O accounting.
+	int stage;								//Stage being timed, -1 before the first mark and after the end.
+	StatsSample last;						//Counters at the last mark.
+	size_t last_io_size;					//Bytes the last mark read from /proc/self/io.
+	StageStats stages[e_stage_count];
+} Stats;
+
+/* Stats function prototype */
+
+/* Start recording */
+void stats_init(Stats *stats);
+
+/* End the current stage and start the next one, does nothing if stats is NULL */
+void stats_stage(Stats *stats, StatsStage stage);
+
+/* End the current stage, does nothing if stats is NULL */
+void stats_end(Stats *stats);
+
+/* Write the stages run as one line of JSON */
+void stats_print_json(const Stats *stats, FILE *fptr, const char *op, Status status);
+
+/* Stop recording */
+void stats_close(Stats *stats);
+
+#endif
@@ -0,0 +1,703 @@
+#include <string.h>
+#include <sys/random.h>
+#include "stego.h"
+#include "lsb.h"
+#include "common.h"
+#include "chacha20.h"
+#include "crc32c.h"
+#include "scatter.h"
+#include "types.h"
+
+/* Payload bytes per block when the payload is checked or encrypted, multiple of LSB_DEPTH_ALIGN */
+#define STEGO_BLOCK (16 * 1024 - 16 * 1024 % LSB_DEPTH_ALIGN)
+
+/* Function Definitions */
+
+/* Embed bytes
+ * Description: size payload bytes go MSB first into the low depth bits of
+ * lsb_carrier_bytes(size, depth) carrier bytes, row padding is skipped.
+ * Input: Image layout, destination and source file bytes from carrier byte pos on, data, data size, depth
+ * Output: Carrier bytes with the data in their low bits
+ * Return: None
+ */
+void stego_embed_bytes(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth)
+{
+	carrier_embed(carrier, dst, src, pos, data, size, depth);
+}
+
+/* Embed a size field
+ * Description: The size goes MSB first into the lsb of 32 carrier bytes.
+ * Input: Image layout, destination and source file bytes from carrier byte pos on, size
+ * Output: Carrier bytes with the size in their lsb
+ * Return: None
+ */
+void stego_embed_size(const Carrier *carrier, char *dst, const char *src, size_t pos, uint size)
+{
+	char bytes[4] = { size >> 24, size >> 16, size >> 8, size };
+
+	carrier_embed(carrier, dst, src, pos, bytes, 4, 1);
+}
+
+/* Extract bytes
+ * Input: Image layout, data buffer, file bytes from carrier byte pos on, data size, depth
+ * Output: size bytes rebuilt from the low depth bits of the carrier bytes
+ * Return: None
+ */
+void stego_extract_bytes(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth)
+{
+	carrier_extract(carrier, data, src, pos, size, depth);
+}
+
+/* Extension size field
+ * Input: Extension size, format fields (depth, compressed, crc, encrypted, scatter, striped and large) of the payload
+ * Output: None
+ * Return: Field with the extension size in the low byte and the format flags above it
+ */
+uint stego_extn_field(size_t extn_size, const StegoHeader *format)
+{
+	uint field = (uint)extn_size | (uint)(format->depth - 1) << DEPTH_SHIFT;
+
+	if(format->compressed)
+	{
+		field |= COMPRESSED_FLAG;
+	}
+	if(format->crc)
+	{
+		field |= CRC_FLAG;
+	}
+	if(format->encrypted)
+	{
+		field |= ENCRYPTED_FLAG;
+	}
+	if(format->scatter)
+	{
+		field |= SCATTER_FLAG;
+	}
+	if(format->striped)
+	{
+		field |= STRIPED_FLAG;
+	}
+	if(format->large)
+	{
+		field |= LARGE_FLAG;
+	}
+	return field;
+}
+
+/* Split an extension size field
+ * Description: Images written before the flags existed have none set and
+ * read as an uncompressed payload at depth 1.
+ * Input: Field as stored in the image
+ * Output: Extension size, format fields in header
+ * Return: e_success, or e_failure on unknown flags, a too long extension or scattering without encryption
+ */
+Status stego_parse_extn_field(uint field, uint *extn_size, StegoHeader *header)
+{
+	if((field & ~KNOWN_FORMAT_BITS) != 0 || (field & EXTN_SIZE_MASK) > STEGO_MAX_EXTN || (field & (SCATTER_FLAG | ENCRYPTED_FLAG)) == SCATTER_FLAG)
+	{
+		return e_failure;
+	}
+	*extn_size = field & EXTN_SIZE_MASK;
+	header->depth = ((field & DEPTH_MASK) >> DEPTH_SHIFT) + 1;
+	header->compressed = (field & COMPRESSED_FLAG) != 0;
+	header->crc = (field & CRC_FLAG) != 0;
+	header->encrypted = (field & ENCRYPTED_FLAG) != 0;
+	header->scatter = (field & SCATTER_FLAG) != 0;
+	header->striped = (field & STRIPED_FLAG) != 0;
+	header->large = (field & LARGE_FLAG) != 0;
+
+	return e_success;
+}
+
+/* Extract a size field
+ * Input: Image layout, file bytes from carrier byte pos on
+ * Output: None
+ * Return: Size rebuilt MSB first from the lsb of 32 carrier bytes
+ */
+uint stego_extract_size(const Carrier *carrier, const char *src, size_t pos)
+{
+	unsigned char bytes[4];
+
+	carrier_extract(carrier, (char *)bytes, src, pos, 4, 1);
+	return (uint)bytes[0] << 24 | (uint)bytes[1] << 16 | (uint)bytes[2] << 8 | bytes[3];
+}
+
+/* Width of the size fields
+ * Description: Payloads under 4 GB keep 32 bit size fields, so their
+ * images read the same as before LARGE_FLAG existed.
+ * Input: Payload size, stripe fields or NULL
+ * Output: None
+ * Return: LARGE_FLAG or 0
+ */
+uint stego_large_flag(uint64_t payload_size, const StegoStripe *stripe)
+{
+	if(payload_size > STEGO_SIZE32_MAX || (stripe != NULL && stripe->total > STEGO_SIZE32_MAX))
+	{
+		return LARGE_FLAG;
+	}
+	return 0;
+}
+
+/* Carrier bytes needed to hold a payload
+ * Input: Payload file extension, payload size, depth, format flags
+ * Output: None
+ * Return: 8 carrier bytes per byte of magic string, sizes, extension,
+ * stripe fields (STRIPED_FLAG) and nonce (ENCRYPTED_FLAG), the carrier
+ * bytes of the payload at depth bits per byte (whole tiles with
+ * SCATTER_FLAG) and of the CRC32C (CRC_FLAG)
+ */
+size_t stego_required_size(const char *extn, size_t payload_size, int depth, uint flags)
+{
+	size_t size = 8 * (strlen(MAGIC_STRING) + 4 + strlen(extn)) + STEGO_SIZE_SPAN(flags);
+
+	if(flags & SCATTER_FLAG)
+	{
+		size += scatter_span(lsb_carrier_bytes(payload_size, depth));
+	}
+	else
+	{
+		size += lsb_carrier_bytes(payload_size, depth);
+	}
+	if(flags & STRIPED_FLAG)
+	{
+		size += STEGO_STRIPE_SPAN(flags);
+	}
+	if(flags & ENCRYPTED_FLAG)
+	{
+		size += 8 * STEGO_NONCE_SIZE;
+	}
+	if(flags & CRC_FLAG)
+	{
+		size += STEGO_CRC_SPAN;
+	}
+	return size;
+}
+
+/* Largest payload that fits
+ * Description: Binary search over stego_required_size, so whole scatter
+ * tiles and every field are counted the same way as when embedding.
+ * Input: Carrier size, payload file extension, depth, format flags
+ * Output: None
+ * Return: Payload bytes, 0 if not even the fields fit
+ */
+size_t stego_payload_capacity(size_t carrier_size, const char *extn, int depth, uint flags)
+{
+	size_t low = 0, high = carrier_size * depth / 8 + 1;
+
+	if(stego_required_size(extn, 0, depth, flags) > carrier_size)
+	{
+		return 0;
+	}
+	//stego_required_size(low) fits, stego_required_size(high) does not.
+	while(high - low > 1)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if(stego_required_size(extn, middle, depth, flags) <= carrier_size)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+/* Region of a scattered payload
+ * Description: Every whole tile between the header fields and the
+ * CRC32C (if any) at the end of the carrier.
+ * Input: Carrier size, carrier offset of the region, non zero if a CRC32C follows the payload
+ * Output: None
+ * Return: Region size in bytes, a multiple of SCATTER_TILE_SIZE
+ */
+size_t stego_scatter_region(size_t carrier_size, size_t data_offset, int crc)
+{
+	size_t end = data_offset + (crc ? STEGO_CRC_SPAN : 0);
+
+	if(carrier_size < end)
+	{
+		return 0;
+	}
+	return (carrier_size - end) / SCATTER_TILE_SIZE * SCATTER_TILE_SIZE;
+}
+
+/* Smallest depth that fits
+ * Description: Fewer bits per carrier byte change the image less, so the
+ * smallest depth whose payload fits the carrier wins.
+ * Input: Carrier size, payload file extension, payload size, format flags
+ * Output: None
+ * Return: Depth 1 to 4, or 0 if the payload does not fit at any depth
+ */
+int stego_fit_depth(size_t carrier_size, const char *extn, size_t payload_size, uint flags)
+{
+	for(int depth = 1; depth <= STEGO_MAX_DEPTH; depth++)
+	{
+		if(stego_required_size(extn, payload_size, depth, flags) <= carrier_size)
+		{
+			return depth;
+		}
+	}
+	return 0;
+}
+
+/* Embed into the carrier bytes from pos on, out and image are whole images */
+static void stego_put_bytes(const Carrier *carrier, char *out, const char *image, size_t pos, const char *data, size_t size, int depth)
+{
+	size_t offset = carrier_offset(carrier, pos);
+
+	stego_embed_bytes(carrier, out + offset, image + offset, pos, data, size, depth);
+}
+
+/* Embed a size field at carrier byte pos, out and image are whole images */
+static void stego_put_size(const Carrier *carrier, char *out, const char *image, size_t pos, uint size)
+{
+	size_t offset = carrier_offset(carrier, pos);
+
+	stego_embed_size(carrier, out + offset, image + offset, pos, size);
+}
+
+/* Embed a size field of the width of flags at carrier byte pos, two 32 bit halves high first when LARGE_FLAG is set, out and image are whole images */
+static size_t stego_put_wide(const Carrier *carrier, char *out, const char *image, size_t pos, uint64_t size, uint flags)
+{
+	if(flags & LARGE_FLAG)
+	{
+		stego_put_size(carrier, out, image, pos, size >> 32);
+		pos += 32;
+	}
+	stego_put_size(carrier, out, image, pos, (uint)size);
+	return STEGO_SIZE_SPAN(flags);
+}
+
+/* Embed a payload into a carrier
+ * Description: Copies the image to out (unless out is the image) and
+ * embeds the magic string, extension and payload into its carrier bytes.
+ * An encrypted payload gets a fresh random nonce. Checked or encrypted
+ * payloads go block by block, each block is encrypted, checked and
+ * embedded while it is in cache. A scattered payload goes to the tiles
+ * the key and nonce pick.
+ * Input: Image buffer and size, payload extension, payload buffer and size, options (NULL for depth 1), output buffer of image_size bytes
+ * Output: Stego image in out
+ * Return: e_success, or e_failure if the image is not a supported format, the payload does not fit, the extension is too long or no nonce can be made
+ */
+Status stego_embed(const char *image, size_t image_size, const char *extn, const char *payload, size_t payload_size, const StegoOptions *options, char *out)
+{
+	size_t extn_size = strlen(extn), magic_size = strlen(MAGIC_STRING), offset = 0, capacity;
+	int depth = options != NULL ? options->depth : 1;
+	const unsigned char *key = options != NULL ? options->key : NULL;
+	uint payload_crc = 0, flags;
+	StegoHeader format;
+	Carrier carrier;
+	ScatterMap map;
+	size_t region = 0;
+
+	if(carrier_parse(&carrier, image, image_size, NULL) == e_failure || carrier_fits(&carrier, image_size) == e_failure)
+	{
+		return e_failure;
+	}
+	capacity = carrier_size(&carrier);
+	format.compressed = 0;
+	format.crc = options != NULL && options->crc;
+	format.encrypted = key != NULL;
+	format.scatter = options != NULL && options->scatter;
+	format.striped = options != NULL && options->stripe != NULL;
+	format.large = stego_large_flag(payload_size, format.striped ? options->stripe : NULL) != 0;
+	flags = (format.crc ? CRC_FLAG : 0) | (format.encrypted ? ENCRYPTED_FLAG : 0) | (format.scatter ? SCATTER_FLAG : 0) | (format.striped ? STRIPED_FLAG : 0) | (format.large ? LARGE_FLAG : 0);
+	if(format.scatter && key == NULL)
+	{
+		return e_failure;
+	}
+	if(format.striped)
+	{
+		format.stripe = *options->stripe;
+		format.size = payload_size;
+		if(stego_check_stripe(&format) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	if(depth == 0)
+	{
+		depth = stego_fit_depth(capacity, extn, payload_size, flags);
+	}
+	if(depth < 1 || depth > STEGO_MAX_DEPTH || extn_size > STEGO_MAX_EXTN || stego_required_size(extn, payload_size, depth, flags) > capacity)
+	{
+		return e_failure;
+	}
+	format.depth = depth;
+	if(key != NULL && getrandom(format.nonce, STEGO_NONCE_SIZE, 0) != STEGO_NONCE_SIZE)
+	{
+		return e_failure;
+	}
+
+	//Bytes that carry no data are copied as they are.
+	if(out != image)
+	{
+		memcpy(out, image, image_size);
+	}
+
+	stego_put_bytes(&carrier, out, image, offset, MAGIC_STRING, magic_size, 1);
+	offset += magic_size * 8;
+	stego_put_size(&carrier, out, image, offset, stego_extn_field(extn_size, &format));
+	offset += 32;
+	stego_put_bytes(&carrier, out, image, offset, extn, extn_size, 1);
+	offset += extn_size * 8;
+	offset += stego_put_wide(&carrier, out, image, offset, payload_size, flags);
+	if(format.striped)
+	{
+		uint fields[3] = { format.stripe.id, format.stripe.index, format.stripe.count };
+
+		for(int i = 0; i < 3; i++)
+		{
+			stego_put_size(&carrier, out, image, offset, fields[i]);
+			offset += 32;
+		}
+		offset += stego_put_wide(&carrier, out, image, offset, format.stripe.offset, flags);
+		offset += stego_put_wide(&carrier, out, image, offset, format.stripe.total, flags);
+	}
+	if(key != NULL)
+	{
+		stego_put_bytes(&carrier, out, image, offset, (const char *)format.nonce, STEGO_NONCE_SIZE, 1);
+		offset += 8 * STEGO_NONCE_SIZE;
+	}
+	if(format.scatter)
+	{
+		region = stego_scatter_region(capacity, offset, format.crc);
+		if(scatter_init(&map, key, format.nonce, &carrier, offset, region, lsb_carrier_bytes(payload_size, depth)) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	if(!format.crc && key == NULL)
+	{
+		stego_put_bytes(&carrier, out, image, offset, payload, payload_size, depth);
+		return e_success;
+	}
+
+	for(size_t i = 0; i < payload_size; i += STEGO_BLOCK)
+	{
+		size_t block = payload_size - i < STEGO_BLOCK ? payload_size - i : STEGO_BLOCK;
+		char ciphertext[STEGO_BLOCK];
+		const char *data = payload + i;
+
+		if(key != NULL)
+		{
+			memcpy(ciphertext, data, block);
+			chacha20_xor(key, format.nonce, i, ciphertext, block);
+			data = ciphertext;
+		}
+		if(format.crc)
+		{
+			payload_crc = crc32c(payload_crc, data, block);
+		}
+		if(format.scatter)
+		{
+			scatter_embed(&map, out, lsb_carrier_bytes(i, depth), data, block, depth);
+		}
+		else
+		{
+			stego_put_bytes(&carrier, out, image, offset + lsb_carrier_bytes(i, depth), data, block, depth);
+		}
+	}
+	if(format.scatter)
+	{
+		scatter_free(&map);
+	}
+	if(format.crc)
+	{
+		offset += format.scatter ? region : lsb_carrier_bytes(payload_size, depth);
+		stego_put_size(&carrier, out, image, offset, payload_crc);
+	}
+
+	return e_success;
+}
+
+/* Offset of carrier byte pos from the first pixel byte */
+static size_t stego_pixel_offset(const Carrier *carrier, size_t pos)
+{
+	return carrier_offset(carrier, pos) - carrier->data_offset;
+}
+
+/* Extract a size field of the width of the header at carrier byte *pos of the pixel bytes, pos moves past it */
+static uint64_t stego_get_wide(const Carrier *carrier, const char *pixels, size_t *pos, int large)
+{
+	uint64_t size = 0;
+
+	if(large)
+	{
+		size = (uint64_t)stego_extract_size(carrier, pixels + stego_pixel_offset(carrier, *pos), *pos) << 32;
+		*pos += 32;
+	}
+	size |= stego_extract_size(carrier, pixels + stego_pixel_offset(carrier, *pos), *pos);
+	*pos += 32;
+	return size;
+}
+
+/* Read the header fields of a stego image
+ * Description: Checks the magic string and validates the extension and
+ * payload sizes against the image size before anything else is read.
+ * Input: Stego image buffer and size
+ * Output: Extension, payload size, payload offset and image layout in header
+ * Return: e_success, or e_failure if the buffer holds no valid payload
+ */
+Status stego_read_header(const char *stego, size_t stego_size, StegoHeader *header)
+{
+	return stego_parse_header(stego, stego_size, stego_size, header);
+}
+
+/* Read the header fields from the front of a stego image
+ * Description: Like stego_read_header, but only the first prefix_size
+ * bytes are in memory, STEGO_HEADER_SPAN of them are enough unless the
+ * pixels start further in. The payload size is still validated against
+ * the whole image size.
+ * Input: Image prefix and its size, size of the whole image
+ * Output: Extension, payload size, payload offset and image layout in header
+ * Return: e_success, or e_failure if the image holds no valid payload
+ */
+Status stego_parse_header(const char *prefix, size_t prefix_size, size_t stego_size, StegoHeader *header)
+{
+	if(prefix_size > stego_size || carrier_parse(&header->carrier, prefix, prefix_size, NULL) == e_failure || carrier_fits(&header->carrier, stego_size) == e_failure || prefix_size < header->carrier.data_offset)
+	{
+		return e_failure;
+	}
+	return stego_parse_fields(prefix + header->carrier.data_offset, prefix_size - header->carrier.data_offset, header);
+}
+
+/* Read the header fields from the pixel bytes of a stego image
+ * Description: The carrier in header is already parsed and checked
+ * against the image size, pixels holds the image bytes from its
+ * data_offset on. CARRIER_SPAN_MAX(STEGO_FIELDS_SPAN) of them are
+ * enough for any header.
+ * Input: Pixel bytes and their count
+ * Output: Extension, payload size, payload offset and stripe fields in header
+ * Return: e_success, or e_failure if the image holds no valid payload
+ */
+Status stego_parse_fields(const char *pixels, size_t pixels_size, StegoHeader *header)
+{
+	size_t magic_size = strlen(MAGIC_STRING), offset = 0, stored;
+	const Carrier *carrier = &header->carrier;
+	char magic[sizeof(MAGIC_STRING)];
+	uint extn_size;
+
+	if(carrier_size(carrier) < STEGO_FIELDS_SPAN)
+	{
+		return e_failure;
+	}
+
+	//Magic string and extension size.
+	if(pixels_size < stego_pixel_offset(carrier, magic_size * 8 + 32))
+	{
+		return e_failure;
+	}
+	stego_extract_bytes(carrier, magic, pixels, 0, magic_size, 1);
+	if(memcmp(magic, MAGIC_STRING, magic_size) != 0)
+	{
+		return e_failure;
+	}
+	offset += magic_size * 8;
+	if(stego_parse_extn_field(stego_extract_size(carrier, pixels + stego_pixel_offset(carrier, offset), offset), &extn_size, header) == e_failure)
+	{
+		return e_failure;
+	}
+	offset += 32;
+
+	//Extension and payload size.
+	if(pixels_size < stego_pixel_offset(carrier, offset + extn_size * 8 + STEGO_SIZE_SPAN(header->large ? LARGE_FLAG : 0)))
+	{
+		return e_failure;
+	}
+	stego_extract_bytes(carrier, header->extn, pixels + stego_pixel_offset(carrier, offset), offset, extn_size, 1);
+	header->extn[extn_size] = '\0';
+	offset += extn_size * 8;
+	header->size = stego_get_wide(carrier, pixels, &offset, header->large);
+
+	//Stripe fields, the range has to be inside the whole payload.
+	if(header->striped)
+	{
+		uint fields[3];
+
+		if(pixels_size < stego_pixel_offset(carrier, offset + STEGO_STRIPE_SPAN(header->large ? LARGE_FLAG : 0)))
+		{
+			return e_failure;
+		}
+		for(int i = 0; i < 3; i++)
+		{
+			fields[i] = stego_extract_size(carrier, pixels + stego_pixel_offset(carrier, offset), offset);
+			offset += 32;
+		}
+		header->stripe.id = fields[0];
+		header->stripe.index = fields[1];
+		header->stripe.count = fields[2];
+		header->stripe.offset = stego_get_wide(carrier, pixels, &offset, header->large);
+		header->stripe.total = stego_get_wide(carrier, pixels, &offset, header->large);
+		if(stego_check_stripe(header) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+
+	//Nonce of an encrypted payload.
+	if(header->encrypted)
+	{
+		if(pixels_size < stego_pixel_offset(carrier, offset + 8 * STEGO_NONCE_SIZE))
+		{
+			return e_failure;
+		}
+		stego_extract_bytes(carrier, (char *)header->nonce, pixels + stego_pixel_offset(carrier, offset), offset, STEGO_NONCE_SIZE, 1);
+		offset += 8 * STEGO_NONCE_SIZE;
+	}
+
+	//The payload and its CRC32C have to be inside the image, a size past half the carrier never is.
+	if(header->size > carrier_size(carrier) / 2)
+	{
+		return e_failure;
+	}
+	stored = header->scatter ? scatter_span(lsb_carrier_bytes(header->size, header->depth)) : lsb_carrier_bytes(header->size, header->depth);
+	if(carrier_size(carrier) - offset < stored + (header->crc ? STEGO_CRC_SPAN : 0))
+	{
+		return e_failure;
+	}
+	header->data_offset = offset;
+
+	return e_success;
+}
+
+/* Check the stripe fields of one image
+ * Description: The range has to be inside the whole payload, a
+ * compressed range can only be checked for its start.
+ * Input: Header with the stripe fields
+ * Output: None
+ * Return: e_success or e_failure
+ */
+Status stego_check_stripe(const StegoHeader *header)
+{
+	const StegoStripe *stripe = &header->stripe;
+
+	if(stripe->count == 0 || stripe->count > STEGO_MAX_STRIPES || stripe->index >= stripe->count || stripe->offset >= stripe->total || stripe->total > INT64_MAX)
+	{
+		return e_failure;
+	}
+	if(!header->compressed && header->size > stripe->total - stripe->offset)
+	{
+		return e_failure;
+	}
+	return e_success;
+}
+
+/* Check a striped set
+ * Description: Every header has to be a stripe of the same payload, every
+ * index has to be there once and the ranges have to follow each other
+ * from offset 0. Uncompressed ranges have to end where the next one
+ * starts and the last one at the end of the payload.
+ * Input: Headers in any order, their number
+ * Output: order[index] is the position in headers of stripe index
+ * Return: e_success, or e_failure if the headers are not one whole set
+ */
+Status stego_order_stripes(const StegoHeader *headers, size_t count, size_t *order)
+{
+	if(count == 0 || count != headers[0].stripe.count)
+	{
+		return e_failure;
+	}
+	for(size_t i = 0; i < count; i++)
+	{
+		order[i] = count;
+	}
+	for(size_t i = 0; i < count; i++)
+	{
+		const StegoHeader *header = &headers[i];
+
+		if(!header->striped || header->stripe.id != headers[0].stripe.id || header->stripe.count != count || header->stripe.total != headers[0].stripe.total || header->compressed != headers[0].compressed || strcmp(header->extn, headers[0].extn) != 0 || order[header->stripe.index] != count)
+		{
+			return e_failure;
+		}
+		order[header->stripe.index] = i;
+	}
+	for(size_t i = 0; i < count; i++)
+	{
+		const StegoHeader *header = &headers[order[i]];
+		uint64_t end = i + 1 < count ? headers[order[i + 1]].stripe.offset : header->stripe.total;
+
+		if((i == 0 && header->stripe.offset != 0) || header->stripe.offset >= end || (!header->compressed && header->size != end - header->stripe.offset))
+		{
+			return e_failure;
+		}
+	}
+	return e_success;
+}
+
+/* Extract the payload of a stego image
+ * Description: Compressed payloads are extracted as stored, as LZ frames
+ * that lz_stream_write expands. A CRC32C is checked and an encrypted
+ * payload decrypted block by block right after each block is extracted,
+ * while it is still in cache. Without a key an encrypted payload is
+ * extracted as stored, a scattered one cannot be found.
+ * Input: Stego image buffer and size, key (NULL for none), payload buffer and its capacity
+ * Output: Header fields in header, payload bytes in payload
+ * Return: e_success, or e_failure if there is no valid payload, it does not fit the buffer, fails its CRC32C or is scattered and there is no key
+ */
+Status stego_extract(const char *stego, size_t stego_size, StegoHeader *header, const unsigned char *key, char *payload, size_t payload_capacity)
+{
+	const Carrier *carrier = &header->carrier;
+	size_t offset, end;
+	uint crc = 0;
+	ScatterMap map;
+	size_t region = 0;
+
+	if(stego_read_header(stego, stego_size, header) == e_failure || header->size > payload_capacity)
+	{
+		return e_failure;
+	}
+	offset = header->data_offset;
+	if(!header->encrypted)
+	{
+		key = NULL;
+	}
+	if(header->scatter)
+	{
+		region = stego_scatter_region(carrier_size(carrier), offset, header->crc);
+		if(key == NULL || scatter_init(&map, key, header->nonce, carrier, offset, region, lsb_carrier_bytes(header->size, header->depth)) == e_failure)
+		{
+			return e_failure;
+		}
+	}
+	if(!header->crc && key == NULL)
+	{
+		stego_extract_bytes(carrier, payload, stego + carrier_offset(carrier, offset), offset, header->size, header->depth);
+		return e_success;
+	}
+
+	for(size_t i = 0; i < header->size; i += STEGO_BLOCK)
+	{
+		size_t block = header->size - i < STEGO_BLOCK ? header->size - i : STEGO_BLOCK;
+		size_t pos = offset + lsb_carrier_bytes(i, header->depth);
+
+		if(header->scatter)
+		{
+			scatter_extract(&map, payload + i, stego, lsb_carrier_bytes(i, header->depth), block, header->depth);
+		}
+		else
+		{
+			stego_extract_bytes(carrier, payload + i, stego + carrier_offset(carrier, pos), pos, block, header->depth);
+		}
+		if(header->crc)
+		{
+			crc = crc32c(crc, payload + i, block);
+		}
+		if(key != NULL)
+		{
+			chacha20_xor(key, header->nonce, i, payload + i, block);
+		}
+	}
+	if(header->scatter)
+	{
+		scatter_free(&map);
+	}
+	end = offset + (header->scatter ? region : lsb_carrier_bytes(header->size, header->depth));
+	if(header->crc && crc != stego_extract_size(carrier, stego + carrier_offset(carrier, end), end))
+	{
+		return e_failure;
+	}
+	return e_success;
+}
@@ -0,0 +1,143 @@
+#ifndef STEGO_H
+#define STEGO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h" // Contains user defined types
+#include "common.h"
+#include "carrier.h"
+
+/*
+ * In memory LSB steganography library.
+ * All functions work on caller provided buffers, keep no state, print
+ * nothing and can be called from any number of threads at once.
+ *
+ * Images are BMP, PPM or TGA files (carrier.h), the payload goes into
+ * their carrier bytes. Stego layout from carrier byte 0, one bit per carrier byte:
+ * magic string, extension size (32 bits, format flags above the low
+ * byte, see common.h), extension, payload size (32 bits, 64 bits with
+ * LARGE_FLAG), optionally the stripe fields (id, index and count of 32
+ * bits, offset and total as wide as the size), optionally a ChaCha20 nonce
+ * (96 bits), then the payload at 1 to 4 bits per carrier byte, then
+ * optionally a CRC32C of the payload as stored (32 bits). A scattered
+ * payload goes to keyed tiles of the whole region after the nonce and its
+ * CRC32C right after the last whole tile.
+ *
+ * A payload too large for one image is striped over a set of them: every
+ * image holds a contiguous range of it as a payload of its own, and its
+ * stripe fields say which range of which payload.
+ */
+
+#define STEGO_MAX_EXTN 4
+#define STEGO_MAX_DEPTH 4
+#define STEGO_KEY_SIZE 32
+#define STEGO_NONCE_SIZE 12
+#define STEGO_SIZE32_MAX 0xffffffffULL			//Largest size a 32 bit size field holds, larger payloads need LARGE_FLAG.
+#define STEGO_SIZE_SPAN(flags) ((flags) & LARGE_FLAG ? 64 : 32)	//Carrier bytes of the payload size, the stripe offset and the stripe total.
+#define STEGO_STRIPE_SPAN(flags) (32 * 3 + 2 * STEGO_SIZE_SPAN(flags))	//Carrier bytes of the stripe fields after the payload size.
+#define STEGO_MAX_STRIPES 0xffff
+/* Carrier bytes of every header field: magic string (2 bytes), sizes, extension, widest stripe fields and nonce at 8 carrier bytes per byte */
+#define STEGO_FIELDS_SPAN (8 * (2 + 4 + STEGO_MAX_EXTN + 8 + 3 * 4 + 2 * 8 + STEGO_NONCE_SIZE))
+/* Image prefix that holds every header field when the pixels start within CARRIER_HEADER_MAX bytes */
+#define STEGO_HEADER_SPAN (CARRIER_HEADER_MAX + CARRIER_SPAN_MAX(STEGO_FIELDS_SPAN))
+#define STEGO_CRC_SPAN 32					//Carrier bytes of the CRC32C after the payload.
+
+/* Stripe fields, the range of a striped payload one image holds */
+typedef struct _StegoStripe
+{
+    uint id;								//Random, the same in every stripe of a payload.
+    uint index;								//Stripe number, 0 to count - 1 in payload order.
+    uint count;								//Stripes in the set, 1 to STEGO_MAX_STRIPES.
+    uint64_t offset;						//Payload offset of the range, before compression.
+    uint64_t total;							//Size of the whole payload, before compression.
+} StegoStripe;
+
+/* How a payload is embedded */
+typedef struct _StegoOptions
+{
+    int depth;								//Payload bits per carrier byte, 1 to 4, 0 for the smallest that fits.
+    int crc;								//Non zero to store a CRC32C of the payload after it.
+    const unsigned char *key;				//STEGO_KEY_SIZE byte ChaCha20 key to encrypt the payload with, NULL for none.
+    int scatter;							//Non zero to scatter the payload over the carrier, needs a key.
+    const StegoStripe *stripe;				//Stripe of a set the payload is, NULL for a whole payload.
+} StegoOptions;
+
+/* Header fields read back from a stego image */
+typedef struct _StegoHeader
+{
+    char extn[STEGO_MAX_EXTN + 1];			//Payload file extension, with the dot.
+    uint64_t size;							//Payload size in bytes.
+    int depth;								//Payload bits per carrier byte.
+    int compressed;							//Payload is stored as LZ frames (lz.h).
+    int crc;								//A CRC32C of the payload follows it.
+    int encrypted;							//Payload is ChaCha20 encrypted with nonce.
+    int scatter;							//Payload is scattered over keyed tiles of the region.
+    int striped;							//Payload is one stripe of a set, see stripe.
+    int large;								//Sizes are 64 bit fields.
+    StegoStripe stripe;
+    unsigned char nonce[STEGO_NONCE_SIZE];
+    size_t data_offset;						//Carrier byte of the first payload byte.
+    Carrier carrier;						//Pixel layout of the image.
+} StegoHeader;
+
+/* Library function prototypes */
+
+/* LARGE_FLAG if the payload size or the total of its stripe (NULL if not striped) needs 64 bit size fields, 0 otherwise */
+uint stego_large_flag(uint64_t payload_size, const StegoStripe *stripe);
+
+/* Carrier bytes needed to hold a payload at depth bits per carrier byte, the fields of flags (CRC_FLAG, ENCRYPTED_FLAG, SCATTER_FLAG, STRIPED_FLAG, LARGE_FLAG) included */
+size_t stego_required_size(const char *extn, size_t payload_size, int depth, uint flags);
+
+/* Largest payload that fits carrier_size carrier bytes at depth bits per carrier byte, with the fields of flags */
+size_t stego_payload_capacity(size_t carrier_size, const char *extn, int depth, uint flags);
+
+/* Smallest depth whose payload fits carrier_size carrier bytes, 0 if none does */
+int stego_fit_depth(size_t carrier_size, const char *extn, size_t payload_size, uint flags);
+
+/* Embed a payload into a BMP, PPM or TGA image, out receives image_size bytes and may be the image itself, options may be NULL */
+Status stego_embed(const char *image, size_t image_size, const char *extn, const char *payload, size_t payload_size, const StegoOptions *options, char *out);
+
+/* Read and validate the header fields of a stego image */
+Status stego_read_header(const char *stego, size_t stego_size, StegoHeader *header);
+
+/* Read and validate the header fields from the first prefix_size bytes of a stego image of stego_size bytes */
+Status stego_parse_header(const char *prefix, size_t prefix_size, size_t stego_size, StegoHeader *header);
+
+/* Read and validate the header fields from the pixel bytes of an image whose carrier is already parsed */
+Status stego_parse_fields(const char *pixels, size_t pixels_size, StegoHeader *header);
+
+/* Check the stripe fields of one header */
+Status stego_check_stripe(const StegoHeader *header);
+
+/* Check the headers of a striped set, given in any order, and find every stripe: order[index] is the header of stripe index */
+Status stego_order_stripes(const StegoHeader *headers, size_t count, size_t *order);
+
+/* Extract the payload into a caller buffer of payload_capacity bytes, checking its CRC32C if it has one and decrypting it with key if it is encrypted */
+Status stego_extract(const char *stego, size_t stego_size, StegoHeader *header, const unsigned char *key, char *payload, size_t payload_capacity);
+
+/* Building blocks shared with the file engines */
+
+/* Extension size field with the format flags of format */
+uint stego_extn_field(size_t extn_size, const StegoHeader *format);
+
+/* Split an extension size field into extension size and format */
+Status stego_parse_extn_field(uint field, uint *extn_size, StegoHeader *header);
+
+/* Whole tile bytes of the region a scattered payload goes to, data_offset is the carrier byte of the region */
+size_t stego_scatter_region(size_t carrier_size, size_t data_offset, int crc);
+
+/* The building blocks take the file bytes from carrier byte pos on */
+
+/* Embed size bytes at depth bits per carrier byte, dst may be src */
+void stego_embed_bytes(const Carrier *carrier, char *dst, const char *src, size_t pos, const char *data, size_t size, int depth);
+
+/* Embed a 32 bit size field into 32 carrier bytes, dst may be src */
+void stego_embed_size(const Carrier *carrier, char *dst, const char *src, size_t pos, uint size);
+
+/* Extract size bytes stored at depth bits per carrier byte */
+void stego_extract_bytes(const Carrier *carrier, char *data, const char *src, size_t pos, size_t size, int depth);
+
+/* Extract a 32 bit size field from 32 carrier bytes */
+uint stego_extract_size(const Carrier *carrier, const char *src, size_t pos);
+
+#endif
@@ -0,0 +1,647 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include "carrier.h"
+#include "decode.h"
+#include "encode.h"
+#include "scan.h"
+#include "stego.h"
+#include "stripe.h"
+#include "thread_pool.h"
+#include "types.h"
+
+/* One image of a striped set */
+typedef struct _StripeJob
+{
+	char *image_fname;						//Source image on -e, stego image on -d.
+	char *stego_image_fname;				//Output image on -e, NULL in place or on -d.
+	size_t capacity;						//Payload bytes the image holds at the depth of the set.
+	StegoStripe stripe;						//Stripe fields of the image.
+	uint64_t size;							//Secret bytes of the stripe, before compression.
+
+	Status status;							//Result of the stripe.
+	double elapsed_ms;						//Wall time of the stripe.
+} StripeJob;
+
+/* Images of a striped set, shared by the workers */
+typedef struct _StripeSet
+{
+	StripeJob *jobs;						//Images in command line order.
+	int count;								//Number of images.
+	int next;								//Next image to hand out.
+	const Options *options;					//Options of every stripe.
+	char *secret_fname;						//Secret file on -e.
+	int depth;								//Payload bits per carrier byte of every stripe on -e.
+	char *output_fname;						//Output file name without its extension on -d.
+} StripeSet;
+
+/* Function Definitions */
+
+/* Monotonic clock in milliseconds */
+static double stripe_now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/* Print an INFO line unless -q is given */
+static void stripe_info(const Options *options, const char *format, ...)
+{
+	va_list args;
+
+	if(options->quiet)
+	{
+		return;
+	}
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+/* Free the images of a set */
+static void free_stripes(StripeSet *set)
+{
+	for(int i = 0; i < set->count; i++)
+	{
+		free(set->jobs[i].image_fname);
+		free(set->jobs[i].stego_image_fname);
+	}
+	free(set->jobs);
+	set->jobs = NULL;
+	set->count = 0;
+}
+
+/* Split the image list
+ * Description: One image per comma separated name, empty names are an
+ * error, at most STEGO_MAX_STRIPES of them.
+ * Input: Comma separated image file names
+ * Output: One job per image in set
+ * Return: e_success or e_failure
+ */
+static Status read_stripe_list(const char *list, StripeSet *set)
+{
+	const char *name = list;
+
+	set->jobs = NULL;
+	set->count = 0;
+	set->next = 0;
+	while(1)
+	{
+		const char *end = strchr(name, ',');
+		size_t size = end != NULL ? (size_t)(end - name) : strlen(name);
+		StripeJob *jobs;
+
+		if(size == 0 || set->count == STEGO_MAX_STRIPES)
+		{
+			fprintf(stderr, "ERROR: %s is not a list of 1 to %d image files\n", list, STEGO_MAX_STRIPES);
+			free_stripes(set);
+			return e_failure;
+		}
+		jobs = realloc(set->jobs, (set->count + 1) * sizeof(StripeJob));
+		if(jobs == NULL)
+		{
+			free_stripes(set);
+			return e_failure;
+		}
+		set->jobs = jobs;
+		memset(&set->jobs[set->count], 0, sizeof(StripeJob));
+		set->jobs[set->count].image_fname = strndup(name, size);
+		set->jobs[set->count].status = e_failure;
+		set->count++;
+		if(set->jobs[set->count - 1].image_fname == NULL)
+		{
+			free_stripes(set);
+			return e_failure;
+		}
+		if(end == NULL)
+		{
+			return e_success;
+		}
+		name = end + 1;
+	}
+}
+
+/* Name the output images
+ * Description: <output>_<i> with the extension of source image i, the
+ * extension of output is left out, stego_image_<i> without an output.
+ * Input: Set with its source images, output file name or NULL
+ * Output: stego_image_fname of every job
+ * Return: e_success or e_failure
+ */
+static Status name_stripe_outputs(StripeSet *set, const char *output_fname)
+{
+	const char *base = output_fname != NULL ? output_fname : "stego_image";
+	int base_size = strlen(base) - strlen(file_extn(base));
+
+	for(int i = 0; i < set->count; i++)
+	{
+		StripeJob *job = &set->jobs[i];
+
+		if(asprintf(&job->stego_image_fname, "%.*s_%d%s", base_size, base, i + 1, file_extn(job->image_fname)) < 0)
+		{
+			job->stego_image_fname = NULL;
+			return e_failure;
+		}
+	}
+	return e_success;
+}
+
+/* Read the capacity of every image
+ * Description: Opens every source image for its pixel layout and finds
+ * the payload bytes it holds at depth with the fields of flags.
+ * Input: Set, secret file extension, depth, format flags
+ * Output: capacity of every job, their sum in sum
+ * Return: e_success, or e_failure if an image cannot be read
+ */
+static Status read_stripe_capacity(StripeSet *set, const char *extn, int depth, uint flags, unsigned long long *sum)
+{
+	*sum = 0;
+
+	for(int i = 0; i < set->count; i++)
+	{
+		StripeJob *job = &set->jobs[i];
+		FILE *fptr_image = fopen(job->image_fname, "r");
+		Carrier carrier;
+
+		if(fptr_image == NULL)
+		{
+			perror("fopen");
+			fprintf(stderr, "ERROR: Unable to open file %s\n", job->image_fname);
+			return e_failure;
+		}
+		if(carrier_read(&carrier, fptr_image) == e_failure)
+		{
+			fprintf(stderr, "ERROR: %s is not an uncompressed 24 or 32 bit BMP, PPM or TGA image\n", job->image_fname);
+			fclose(fptr_image);
+			return e_failure;
+		}
+		fclose(fptr_image);
+		job->capacity = stego_payload_capacity(carrier_size(&carrier), extn, depth, flags);
+		*sum += job->capacity;
+	}
+	return e_success;
+}
+
+/* Plan the stripes
+ * Description: Every image gets one secret byte, the rest is split in
+ * proportion to the capacity each image has left, and the bytes the
+ * rounding leaves over go to images with room for them. The ranges follow
+ * each other in command line order.
+ * Input: Set with the capacity of every image, secret size
+ * Output: Stripe fields and size of every job
+ * Return: e_success, or e_failure if the secret does not fit
+ */
+static Status plan_stripes(StripeSet *set, uint64_t secret_size)
+{
+	unsigned long long spare = 0, rest;
+	uint64_t offset = 0;
+	uint id;
+
+	if(secret_size < (uint64_t)set->count)
+	{
+		return e_failure;
+	}
+	for(int i = 0; i < set->count; i++)
+	{
+		if(set->jobs[i].capacity == 0)
+		{
+			return e_failure;
+		}
+		spare += set->jobs[i].capacity - 1;
+	}
+	rest = secret_size - set->count;
+	if(rest > spare)
+	{
+		return e_failure;
+	}
+
+	for(int i = 0; i < set->count; i++)
+	{
+		//Secret size times capacity can overflow 64 bits past 4 GB.
+		set->jobs[i].size = 1 + (spare != 0 ? (uint64_t)((unsigned __int128)rest * (set->jobs[i].capacity - 1) / spare) : 0);
+		offset += set->jobs[i].size;
+	}
+	//Rounding leaves fewer bytes over than there are images.
+	for(int i = 0; offset < secret_size; i = (i + 1) % set->count)
+	{
+		if(set->jobs[i].size < set->jobs[i].capacity)
+		{
+			set->jobs[i].size++;
+			offset++;
+		}
+	}
+
+	//The id tells stripes of different secrets apart.
+	if(getrandom(&id, sizeof(id), 0) != sizeof(id))
+	{
+		return e_failure;
+	}
+	offset = 0;
+	for(int i = 0; i < set->count; i++)
+	{
+		set->jobs[i].stripe.id = id;
+		set->jobs[i].stripe.index = i;
+		set->jobs[i].stripe.count = set->count;
+		set->jobs[i].stripe.offset = offset;
+		set->jobs[i].stripe.total = secret_size;
+		offset += set->jobs[i].size;
+	}
+	return e_success;
+}
+
+/* Encode one stripe
+ * Description: Validates the names like the command line does and encodes
+ * the range of the stripe quietly on one thread.
+ * Input: Job, worker EncodeInfo, set
+ * Output: Job status and time are filled in
+ * Return: None
+ */
+static void run_encode_stripe(StripeJob *job, EncodeInfo *encInfo, const StripeSet *set)
+{
+	const Options *options = set->options;
+	char *argv[] = { "stripe", "-e", job->image_fname, set->secret_fname, job->stego_image_fname, NULL };
+	double start = stripe_now_ms();
+
+	encInfo->pool = NULL;
+	encInfo->quiet = 1;
+	encInfo->stats = NULL;
+	encInfo->use_stdio = 0;
+	encInfo->stdin_fd = STDIN_FILENO;
+	encInfo->stdout_fd = STDOUT_FILENO;
+	encInfo->depth = set->depth;
+	encInfo->compress = options->compress;
+	encInfo->crc = options->crc;
+	encInfo->key = options->has_key ? options->key : NULL;
+	encInfo->scatter = options->scatter;
+	encInfo->in_place = options->in_place;
+	encInfo->secret_offset = job->stripe.offset;
+	encInfo->secret_part = job->size;
+	encInfo->stripe = &job->stripe;
+	job->status = e_failure;
+
+	if(read_and_validate_encode_args(argv, encInfo) == e_success)
+	{
+		job->status = do_encoding(encInfo);
+		close_files(encInfo);
+	}
+	job->elapsed_ms = stripe_now_ms() - start;
+}
+
+/* Decode one stripe
+ * Description: Decodes the stripe quietly on one thread into its range of
+ * the output file, which is already at its full size.
+ * Input: Job, worker DecodeInfo, set
+ * Output: Job status and time are filled in
+ * Return: None
+ */
+static void run_decode_stripe(StripeJob *job, DecodeInfo *decInfo, const StripeSet *set)
+{
+	const Options *options = set->options;
+	char *argv[] = { "stripe", "-d", job->image_fname, set->output_fname, NULL };
+	double start = stripe_now_ms();
+
+	decInfo->pool = NULL;
+	decInfo->quiet = 1;
+	decInfo->stats = NULL;
+	decInfo->key = options->has_key ? options->key : NULL;
+	decInfo->stripe_set = 1;
+	decInfo->stdin_fd = STDIN_FILENO;
+	decInfo->stdout_fd = STDOUT_FILENO;
+	decInfo->fptr_stego_image = NULL;
+	decInfo->fptr_output_file = NULL;
+	job->status = e_failure;
+
+	if(read_and_validate_decode(argv, decInfo) == e_success)
+	{
+		job->status = do_decoding(decInfo);
+		close_decode_files(decInfo);
+		//The stripe has to be the one the set was checked with.
+		if(job->status == e_success && (decInfo->stripe.id != job->stripe.id || decInfo->stripe.index != job->stripe.index || decInfo->stripe.count != job->stripe.count || decInfo->stripe.offset != job->stripe.offset || decInfo->stripe.total != job->stripe.total))
+		{
+			job->status = e_failure;
+		}
+	}
+	job->elapsed_ms = stripe_now_ms() - start;
+}
+
+/* Encode worker: takes the next stripe until none are left */
+static void encode_stripe_worker(void *arg, int index)
+{
+	StripeSet *set = arg;
+	EncodeInfo *encInfo = malloc(sizeof(EncodeInfo));
+	int job;
+
+	(void)index;
+	if(encInfo == NULL)
+	{
+		return;
+	}
+	while((job = __atomic_fetch_add(&set->next, 1, __ATOMIC_RELAXED)) < set->count)
+	{
+		run_encode_stripe(&set->jobs[job], encInfo, set);
+	}
+	free(encInfo);
+}
+
+/* Decode worker: takes the next stripe until none are left */
+static void decode_stripe_worker(void *arg, int index)
+{
+	StripeSet *set = arg;
+	DecodeInfo *decInfo = malloc(sizeof(DecodeInfo));
+	int job;
+
+	(void)index;
+	if(decInfo == NULL)
+	{
+		return;
+	}
+	while((job = __atomic_fetch_add(&set->next, 1, __ATOMIC_RELAXED)) < set->count)
+	{
+		run_decode_stripe(&set->jobs[job], decInfo, set);
+	}
+	free(decInfo);
+}
+
+/* Run every stripe of the set
+ * Description: One worker per CPU unless -j is given, no more workers
+ * than images.
+ * Input: Set, worker task
+ * Output: Every job is run
+ * Return: e_success, or e_failure if the pool cannot start
+ */
+static Status run_stripes(StripeSet *set, ThreadTask worker)
+{
+	int workers = set->options->threads > 0 ? set->options->threads : thread_pool_cpu_count();
+	ThreadPool *pool;
+
+	if(workers > set->count)
+	{
+		workers = set->count;
+	}
+	pool = thread_pool_create(workers);
+	if(pool == NULL)
+	{
+		return e_failure;
+	}
+	stripe_info(set->options, "INFO: %d stripes on %d workers\n", set->count, thread_pool_size(pool));
+	set->next = 0;
+	thread_pool_run(pool, worker, set, thread_pool_size(pool));
+	thread_pool_destroy(pool);
+	return e_success;
+}
+
+/* Report every stripe in stripe order
+ * Input: Set
+ * Output: One line per stripe on stdout unless -q is given
+ * Return: e_success if every stripe succeeded, e_failure otherwise
+ */
+static Status report_stripes(const StripeSet *set, const size_t *order)
+{
+	int succeeded = 0;
+
+	for(int i = 0; i < set->count; i++)
+	{
+		const StripeJob *job = &set->jobs[order != NULL ? order[i] : (size_t)i];
+		uint64_t end = i + 1 < set->count ? set->jobs[order != NULL ? order[i + 1] : (size_t)i + 1].stripe.offset : job->stripe.total;
+
+		if(job->status == e_success)
+		{
+			succeeded++;
+		}
+		stripe_info(set->options, "STRIPE %d: %s %s%s%s bytes %llu to %llu %.3f ms\n", i + 1, job->status == e_success ? "OK" : "FAILED", job->image_fname, job->stego_image_fname != NULL ? " -> " : "", job->stego_image_fname != NULL ? job->stego_image_fname : "", (unsigned long long)job->stripe.offset, (unsigned long long)end, job->elapsed_ms);
+		if(job->status == e_failure && set->options->quiet)
+		{
+			fprintf(stderr, "ERROR: Stripe %d in %s failed\n", i + 1, job->image_fname);
+		}
+	}
+	return succeeded == set->count ? e_success : e_failure;
+}
+
+/* Striped encoding
+ * Description: Finds the depth (the fewest bits per carrier byte that hold
+ * the secret over all images with -k auto), splits the secret over the
+ * images by capacity and encodes every stripe on a worker pool.
+ * Input: Command line arguments, argv[2] the comma separated images, options
+ * Output: One stego image per source image, or the source images in place
+ * Return: e_success if every stripe is encoded, e_failure otherwise
+ */
+Status do_striped_encoding(char *argv[], const Options *options)
+{
+	StripeSet set;
+	EncodeInfo *encInfo;
+	struct stat secret_stat;
+	unsigned long long capacity = 0;
+	uint flags = STRIPED_FLAG | (options->crc ? CRC_FLAG : 0) | (options->has_key ? ENCRYPTED_FLAG : 0) | (options->scatter ? SCATTER_FLAG : 0);
+	char extn[MAX_FILE_SUFFIX + 1] = "";
+	Status status;
+
+	if(read_stripe_list(argv[2], &set) == e_failure)
+	{
+		return e_failure;
+	}
+	set.options = options;
+	set.secret_fname = argv[3];
+	set.output_fname = NULL;
+
+	//In place the source images are the outputs.
+	if(options->in_place && argv[4] != NULL)
+	{
+		fprintf(stderr, "ERROR: No output file with --in-place, the images are changed in place\n");
+		status = e_failure;
+	}
+	else
+	{
+		status = options->in_place ? e_success : name_stripe_outputs(&set, argv[4]);
+	}
+
+	//Check the names of every stripe the way the command line is checked.
+	encInfo = malloc(sizeof(EncodeInfo));
+	if(encInfo == NULL)
+	{
+		status = e_failure;
+	}
+	for(int i = 0; status == e_success && i < set.count; i++)
+	{
+		char *job_argv[] = { "stripe", "-e", set.jobs[i].image_fname, set.secret_fname, set.jobs[i].stego_image_fname, NULL };
+
+		encInfo->quiet = 1;
+		encInfo->in_place = options->in_place;
+		status = read_and_validate_encode_args(job_argv, encInfo);
+		strcpy(extn, encInfo->extn_secret_file);
+	}
+	free(encInfo);
+	if(status == e_success && (stat(set.secret_fname, &secret_stat) != 0 || secret_stat.st_size <= 0))
+	{
+		fprintf(stderr, "ERROR: %s is empty or cannot be read\n", set.secret_fname);
+		status = e_failure;
+	}
+	else if(status == e_success)
+	{
+		StegoStripe whole = { .total = secret_stat.st_size };
+
+		//Secrets of 4 GB and more take 64 bit offsets in every stripe.
+		flags |= stego_large_flag(0, &whole);
+	}
+	if(status == e_failure)
+	{
+		free_stripes(&set);
+		return e_failure;
+	}
+
+	//The fewest bits per carrier byte that hold the secret over all images.
+	for(set.depth = options->depth != 0 ? options->depth : 1; ; set.depth++)
+	{
+		if(read_stripe_capacity(&set, extn, set.depth, flags, &capacity) == e_failure)
+		{
+			free_stripes(&set);
+			return e_failure;
+		}
+		if(capacity >= (unsigned long long)secret_stat.st_size || options->depth != 0 || set.depth == STEGO_MAX_DEPTH)
+		{
+			break;
+		}
+	}
+	stripe_info(options, "INFO: %d images hold %llu bytes at %d bit(s) per carrier byte\n", set.count, capacity, set.depth);
+	if(plan_stripes(&set, secret_stat.st_size) == e_failure)
+	{
+		fprintf(stderr, "ERROR: File capacity exceeded. Cannot encode %s over %s\n", set.secret_fname, argv[2]);
+		free_stripes(&set);
+		return e_failure;
+	}
+
+	status = run_stripes(&set, encode_stripe_worker);
+	if(status == e_success)
+	{
+		status = report_stripes(&set, NULL);
+	}
+	free_stripes(&set);
+	return status;
+}
+
+/* Read the stripe fields of every image
+ * Description: Reads the header of every image with scan_read_header,
+ * like the scan does, and checks that the images are one whole set.
+ * Input: Set with its stego images
+ * Output: Stripe fields of every job, order[index] is the job of stripe index, the header of any job in header
+ * Return: e_success or e_failure
+ */
+static Status read_stripe_headers(StripeSet *set, size_t *order, StegoHeader *header)
+{
+	StegoHeader *headers = malloc(set->count * sizeof(StegoHeader));
+	Status status = headers != NULL ? e_success : e_failure;
+
+	for(int i = 0; status == e_success && i < set->count; i++)
+	{
+		int fd = open(set->jobs[i].image_fname, O_RDONLY | O_CLOEXEC);
+		int unreadable;
+
+		if(fd < 0)
+		{
+			perror("open");
+			fprintf(stderr, "ERROR: Unable to open file %s\n", set->jobs[i].image_fname);
+			status = e_failure;
+			break;
+		}
+		if(scan_read_header(fd, &headers[i], &unreadable) == e_failure || !headers[i].striped)
+		{
+			fprintf(stderr, "ERROR: %s does not carry a stripe\n", set->jobs[i].image_fname);
+			status = e_failure;
+		}
+		close(fd);
+		set->jobs[i].stripe = headers[i].stripe;
+	}
+	if(status == e_success && stego_order_stripes(headers, set->count, order) == e_failure)
+	{
+		fprintf(stderr, "ERROR: The images are not every stripe of one secret\n");
+		status = e_failure;
+	}
+	if(status == e_success)
+	{
+		*header = headers[0];
+	}
+	free(headers);
+	return status;
+}
+
+/* Striped decoding
+ * Description: Checks the images are one whole set, creates the output
+ * file at the full secret size and decodes every stripe into its range
+ * on a worker pool.
+ * Input: Command line arguments, argv[2] the comma separated images, options
+ * Output: The secret in argv[3] (output by default) with its extension
+ * Return: e_success if every stripe is decoded, e_failure otherwise
+ */
+Status do_striped_decoding(char *argv[], const Options *options)
+{
+	StripeSet set;
+	StegoHeader header;
+	size_t *order;
+	char output_fname[MAX_OUTPUT_FNAME];
+	FILE *fptr_output;
+	Status status;
+
+	if(read_stripe_list(argv[2], &set) == e_failure)
+	{
+		return e_failure;
+	}
+	set.options = options;
+	set.secret_fname = NULL;
+	set.output_fname = argv[3] != NULL ? argv[3] : "output";
+	order = malloc(set.count * sizeof(size_t));
+	if(order == NULL || read_stripe_headers(&set, order, &header) == e_failure)
+	{
+		free(order);
+		free_stripes(&set);
+		return e_failure;
+	}
+	stripe_info(options, "INFO: %d stripes of a %llu byte %s file\n", set.count, (unsigned long long)header.stripe.total, header.extn);
+
+	//Every stripe writes its own range of the output file.
+	if(strlen(set.output_fname) + strlen(header.extn) >= MAX_OUTPUT_FNAME)
+	{
+		fprintf(stderr, "ERROR: Output file name %s is too long\n", set.output_fname);
+		status = e_failure;
+	}
+	else
+	{
+		strcpy(output_fname, set.output_fname);
+		strcat(output_fname, header.extn);
+		fptr_output = fopen(output_fname, "w");
+		status = fptr_output != NULL && ftruncate(fileno(fptr_output), header.stripe.total) == 0 ? e_success : e_failure;
+		if(fptr_output != NULL)
+		{
+			fclose(fptr_output);
+		}
+		if(status == e_failure)
+		{
+			perror("fopen");
+			fprintf(stderr, "ERROR: Unable to open file %s\n", output_fname);
+		}
+	}
+
+	if(status == e_success)
+	{
+		status = run_stripes(&set, decode_stripe_worker);
+		if(status == e_success)
+		{
+			status = report_stripes(&set, order);
+		}
+		//A partly decoded or corrupt output is not left behind.
+		if(status == e_failure)
+		{
+			unlink(output_fname);
+		}
+	}
+	free(order);
+	free_stripes(&set);
+	return status;
+}
@@ -0,0 +1,25 @@
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include "types.h" // Contains user defined types
+#include "options.h"
+
+/*
+ * Striped encoding: one secret spread over several images, given as one
+ * comma separated list, -e a.bmp,b.ppm,c.tga secret.txt [output].
+ * Every image holds one contiguous range of the secret, sized to its
+ * capacity, with the stripe fields that put it back in place (stego.h).
+ * The images are encoded concurrently, stripe i goes to <output>_<i>
+ * with the extension of its source image, stego_image_<i> by default.
+ * Decoding takes the whole set in any order, -d s1.bmp,s2.ppm [output].
+ */
+
+/* Striped encoding function prototypes */
+
+/* Encode the secret argv[3] over the images listed in argv[2], argv[4] names the outputs */
+Status do_striped_encoding(char *argv[], const Options *options);
+
+/* Decode the secret striped over the images listed in argv[2] into argv[3] */
+Status do_striped_decoding(char *argv[], const Options *options);
+
+#endif
@@ -10,13 +10,46 @@ Description:
 
 Input CLAs:
 			1. -e (for Encoding)
-			2. Source image file(.bmp file) 
-			3. Secret file (.txt file)
-			4. Stego image filename [Optional]
+			2. Source image file (.bmp, .ppm or .tga file: 24 or 32 bit uncompressed BMP, binary PPM, uncompressed true color TGA), or a comma separated list of them to stripe the secret over, - to read it from stdin
+			3. Secret file (.txt file), - to read it from stdin (without an extension) when the image is a file
+			4. Stego image filename, <name>_<i> for every image of a list, - to write it to stdout, the default for an image read from stdin [Optional]
+			5. -j N, encode on N threads, 0 for one per CPU [Optional]
+			6. -k N, hide N bits (1 to 4) in every carrier byte, auto for the fewest that fit, 1 by default [Optional]
+			7. -z, compress the secret file before hiding it [Optional]
+			8. --in-place, hide the secret in the source image itself instead of an output file [Optional]
+			9. --crc, store a CRC32C of the secret so decoding detects a corrupted image [Optional]
+			10. --key-file FILE or --key-env VAR, encrypt the secret with ChaCha20 under the 32 byte key (raw or 64 hex digits) in FILE or VAR [Optional]
+			11. --scatter, spread the encrypted secret over keyed 4 KB tiles of the whole image instead of its start, needs a key [Optional]
+			12. -q, no INFO lines [Optional]
+			13. --stats=json, print the time, bytes and read/write calls of every stage as one JSON line [Optional]
+			14. --secret-size N, encode the first N bytes of the secret, needed when it is read from a pipe [Optional]
+			Pipes are encoded in one forward pass, a stego image written to stdout implies -q and the stats go to stderr.
 		
 			1. -d (for Decoding)
-			2. Stego image file (.bmp file)
-			3. Output file name [Optional]
+			2. Stego image file (.bmp, .ppm or .tga file), or a comma separated list of every stripe of one secret in any order, - to read it from stdin
+			3. Output file name, - to write the secret to stdout (implies -q) [Optional]
+			4. -j N, decode on N threads, 0 for one per CPU [Optional]
+			5. --key-file FILE or --key-env VAR, key of an encrypted secret [Optional]
+			6. -q, --stats=json as for -e [Optional]
+
+			1. -b (for Batch Encoding)
+			2. Manifest file, one "<image file> <secret file> <output image file>" per line, the output in the format of the image
+			3. -j N, number of workers, one per CPU by default [Optional]
+			4. -k N, -z, --crc, --key-file, --key-env, --scatter as for -e [Optional]
+
+			1. --scan (for finding stego images)
+			2. Directory, searched with all its subdirectories for .bmp, .ppm and .tga files carrying a payload
+			3. -j N, number of workers, one per CPU by default [Optional]
+
+			1. --daemon (for serving -e and -d requests)
+			2. Unix domain socket file to listen on, only the same user can connect, SIGINT or SIGTERM stops the daemon
+			3. -j N, number of workers, one per CPU by default [Optional]
+			4. -q, no line per request [Optional]
+
+			1. --client (for sending one request to a daemon)
+			2. Socket file of the daemon
+			3. -e or -d with its file names and options as above, relative names and - are the client's directory, stdin and stdout
+			Stripe lists are not served by the daemon, every request runs on one worker thread and its errors are logged by the daemon.
 
 Sample execution: -
 
@@ -78,14 +111,31 @@ INFO: ## Decoding Done Successfully ##
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "encode.h"
 #include "decode.h"
 #include "types.h"
+#include "options.h"
+#include "file_copy.h"
+#include "batch.h"
+#include "scan.h"
+#include "stripe.h"
+#include "daemon.h"
+#include "thread_pool.h"
 
 int main(int argc, char *argv[])
 {
 	//Declare the variables.
 	int operation_type;
+	Options options;
+
+	//Read the options and strip them from argv.
+	argc = read_options(argc, argv, &options);
+	if(argc < 0)
+	{
+		return e_failure;
+	}
+
 	//Check the number of arguments minimum required argument is greater than or equal to 3.
 	if(argc >= 3)
 	{
@@ -96,9 +146,13 @@ int main(int argc, char *argv[])
 		//Error handling, If e unsupported print invalid with usage.
 		if(operation_type == e_unsupported)
 		{
-			printf("ERROR: Invalid! Please pass the correct option.\nUsage: Pass -e for encoding and -d for decoding.\n");
-			printf("%s : Encoding: %s -e <.bmp file> <.txt file> [output file]\n",argv[0],argv[0]);
-			printf("%s : Decoding: %s -d <.bmp file> [output file]\n", argv[0],argv[0]);
+			fprintf(stderr, "ERROR: Invalid! Please pass the correct option.\nUsage: Pass -e for encoding and -d for decoding.\n");
+			printf("%s : Encoding: %s -e <.bmp|.ppm|.tga file[,file...]|-> <.txt file|-> [output file|-] [-j N] [-k 1-4|auto] [-z] [--crc] [--key-file FILE|--key-env VAR] [--scatter] [--in-place] [--secret-size N] [-q] [--stats=json]\n",argv[0],argv[0]);
+			printf("%s : Decoding: %s -d <.bmp|.ppm|.tga file[,file...]|-> [output file|-] [-j N] [--key-file FILE|--key-env VAR] [-q] [--stats=json]\n", argv[0],argv[0]);
+			printf("%s : Batch encoding: %s -b <manifest file> [-j N] [-k 1-4|auto] [-z] [--crc] [--key-file FILE|--key-env VAR] [--scatter]\n", argv[0],argv[0]);
+			printf("%s : Scan: %s --scan <directory> [-j N]\n", argv[0],argv[0]);
+			printf("%s : Daemon: %s --daemon <socket> [-j N] [-q]\n", argv[0],argv[0]);
+			printf("%s : Client: %s --client <socket> -e|-d <files and options as for -e or -d>\n", argv[0],argv[0]);
 			return e_failure;
 		}
 
@@ -106,37 +160,153 @@ int main(int argc, char *argv[])
 		else if(operation_type == e_encode)
 		{
 			EncodeInfo encInfo;
-			printf("INFO: Selected Encoding\n");
+			Stats stats;
+			Status status;
+			FILE *fptr_report = stdout;
+			//A stego image written to stdout leaves no room for INFO lines, the stats go to stderr.
+			if(argc >= 4 && strchr(argv[2], ',') == NULL && (stdio_file_name(argv[4]) || (stdio_file_name(argv[2]) && argv[4] == NULL)))
+			{
+				options.quiet = 1;
+				fptr_report = stderr;
+			}
+			encInfo.quiet = options.quiet;
+			encode_info(&encInfo, "INFO: Selected Encoding\n");
 			//Check whether the arguments are greater than or equal to 4.
-			if(argc >= 4)
+			if(argc >= 4 && strchr(argv[2], ',') != NULL)
 			{
-				//File validation.
+				//A list of images stripes the secret over all of them.
+				if(do_striped_encoding(argv, &options) == e_success)
+				{
+					encode_info(&encInfo, "INFO: ## Encoding Done Successfully ##\n");
+				}
+				else
+				{
+					printf("INFO: Encoding Failed\n");
+					return e_failure;
+				}
+			}
+			else if(argc >= 4)
+			{
+				//File validation, in place there is no output file.
+				encInfo.in_place = options.in_place;
 				if(read_and_validate_encode_args(argv, &encInfo) == e_success)
 				{
-					printf("INFO: Read and validation is done successfully\n");
+					encode_info(&encInfo, "INFO: Read and validation is done successfully\n");
+
+					//Start the worker pool when more than one thread is asked for.
+					encInfo.pool = NULL;
+					encInfo.use_stdio = 0;
+					encInfo.stdin_fd = STDIN_FILENO;
+					encInfo.stdout_fd = STDOUT_FILENO;
+					encInfo.stats = NULL;
+					encInfo.depth = options.depth;
+					encInfo.compress = options.compress;
+					encInfo.crc = options.crc;
+					encInfo.key = options.has_key ? options.key : NULL;
+					encInfo.scatter = options.scatter;
+					encInfo.secret_offset = 0;
+					encInfo.secret_part = options.secret_size;
+					encInfo.stripe = NULL;
+					if(options.threads == 0 || options.threads > 1)
+					{
+						encInfo.pool = thread_pool_create(options.threads);
+						encode_info(&encInfo, "INFO: Encoding on %d threads\n", encInfo.pool != NULL ? thread_pool_size(encInfo.pool) : 1);
+					}
+					//Record the stages when asked for.
+					if(options.stats)
+					{
+						stats_init(&stats);
+						encInfo.stats = &stats;
+					}
 
 					//Encoding the secret data.
-					if(do_encoding(&encInfo) == e_success)
+					status = do_encoding(&encInfo);
+					stats_end(encInfo.stats);
+					thread_pool_destroy(encInfo.pool);
+					if(encInfo.stats != NULL)
 					{
-						printf("INFO: ## Encoding Done Successfully ##\n");
+						stats_print_json(&stats, fptr_report, "encode", status);
+						stats_close(&stats);
+					}
+					if(status == e_success)
+					{
+						encode_info(&encInfo, "INFO: ## Encoding Done Successfully ##\n");
 					}
 					else
 					{
-						printf("INFO: Encoding Failed\n");
+						fprintf(fptr_report, "INFO: Encoding Failed\n");
 						return e_failure;
 					}
 				}
 				else
 				{
-					printf("INFO: Read and validation failed\n");
+					fprintf(fptr_report, "INFO: Read and validation failed\n");
 					return e_failure;
 				}
 			}
 			else
 			{
 				//If the arguments are less than 4 then print the error message.
-				printf("ERROR: Arguments are missing\n");
-				printf("%s : Encoding: %s -e <.bmp file> <.txt file> [output file]\n", argv[0],argv[0]);
+				fprintf(stderr, "ERROR: Arguments are missing\n");
+				printf("%s : Encoding: %s -e <.bmp|.ppm|.tga file[,file...]|-> <.txt file|-> [output file|-] [-j N] [-k 1-4|auto] [-z] [--crc] [--key-file FILE|--key-env VAR] [--scatter] [--in-place] [--secret-size N] [-q] [--stats=json]\n", argv[0],argv[0]);
+				return e_failure;
+			}
+		}
+
+		//Batch encoding, If e_batch print selected batch encoding.
+		else if(operation_type == e_batch)
+		{
+			printf("INFO: Selected Batch Encoding\n");
+			//One worker per CPU unless -j is given.
+			if(do_batch_encoding(argv[2], &options) == e_success)
+			{
+				printf("INFO: ## Batch Encoding Done Successfully ##\n");
+			}
+			else
+			{
+				printf("INFO: Batch Encoding Failed\n");
+				return e_failure;
+			}
+		}
+
+		//Scanning, If e_scan print selected scan.
+		else if(operation_type == e_scan)
+		{
+			printf("INFO: Selected Scan\n");
+			//One worker per CPU unless -j is given.
+			if(do_scan(argv[2], &options) == e_success)
+			{
+				printf("INFO: ## Scan Done Successfully ##\n");
+			}
+			else
+			{
+				printf("INFO: Scan Failed\n");
+				return e_failure;
+			}
+		}
+
+		//Daemon, If e_daemon print selected daemon.
+		else if(operation_type == e_daemon)
+		{
+			printf("INFO: Selected Daemon\n");
+			//Serve requests until stopped.
+			if(do_daemon(argv[2], &options) == e_success)
+			{
+				printf("INFO: ## Daemon Stopped ##\n");
+			}
+			else
+			{
+				printf("INFO: Daemon Failed\n");
+				return e_failure;
+			}
+		}
+
+		//Client, If e_client send the request on to the daemon.
+		else if(operation_type == e_client)
+		{
+			//The daemon reports the outcome, the stages are not printed.
+			if(do_client(argv, &options) == e_failure)
+			{
 				return e_failure;
 			}
 		}
@@ -144,20 +314,70 @@ int main(int argc, char *argv[])
 		//Decoding, If e_decode print selected decoding.
 		else if(operation_type == e_decode)
 		{
-			printf("INFO: Selected Decoding\n");
 			DecodeInfo decInfo;
+			Stats stats;
+			Status status;
+			FILE *fptr_report = stdout;
+			//A secret written to stdout leaves no room for INFO lines, the stats go to stderr.
+			if(strchr(argv[2], ',') == NULL && stdio_file_name(argv[3]))
+			{
+				options.quiet = 1;
+				fptr_report = stderr;
+			}
+			decInfo.quiet = options.quiet;
+			decode_info(&decInfo, "INFO: Selected Decoding\n");
 			//Check whether the arguments are greater than or equal to 3
-			if(argc >= 3)
+			if(strchr(argv[2], ',') != NULL)
+			{
+				//A list of images is every stripe of one secret.
+				if(do_striped_decoding(argv, &options) == e_success)
+				{
+					decode_info(&decInfo, "INFO: ## Decoding Done Successfully ##\n");
+				}
+				else
+				{
+					fprintf(stderr,"ERROR: Decoding Failed\n");
+					return e_failure;
+				}
+			}
+			else if(argc >= 3)
 			{
 				//File validation
 				if(read_and_validate_decode(argv, &decInfo) == e_success)
 				{
-					printf("INFO: Read and validation is done successfully\n");
+					decode_info(&decInfo, "INFO: Read and validation is done successfully\n");
+
+					//Start the worker pool when more than one thread is asked for.
+					decInfo.pool = NULL;
+					decInfo.stats = NULL;
+					decInfo.key = options.has_key ? options.key : NULL;
+					decInfo.stripe_set = 0;
+					decInfo.stdin_fd = STDIN_FILENO;
+					decInfo.stdout_fd = STDOUT_FILENO;
+					if(options.threads == 0 || options.threads > 1)
+					{
+						decInfo.pool = thread_pool_create(options.threads);
+						decode_info(&decInfo, "INFO: Decoding on %d threads\n", decInfo.pool != NULL ? thread_pool_size(decInfo.pool) : 1);
+					}
+					//Record the stages when asked for.
+					if(options.stats)
+					{
+						stats_init(&stats);
+						decInfo.stats = &stats;
+					}
 
 					//Decoding the secret data from stego image.
-					if(do_decoding(&decInfo) == e_success)
+					status = do_decoding(&decInfo);
+					stats_end(decInfo.stats);
+					thread_pool_destroy(decInfo.pool);
+					if(decInfo.stats != NULL)
 					{
-						printf("INFO: ## Decoding Done Successfully ##\n");
+						stats_print_json(&stats, fptr_report, "decode", status);
+						stats_close(&stats);
+					}
+					if(status == e_success)
+					{
+						decode_info(&decInfo, "INFO: ## Decoding Done Successfully ##\n");
 					}
 					else
 					{
@@ -175,7 +395,7 @@ int main(int argc, char *argv[])
 			{
 				//If the arguments are less than 3 then print the error message.
 				fprintf(stderr,"ERROR: Arguments are missing\n");
-				printf("%s : Decoding: %s -d <.bmp file> [output file]\n", argv[0],argv[0]);
+				printf("%s : Decoding: %s -d <.bmp|.ppm|.tga file[,file...]|-> [output file|-] [-j N] [--key-file FILE|--key-env VAR] [-q] [--stats=json]\n", argv[0],argv[0]);
 				return e_failure;
 			}
 		}
@@ -183,9 +403,13 @@ int main(int argc, char *argv[])
 	else
 	{
 		//If arguments are less than 3 print the error message.
-		printf("ERROR: Arguments are missing. Please pass the required arguments.\n");
-		printf("%s : Encoding: %s -e <.bmp file> <.txt file> [output file]\n",argv[0],argv[0]);
-		printf("%s : Decoding: %s -d <.bmp file> [output file]\n", argv[0],argv[0]);
+		fprintf(stderr, "ERROR: Arguments are missing. Please pass the required arguments.\n");
+		printf("%s : Encoding: %s -e <.bmp|.ppm|.tga file[,file...]|-> <.txt file|-> [output file|-] [-j N] [-k 1-4|auto] [-z] [--crc] [--key-file FILE|--key-env VAR] [--scatter] [--in-place] [--secret-size N] [-q] [--stats=json]\n",argv[0],argv[0]);
+		printf("%s : Decoding: %s -d <.bmp|.ppm|.tga file[,file...]|-> [output file|-] [-j N] [--key-file FILE|--key-env VAR] [-q] [--stats=json]\n", argv[0],argv[0]);
+		printf("%s : Batch encoding: %s -b <manifest file> [-j N] [-k 1-4|auto] [-z] [--crc] [--key-file FILE|--key-env VAR] [--scatter]\n", argv[0],argv[0]);
+		printf("%s : Scan: %s --scan <directory> [-j N]\n", argv[0],argv[0]);
+		printf("%s : Daemon: %s --daemon <socket> [-j N] [-q]\n", argv[0],argv[0]);
+		printf("%s : Client: %s --client <socket> -e|-d <files and options as for -e or -d>\n", argv[0],argv[0]);
 		return e_failure;
 	}
 	return e_success;
@@ -204,6 +428,30 @@ OperationType check_operation_type(char *argv[])
 			//If "-e", return e_encode.
 			return e_encode;
 		}
+		//Check argv[1] is -b or not.
+		else if(strcmp(argv[1],"-b") == 0)
+		{
+			//If "-b", return e_batch.
+			return e_batch;
+		}
+		//Check argv[1] is --scan or not.
+		else if(strcmp(argv[1],"--scan") == 0)
+		{
+			//If "--scan", return e_scan.
+			return e_scan;
+		}
+		//Check argv[1] is --daemon or not.
+		else if(strcmp(argv[1],"--daemon") == 0)
+		{
+			//If "--daemon", return e_daemon.
+			return e_daemon;
+		}
+		//Check argv[1] is --client or not.
+		else if(strcmp(argv[1],"--client") == 0)
+		{
+			//If "--client", return e_client.
+			return e_client;
+		}
 		//Check argv[1] is -d or not.	
 		else if(strcmp(argv[1],"-d") == 0)
 		{
@@ -0,0 +1,197 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+struct _ThreadPool
+{
+	pthread_mutex_t lock;				//Protects everything below.
+	pthread_cond_t work_ready;			//Signalled when a job is posted or on shutdown.
+	pthread_cond_t work_done;			//Signalled when the last index of a job finishes.
+	pthread_mutex_t run_lock;			//Serializes callers of thread_pool_run.
+	pthread_t *workers;					//Worker threads.
+	int worker_count;					//Number of worker threads.
+	int shutdown;						//Set to stop the workers.
+
+	/* Current job */
+	ThreadTask task;					//Task function, NULL when idle.
+	void *arg;							//Task argument.
+	int count;							//Number of indices in the job.
+	int next;							//Next index to hand out.
+	int pending;						//Indices not finished yet.
+};
+
+/* Function Definitions */
+
+/* Work on the current job
+ * Description: Claims indices of the current job until none are left.
+ * Called and returns with pool->lock held.
+ * Input: Thread pool
+ * Output: Claimed indices are run and counted down
+ * Return: None
+ */
+static void thread_pool_work(ThreadPool *pool)
+{
+	while(pool->task != NULL && pool->next < pool->count)
+	{
+		ThreadTask task = pool->task;
+		void *arg = pool->arg;
+		int index = pool->next++;
+
+		pthread_mutex_unlock(&pool->lock);
+		task(arg, index);
+		pthread_mutex_lock(&pool->lock);
+
+		if(--pool->pending == 0)
+		{
+			pthread_cond_broadcast(&pool->work_done);
+		}
+	}
+}
+
+/* Worker thread main loop */
+static void *thread_pool_worker(void *data)
+{
+	ThreadPool *pool = data;
+
+	pthread_mutex_lock(&pool->lock);
+	while(!pool->shutdown)
+	{
+		if(pool->task != NULL && pool->next < pool->count)
+		{
+			thread_pool_work(pool);
+		}
+		else
+		{
+			pthread_cond_wait(&pool->work_ready, &pool->lock);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Create a thread pool
+ * Description: Starts threads - 1 workers, the thread calling
+ * thread_pool_run is the last one.
+ * Input: Number of threads, less than 1 means one per CPU
+ * Output: Pool with its workers waiting for jobs
+ * Return: Pool, or NULL on failure
+ */
+ThreadPool *thread_pool_create(int threads)
+{
+	ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	if(threads < 1)
+	{
+		threads = thread_pool_cpu_count();
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->run_lock, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+
+	pool->workers = calloc(threads, sizeof(pthread_t));
+	if(pool->workers == NULL)
+	{
+		thread_pool_destroy(pool);
+		return NULL;
+	}
+	for(int i = 0; i < threads - 1; i++)
+	{
+		if(pthread_create(&pool->workers[i], NULL, thread_pool_worker, pool) != 0)
+		{
+			//Keep the workers that did start.
+			break;
+		}
+		pool->worker_count++;
+	}
+
+	return pool;
+}
+
+/* Stop and free a thread pool
+ * Input: Thread pool, may be NULL
+ * Output: Workers are joined and the pool is freed
+ * Return: None
+ */
+void thread_pool_destroy(ThreadPool *pool)
+{
+	if(pool == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(int i = 0; i < pool->worker_count; i++)
+	{
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->work_done);
+	pthread_cond_destroy(&pool->work_ready);
+	pthread_mutex_destroy(&pool->run_lock);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+/* Number of threads working on a job, the caller included */
+int thread_pool_size(const ThreadPool *pool)
+{
+	return pool->worker_count + 1;
+}
+
+/* Run a job on the pool
+ * Description: Runs task(arg, index) once for every index in [0, count)
+ * on the workers and the calling thread. Indices are handed out in order,
+ * so tasks should cover a few times more slices than there are threads.
+ * Input: Thread pool, task function and argument, number of indices
+ * Output: All indices are done
+ * Return: None
+ */
+void thread_pool_run(ThreadPool *pool, ThreadTask task, void *arg, int count)
+{
+	if(count <= 0)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_lock);
+	pthread_mutex_lock(&pool->lock);
+
+	pool->task = task;
+	pool->arg = arg;
+	pool->count = count;
+	pool->next = 0;
+	pool->pending = count;
+	pthread_cond_broadcast(&pool->work_ready);
+
+	//Help with the job, then wait for the slices still running on workers.
+	thread_pool_work(pool);
+	while(pool->pending > 0)
+	{
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	}
+	pool->task = NULL;
+
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_unlock(&pool->run_lock);
+}
+
+/* Number of online CPUs, at least 1 */
+int thread_pool_cpu_count(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cpus > 0 ? (int)cpus : 1;
+}
@@ -0,0 +1,32 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/*
+ * Fixed size pool of worker threads.
+ * A job is a task function run once for every index in [0, count),
+ * the calling thread works on the job too and returns when it is done.
+ */
+
+typedef struct _ThreadPool ThreadPool;
+
+/* Task function type, index is the slice to work on */
+typedef void (*ThreadTask)(void *arg, int index);
+
+/* Thread pool function prototypes */
+
+/* Create a pool running jobs on threads threads (caller included) */
+ThreadPool *thread_pool_create(int threads);
+
+/* Stop and free the pool */
+void thread_pool_destroy(ThreadPool *pool);
+
+/* Number of threads working on a job */
+int thread_pool_size(const ThreadPool *pool);
+
+/* Run task for every index in [0, count) and wait for all of them */
+void thread_pool_run(ThreadPool *pool, ThreadTask task, void *arg, int count);
+
+/* Number of online CPUs */
+int thread_pool_cpu_count(void);
+
+#endif
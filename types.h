@@ -15,6 +15,10 @@ typedef enum
 {
     e_encode,
     e_decode,
+    e_batch,
+    e_scan,
+    e_daemon,
+    e_client,
     e_unsupported
 } OperationType;
 